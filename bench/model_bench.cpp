@@ -0,0 +1,336 @@
+/*
+    Offline benchmark for the model loading path, no window or Vulkan device needed.
+
+    Usage: ModelBench [file.obj ...]
+    Without arguments every .obj in assets/models is measured.
+*/
+
+#include "mesh_optimizer.hpp"
+#include "meshlet_builder.hpp"
+#include "mesh_simplifier.hpp"
+#include "model.hpp"
+#include "utils.hpp"
+#include "vertex_packing.hpp"
+#include "vertex_welder.hpp"
+
+// GLM_GTX is an experimental extension
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace std{
+    // the Vertex hash loadModel used before VertexWelder, kept here as the baseline
+    template<> struct hash<engine::Model::Vertex>{
+        size_t operator()(engine::Model::Vertex const& vertex) const{
+            size_t seed = 0;
+            engine::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+            return seed;
+        }
+    };
+}
+
+namespace {
+    constexpr int RUNS = 5;
+
+    // best of RUNS, in milliseconds
+    double timeBest(const std::function<void()>& fn) {
+        double best = 1e30;
+        for (int i = 0; i < RUNS; ++i) {
+            auto start = std::chrono::high_resolution_clock::now();
+            fn();
+            auto end = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    std::vector<std::string> defaultModels() {
+        std::vector<std::string> files;
+        for (const char* dir : {"assets/models", "../assets/models"}) {
+            if (!std::filesystem::is_directory(dir)) continue;
+            for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+                if (entry.path().extension() == ".obj") files.push_back(entry.path().string());
+            }
+            break;
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    bool sameGeometry(const engine::Model::Builder& a, const engine::Model::Builder& b) {
+        return a.vertices == b.vertices && a.indices == b.indices;
+    }
+
+    bool benchObjLoaders(const std::string& file) {
+        using Loader = engine::Model::Builder::ObjLoader;
+
+        engine::Model::Builder tinyObj{};
+        engine::Model::Builder parallel{};
+        double tinyObjMs = timeBest([&]() {
+            tinyObj = engine::Model::Builder{};
+            tinyObj.loadModel(file, Loader::TinyObj);
+        });
+        double parallelMs = timeBest([&]() {
+            parallel = engine::Model::Builder{};
+            parallel.loadModel(file, Loader::Parallel);
+        });
+
+        bool same = sameGeometry(tinyObj, parallel);
+        std::cout << std::left << std::setw(40) << file << std::right << std::fixed << std::setprecision(2)
+            << " vertices " << std::setw(7) << tinyObj.vertices.size()
+            << " | tinyobj " << std::setw(8) << tinyObjMs << " ms"
+            << " | parallel " << std::setw(8) << parallelMs << " ms"
+            << " | " << (same ? "identical" : "MISMATCH") << std::endl;
+        return same;
+    }
+
+    // welds the face corners of a loaded model again, once with the old map and once with VertexWelder
+    bool benchWelding(const std::string& file) {
+        using Vertex = engine::Model::Vertex;
+
+        engine::Model::Builder builder{};
+        builder.loadModel(file);
+        // expand the indexed mesh back into the corner stream loadModel welds
+        std::vector<Vertex> corners{};
+        corners.reserve(builder.indices.size());
+        for (uint32_t index : builder.indices) corners.push_back(builder.vertices[index]);
+
+        std::vector<Vertex> mapVertices{};
+        std::vector<uint32_t> mapIndices{};
+        double mapMs = timeBest([&]() {
+            mapVertices.clear();
+            mapIndices.clear();
+            std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+            for (const auto& vertex : corners) {
+                if (uniqueVertices.count(vertex) == 0) {
+                    uniqueVertices[vertex] = static_cast<uint32_t>(mapVertices.size());
+                    mapVertices.push_back(vertex);
+                }
+                mapIndices.push_back(uniqueVertices[vertex]);
+            }
+        });
+
+        std::vector<Vertex> weldVertices{};
+        std::vector<uint32_t> weldIndices{};
+        double weldMs = timeBest([&]() {
+            weldVertices.clear();
+            weldIndices.clear();
+            engine::VertexWelder welder{weldVertices, corners.size() / 6};
+            for (const auto& vertex : corners) weldIndices.push_back(welder.weld(vertex));
+        });
+
+        bool same = mapVertices == weldVertices && mapIndices == weldIndices;
+        std::cout << std::left << std::setw(40) << file << std::right << std::fixed << std::setprecision(2)
+            << " corners " << std::setw(8) << corners.size()
+            << " | unordered_map " << std::setw(8) << mapMs << " ms"
+            << " | welder " << std::setw(8) << weldMs << " ms"
+            << " (" << std::setprecision(1) << mapMs / weldMs << "x)"
+            << " | " << (same ? "identical" : "MISMATCH") << std::endl;
+        return same;
+    }
+
+    // runs Builder::optimize and prints the vertex cache statistics after every step
+    void benchOptimizer(const std::string& file) {
+        engine::Model::Builder builder{};
+        builder.loadModel(file);
+        std::vector<engine::Model::Builder::OptimizeStep> steps{};
+        double optimizeMs = timeBest([&]() {
+            engine::Model::Builder copy = builder;
+            steps = copy.optimize();
+        });
+
+        std::cout << std::left << std::setw(40) << file << std::right << std::fixed << std::setprecision(3);
+        for (const auto& step : steps) {
+            std::cout << " | " << step.name << " " << step.acmr << " / " << step.atvr;
+        }
+        std::cout << std::setprecision(2) << " | " << optimizeMs << " ms" << std::endl;
+    }
+
+    // splits the optimized mesh into meshlets and reports their fill, the ACMR cost of the regrouping
+    // and how many meshlets the normal cone test rejects when looking at the mesh along each axis
+    bool benchMeshlets(const std::string& file) {
+        engine::Model::Builder builder{};
+        builder.loadModel(file);
+        builder.optimize();
+        std::vector<uint32_t> optimizedIndices = builder.indices;
+        double buildMs = timeBest([&]() {
+            builder.indices = optimizedIndices;
+            builder.buildMeshlets();
+        });
+
+        const auto& meshlets = builder.meshlets;
+        size_t vertexSum = 0;
+        std::vector<uint32_t> seen(builder.vertices.size(), UINT32_MAX);
+        bool ok = true;
+        for (uint32_t m = 0; m < meshlets.size(); ++m) {
+            uint32_t vertices = 0;
+            for (uint32_t i = 0; i < meshlets[m].indexCount; ++i) {
+                uint32_t v = builder.indices[meshlets[m].firstIndex + i];
+                if (seen[v] != m) ++vertices;
+                seen[v] = m;
+            }
+            vertexSum += vertices;
+            ok &= vertices <= engine::MeshletBuilder::MAX_VERTICES
+                && meshlets[m].indexCount <= 3 * engine::MeshletBuilder::MAX_TRIANGLES;
+            ok &= m == 0 || meshlets[m].firstIndex == meshlets[m - 1].firstIndex + meshlets[m - 1].indexCount;
+        }
+        // the meshlets must hold exactly the triangles of the optimized mesh
+        auto sortedTriangles = [](const std::vector<uint32_t>& indices) {
+            std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+            for (size_t t = 0; t < triangles.size(); ++t) triangles[t] = {indices[3 * t], indices[3 * t + 1], indices[3 * t + 2]};
+            std::sort(triangles.begin(), triangles.end());
+            return triangles;
+        };
+        ok &= sortedTriangles(optimizedIndices) == sortedTriangles(builder.indices);
+
+        glm::vec3 min{1e30f};
+        glm::vec3 max{-1e30f};
+        for (const auto& vertex : builder.vertices) {
+            min = glm::min(min, vertex.position);
+            max = glm::max(max, vertex.position);
+        }
+        glm::vec3 center = (min + max) * 0.5f;
+        float distance = glm::length(max - min) * 2.f;
+        size_t coneCulled = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            for (float side : {-1.f, 1.f}) {
+                glm::vec3 camera = center;
+                camera[axis] += side * distance;
+                for (const auto& meshlet : meshlets) coneCulled += engine::MeshletBuilder::isBackfacing(meshlet, camera);
+            }
+        }
+
+        auto before = engine::MeshOptimizer::analyzeVertexCache(optimizedIndices.data(), optimizedIndices.size(), builder.vertices.size());
+        auto after = engine::MeshOptimizer::analyzeVertexCache(builder.indices.data(), builder.indices.size(), builder.vertices.size());
+        size_t count = std::max<size_t>(meshlets.size(), 1);
+        std::cout << std::left << std::setw(40) << file << std::right << std::fixed << std::setprecision(1)
+            << " meshlets " << std::setw(6) << meshlets.size()
+            << " | avg " << std::setw(5) << static_cast<double>(vertexSum) / count << " vertices "
+            << std::setw(5) << static_cast<double>(builder.indices.size() / 3) / count << " triangles"
+            << std::setprecision(3) << " | ACMR " << before.acmr << " -> " << after.acmr
+            << std::setprecision(1) << " | cone culled " << std::setw(5) << 100.0 * coneCulled / (6.0 * count) << " %"
+            << std::setprecision(2) << " | " << buildMs << " ms"
+            << " | " << (ok ? "valid" : "INVALID") << std::endl;
+        return ok;
+    }
+
+    // builds the default LOD chain and prints triangles and error (relative to the mesh size) per level
+    void benchLods(const std::string& file) {
+        engine::Model::Builder builder{};
+        builder.loadModel(file);
+        builder.optimize();
+        double lodMs = timeBest([&]() { builder.buildLods(); });
+
+        glm::vec3 min{1e30f};
+        glm::vec3 max{-1e30f};
+        for (const auto& vertex : builder.vertices) {
+            min = glm::min(min, vertex.position);
+            max = glm::max(max, vertex.position);
+        }
+        float size = std::max(glm::length(max - min), 1e-30f);
+
+        std::cout << std::left << std::setw(40) << file << std::right;
+        for (const auto& lod : builder.lods) {
+            std::cout << " | " << std::setw(6) << lod.indexCount / 3 << " tris "
+                << std::scientific << std::setprecision(1) << lod.error / size << std::fixed;
+        }
+        std::cout << std::setprecision(2) << " | " << lodMs << " ms" << std::endl;
+    }
+
+    const char* layoutName(engine::Model::VertexLayout layout) {
+        switch (layout) {
+            case engine::Model::VertexLayout::Packed: return "packed";
+            case engine::Model::VertexLayout::PackedQuantized: return "quantized";
+            default: return "standard";
+        }
+    }
+
+    // reports the vertex layout and index type Model would pick and the worst error packing introduces
+    void benchPacking(const std::string& file) {
+        using Layout = engine::Model::VertexLayout;
+
+        engine::Model::Builder builder{};
+        builder.loadModel(file);
+        const auto* vertices = builder.vertices.data();
+        uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+
+        Layout layout = engine::VertexPacking::chooseLayout(vertices, vertexCount);
+        size_t stride = sizeof(engine::Model::Vertex);
+        float positionError = 0.f;
+        float normalError = 0.f;
+        float uvError = 0.f;
+        if (layout != Layout::Standard) {
+            glm::mat4 dequantize{1.f};
+            auto quantized = engine::VertexPacking::quantize(vertices, vertexCount, dequantize);
+            auto packed = engine::VertexPacking::pack(vertices, vertexCount);
+            stride = layout == Layout::Packed ? sizeof(engine::Model::PackedVertex) : sizeof(engine::Model::QuantizedVertex);
+            for (uint32_t i = 0; i < vertexCount; ++i) {
+                if (layout == Layout::PackedQuantized) {
+                    const auto& q = quantized[i].position;
+                    glm::vec4 position = dequantize * glm::vec4{
+                        std::max(q[0] / 32767.f, -1.f), std::max(q[1] / 32767.f, -1.f), std::max(q[2] / 32767.f, -1.f), 1.f};
+                    positionError = std::max(positionError, glm::length(glm::vec3{position} - vertices[i].position));
+                }
+                glm::vec3 normal = engine::VertexPacking::decodeNormal(packed[i].normal);
+                float cosine = glm::clamp(glm::dot(normal, glm::normalize(vertices[i].normal)), -1.f, 1.f);
+                normalError = std::max(normalError, std::acos(cosine) * 57.2957795f);
+                glm::vec2 uv = glm::unpackHalf2x16(packed[i].uv);
+                uvError = std::max(uvError, std::max(std::abs(uv.x - vertices[i].uv.x), std::abs(uv.y - vertices[i].uv.y)));
+            }
+        }
+
+        std::cout << std::left << std::setw(40) << file << " " << std::setw(9) << layoutName(layout) << std::right
+            << " | " << std::setw(8) << vertexCount * sizeof(engine::Model::Vertex) << " -> " << std::setw(8) << vertexCount * stride << " bytes"
+            << std::scientific << std::setprecision(1)
+            << " | position error " << positionError
+            << " | normal error " << normalError << " deg"
+            << " | uv error " << uvError << std::fixed
+            << " | indices " << builder.indices.size() * sizeof(uint32_t) << " -> "
+            << builder.indices.size() * (vertexCount <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t)) << " bytes" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> files(argv + 1, argv + argc);
+    if (files.empty()) files = defaultModels();
+    if (files.empty()) {
+        std::cerr << "no .obj files found, pass them on the command line" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    std::cout << "== obj loaders (best of " << RUNS << ") ==" << std::endl;
+    for (const auto& file : files) ok &= benchObjLoaders(file);
+
+    std::cout << "== vertex welding (best of " << RUNS << ") ==" << std::endl;
+    for (const auto& file : files) ok &= benchWelding(file);
+
+    std::cout << "== mesh optimizer, ACMR / ATVR with a " << engine::MeshOptimizer::CACHE_SIZE
+        << " entry FIFO cache (best of " << RUNS << ") ==" << std::endl;
+    for (const auto& file : files) benchOptimizer(file);
+
+    std::cout << "== meshlets, at most " << engine::MeshletBuilder::MAX_VERTICES << " vertices / "
+        << engine::MeshletBuilder::MAX_TRIANGLES << " triangles (best of " << RUNS << ") ==" << std::endl;
+    for (const auto& file : files) ok &= benchMeshlets(file);
+
+    std::cout << "== LOD chain, triangles and error / mesh diagonal per level (best of " << RUNS << ") ==" << std::endl;
+    for (const auto& file : files) benchLods(file);
+
+    std::cout << "== vertex / index packing ==" << std::endl;
+    for (const auto& file : files) benchPacking(file);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,160 @@
+/*
+    Offline benchmark for block compressed textures, no window or Vulkan device needed.
+
+    Usage: TextureBench [file.ktx2 ...]
+    Without arguments synthetic 2048x2048 BC1 / BC3 / BC5 / BC7 images with full mip chains
+    are measured. Per image: the bytes staged for upload compressed and as rgba8, the time
+    to parse the container and to write either into staging memory, and the cpu decode
+    fallback on one thread and on all of them.
+*/
+
+#include "block_decoder.hpp"
+#include "ktx2_loader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    constexpr int RUNS = 5;
+    constexpr uint32_t SYNTHETIC_SIZE = 2048;
+
+    // best of RUNS, in milliseconds
+    double timeBest(const std::function<void()>& fn) {
+        double best = 1e30;
+        for (int i = 0; i < RUNS; ++i) {
+            auto start = std::chrono::high_resolution_clock::now();
+            fn();
+            auto end = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    template <typename T>
+    void append(std::vector<uint8_t>& bytes, T value) {
+        size_t offset = bytes.size();
+        bytes.resize(offset + sizeof(T));
+        std::memcpy(bytes.data() + offset, &value, sizeof(T));
+    }
+
+    // a .ktx2 file with a full chain of random blocks, levels stored smallest first like the tools do
+    std::vector<uint8_t> syntheticKtx2(VkFormat format, uint32_t size) {
+        uint32_t levelCount = engine::Texture::mipLevelCount(size, size);
+        uint32_t blockBytes = engine::BlockDecoder::blockBytes(format);
+
+        std::vector<uint8_t> bytes = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+        for (uint32_t field : {static_cast<uint32_t>(format), 1u, size, size, 0u, 0u, 1u, levelCount, 0u}) {
+            append(bytes, field);
+        }
+        // no data format descriptor, key/values or supercompression data
+        for (uint32_t field : {0u, 0u, 0u, 0u}) append(bytes, field);
+        for (uint64_t field : {0ull, 0ull}) append(bytes, field);
+
+        size_t indexOffset = bytes.size();
+        bytes.resize(indexOffset + levelCount * 24);
+        std::mt19937 random{static_cast<uint32_t>(format)};
+        for (uint32_t level = levelCount; level-- > 0;) {
+            uint32_t levelSize = std::max(size >> level, 1u);
+            uint64_t length = static_cast<uint64_t>((levelSize + 3) / 4) * ((levelSize + 3) / 4) * blockBytes;
+            uint64_t offset = bytes.size();
+            for (uint64_t i = 0; i < length; ++i) bytes.push_back(static_cast<uint8_t>(random()));
+            std::memcpy(bytes.data() + indexOffset + level * 24, &offset, 8);
+            std::memcpy(bytes.data() + indexOffset + level * 24 + 8, &length, 8);
+            std::memcpy(bytes.data() + indexOffset + level * 24 + 16, &length, 8);
+        }
+        return bytes;
+    }
+
+    const char* formatName(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return "BC1 rgb";
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return "BC1 rgb srgb";
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return "BC1";
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return "BC1 srgb";
+            case VK_FORMAT_BC3_UNORM_BLOCK: return "BC3";
+            case VK_FORMAT_BC3_SRGB_BLOCK: return "BC3 srgb";
+            case VK_FORMAT_BC5_UNORM_BLOCK: return "BC5";
+            case VK_FORMAT_BC5_SNORM_BLOCK: return "BC5 snorm";
+            case VK_FORMAT_BC7_UNORM_BLOCK: return "BC7";
+            case VK_FORMAT_BC7_SRGB_BLOCK: return "BC7 srgb";
+            default: return "?";
+        }
+    }
+
+    bool benchTexture(const std::string& name, const std::vector<uint8_t>& file) {
+        engine::Texture::Builder compressed{};
+        double parseMs = timeBest([&]() { compressed = engine::Ktx2Loader::parse(file); });
+        VkDeviceSize rgbaBytes = engine::Ktx2Loader::rgbaSize(compressed);
+
+        // what the upload costs on the cpu: the chain written into (host visible) staging memory
+        std::vector<uint8_t> staging(rgbaBytes);
+        double stageCompressedMs = timeBest([&]() {
+            std::memcpy(staging.data(), compressed.pixels.data(), compressed.pixels.size());
+        });
+        std::vector<uint8_t> rgba(rgbaBytes, 0x80);
+        double stageRgbaMs = timeBest([&]() { std::memcpy(staging.data(), rgba.data(), rgba.size()); });
+
+        engine::Texture::Builder singleThread{};
+        engine::Texture::Builder allThreads{};
+        double decodeSingleMs = timeBest([&]() { singleThread = engine::Ktx2Loader::transcode(compressed, 1); });
+        double decodeAllMs = timeBest([&]() { allThreads = engine::Ktx2Loader::transcode(compressed); });
+
+        bool same = singleThread.pixels == allThreads.pixels;
+        std::cout << std::left << std::setw(28) << name << std::setw(13) << formatName(compressed.format)
+            << std::right << std::fixed << std::setprecision(2)
+            << " " << compressed.width << "x" << compressed.height << " " << compressed.levels.size() << " levels"
+            << " | upload " << std::setw(7) << compressed.pixels.size() / 1024 << " KB vs rgba8 "
+            << std::setw(7) << rgbaBytes / 1024 << " KB (" << std::setprecision(1)
+            << static_cast<double>(rgbaBytes) / compressed.pixels.size() << "x)" << std::setprecision(2)
+            << " | parse " << std::setw(6) << parseMs << " ms"
+            << " | staging " << std::setw(6) << stageCompressedMs << " ms vs " << std::setw(6) << stageRgbaMs << " ms"
+            << " | cpu decode " << std::setw(7) << decodeSingleMs << " ms, " << std::setw(7) << decodeAllMs << " ms on "
+            << std::max(1u, std::thread::hardware_concurrency()) << " threads"
+            << " | " << (same ? "identical" : "MISMATCH") << std::endl;
+        return same;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> files{};
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream file{argv[i], std::ios::ate | std::ios::binary};
+        if (!file.is_open()) {
+            std::cerr << "can't open " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        files.emplace_back(argv[i], std::move(bytes));
+    }
+    if (files.empty()) {
+        for (VkFormat format : {VK_FORMAT_BC1_RGBA_SRGB_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK,
+                VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK}) {
+            files.emplace_back(std::string("synthetic ") + formatName(format), syntheticKtx2(format, SYNTHETIC_SIZE));
+        }
+    }
+
+    bool ok = true;
+    std::cout << "== ktx2 textures against rgba8 (best of " << RUNS << ") ==" << std::endl;
+    for (const auto& [name, bytes] : files) {
+        try {
+            ok &= benchTexture(name, bytes);
+        } catch (const std::exception& e) {
+            std::cout << name << ": " << e.what() << std::endl;
+            ok = false;
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
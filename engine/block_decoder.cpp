@@ -0,0 +1,437 @@
+#include "block_decoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace engine {
+    namespace {
+        // BC7 mode layout, bit counts in the order they appear in a block
+        struct Bc7Mode {
+            uint8_t subsets;
+            uint8_t partitionBits;
+            uint8_t rotationBits;
+            uint8_t indexSelectionBits;
+            uint8_t colorBits;
+            uint8_t alphaBits;
+            uint8_t endpointPBits;
+            uint8_t sharedPBits;
+            uint8_t indexBits;
+            uint8_t index2Bits;
+        };
+
+        const Bc7Mode BC7_MODES[8] = {
+            {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+            {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+            {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+            {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+            {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+            {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+            {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+            {2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+        };
+
+        // two subset partitions, bit i is the subset of texel i
+        const uint16_t BC7_PARTITIONS2[64] = {
+            0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+            0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+            0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+            0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+            0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+            0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+            0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+            0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+        };
+
+        // three subset partitions, the subset of every texel
+        const uint8_t BC7_PARTITIONS3[64][16] = {
+            {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2}, {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
+            {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1}, {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
+            {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2}, {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
+            {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1}, {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+            {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2}, {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
+            {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
+            {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2}, {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
+            {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2}, {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
+            {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2}, {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
+            {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2}, {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
+            {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2}, {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
+            {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2}, {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
+            {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0}, {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
+            {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0}, {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
+            {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2}, {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
+            {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1}, {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
+            {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2}, {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
+            {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2}, {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
+            {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0}, {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
+            {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0}, {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
+            {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1}, {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+            {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1}, {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
+            {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1}, {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
+            {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1}, {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
+            {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2}, {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
+            {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2}, {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
+            {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2}, {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
+            {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2}, {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
+            {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
+            {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2}, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
+            {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1}, {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
+            {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0},
+        };
+
+        // texels whose index drops its top bit: texel 0 for subset 0 and these for the others
+        const uint8_t BC7_ANCHORS2[64] = {
+            15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+            15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+            15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+            6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+        };
+        const uint8_t BC7_ANCHORS3_SECOND[64] = {
+            3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+            3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+            8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+            3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+        };
+        const uint8_t BC7_ANCHORS3_THIRD[64] = {
+            15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+            15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+            15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+            15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+        };
+
+        // interpolation weights out of 64 for 2, 3 and 4 bit indices
+        const uint8_t WEIGHTS2[4] = {0, 21, 43, 64};
+        const uint8_t WEIGHTS3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+        const uint8_t WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        const uint8_t* weights(uint32_t bits) {
+            return bits == 2 ? WEIGHTS2 : bits == 3 ? WEIGHTS3 : WEIGHTS4;
+        }
+
+        // little endian bit stream, as BC7 blocks are laid out
+        struct BitReader {
+            uint64_t low;
+            uint64_t high;
+            uint32_t position = 0;
+
+            explicit BitReader(const uint8_t* block) {
+                std::memcpy(&low, block, 8);
+                std::memcpy(&high, block + 8, 8);
+            }
+
+            uint32_t read(uint32_t count) {
+                uint64_t bits;
+                if (position >= 64) bits = high >> (position - 64);
+                else if (position == 0) bits = low;
+                else bits = low >> position | high << (64 - position);
+                position += count;
+                return static_cast<uint32_t>(bits & ((1ull << count) - 1));
+            }
+        };
+
+        // 5:6:5 endpoints, 3 color mode (with transparent black) when color0 <= color1 unless forced to 4
+        void decodeBc1(const uint8_t* block, uint8_t* texels, bool punchThroughAlpha, bool fourColors) {
+            uint32_t color0 = block[0] | block[1] << 8;
+            uint32_t color1 = block[2] | block[3] << 8;
+            uint8_t palette[4][4];
+            for (int i = 0; i < 2; ++i) {
+                uint32_t color = i == 0 ? color0 : color1;
+                uint32_t r = color >> 11 & 0x1F;
+                uint32_t g = color >> 5 & 0x3F;
+                uint32_t b = color & 0x1F;
+                palette[i][0] = static_cast<uint8_t>(r << 3 | r >> 2);
+                palette[i][1] = static_cast<uint8_t>(g << 2 | g >> 4);
+                palette[i][2] = static_cast<uint8_t>(b << 3 | b >> 2);
+                palette[i][3] = 255;
+            }
+            if (fourColors || color0 > color1) {
+                for (int c = 0; c < 3; ++c) {
+                    palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c] + 1) / 3);
+                    palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+                }
+                palette[2][3] = palette[3][3] = 255;
+            } else {
+                for (int c = 0; c < 3; ++c) {
+                    palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c] + 1) / 2);
+                    palette[3][c] = 0;
+                }
+                palette[2][3] = 255;
+                palette[3][3] = punchThroughAlpha ? 0 : 255;
+            }
+
+            uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | static_cast<uint32_t>(block[7]) << 24;
+            for (int i = 0; i < 16; ++i) {
+                std::memcpy(texels + i * 4, palette[indices >> (2 * i) & 3], 4);
+            }
+        }
+
+        // one channel: two 8 bit endpoints and 16 3 bit indices, written every stride bytes
+        void decodeBc4(const uint8_t* block, uint8_t* channel, uint32_t stride) {
+            int32_t a0 = block[0];
+            int32_t a1 = block[1];
+            int32_t palette[8] = {a0, a1};
+            if (a0 > a1) {
+                for (int i = 2; i < 8; ++i) palette[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+            } else {
+                for (int i = 2; i < 6; ++i) palette[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+            uint64_t indices = 0;
+            for (int i = 0; i < 6; ++i) indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+            for (int i = 0; i < 16; ++i) {
+                channel[i * stride] = static_cast<uint8_t>(palette[indices >> (3 * i) & 7]);
+            }
+        }
+
+        // the snorm variant, endpoints are two's complement with -128 read as -127
+        void decodeBc4Signed(const uint8_t* block, uint8_t* channel, uint32_t stride) {
+            int32_t a0 = std::max<int32_t>(static_cast<int8_t>(block[0]), -127);
+            int32_t a1 = std::max<int32_t>(static_cast<int8_t>(block[1]), -127);
+            int32_t palette[8] = {a0, a1};
+            if (a0 > a1) {
+                for (int i = 2; i < 8; ++i) palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+            } else {
+                for (int i = 2; i < 6; ++i) palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+                palette[6] = -127;
+                palette[7] = 127;
+            }
+            uint64_t indices = 0;
+            for (int i = 0; i < 6; ++i) indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+            for (int i = 0; i < 16; ++i) {
+                channel[i * stride] = static_cast<uint8_t>(static_cast<int8_t>(palette[indices >> (3 * i) & 7]));
+            }
+        }
+
+        void decodeBc7(const uint8_t* block, uint8_t* texels) {
+            BitReader bits{block};
+            uint32_t mode = 0;
+            while (mode < 8 && bits.read(1) == 0) ++mode;
+            if (mode == 8) {
+                // reserved mode, decodes to transparent black
+                std::memset(texels, 0, 64);
+                return;
+            }
+            const Bc7Mode& m = BC7_MODES[mode];
+            uint32_t partition = bits.read(m.partitionBits);
+            uint32_t rotation = bits.read(m.rotationBits);
+            uint32_t indexSelection = bits.read(m.indexSelectionBits);
+
+            // endpoint 2 * subset + 0/1, channels rgba
+            uint32_t endpoints[6][4] = {};
+            uint32_t endpointCount = 2u * m.subsets;
+            for (int c = 0; c < 3; ++c) {
+                for (uint32_t e = 0; e < endpointCount; ++e) endpoints[e][c] = bits.read(m.colorBits);
+            }
+            if (m.alphaBits > 0) {
+                for (uint32_t e = 0; e < endpointCount; ++e) endpoints[e][3] = bits.read(m.alphaBits);
+            }
+
+            // p-bits extend every channel that is stored by one low bit
+            uint32_t colorPrecision = m.colorBits;
+            uint32_t alphaPrecision = m.alphaBits;
+            int channels = m.alphaBits > 0 ? 4 : 3;
+            if (m.endpointPBits || m.sharedPBits) {
+                uint32_t pBits[6];
+                if (m.endpointPBits) {
+                    for (uint32_t e = 0; e < endpointCount; ++e) pBits[e] = bits.read(1);
+                } else {
+                    for (uint32_t s = 0; s < m.subsets; ++s) pBits[2 * s] = pBits[2 * s + 1] = bits.read(1);
+                }
+                for (uint32_t e = 0; e < endpointCount; ++e) {
+                    for (int c = 0; c < channels; ++c) endpoints[e][c] = endpoints[e][c] << 1 | pBits[e];
+                }
+                ++colorPrecision;
+                if (m.alphaBits > 0) ++alphaPrecision;
+            }
+
+            // to 8 bits, the top bits repeat into the low ones
+            for (uint32_t e = 0; e < endpointCount; ++e) {
+                for (int c = 0; c < 3; ++c) {
+                    uint32_t v = endpoints[e][c] << (8 - colorPrecision);
+                    endpoints[e][c] = v | v >> colorPrecision;
+                }
+                if (m.alphaBits > 0) {
+                    uint32_t v = endpoints[e][3] << (8 - alphaPrecision);
+                    endpoints[e][3] = alphaPrecision == 8 ? endpoints[e][3] : v | v >> alphaPrecision;
+                } else {
+                    endpoints[e][3] = 255;
+                }
+            }
+
+            uint8_t subsetOf[16];
+            bool anchor[16] = {true};
+            for (int i = 0; i < 16; ++i) {
+                if (m.subsets == 1) subsetOf[i] = 0;
+                else if (m.subsets == 2) subsetOf[i] = BC7_PARTITIONS2[partition] >> i & 1;
+                else subsetOf[i] = BC7_PARTITIONS3[partition][i];
+            }
+            if (m.subsets == 2) anchor[BC7_ANCHORS2[partition]] = true;
+            if (m.subsets == 3) {
+                anchor[BC7_ANCHORS3_SECOND[partition]] = true;
+                anchor[BC7_ANCHORS3_THIRD[partition]] = true;
+            }
+
+            uint32_t indices[16];
+            uint32_t indices2[16] = {};
+            for (int i = 0; i < 16; ++i) indices[i] = bits.read(anchor[i] ? m.indexBits - 1 : m.indexBits);
+            if (m.index2Bits > 0) {
+                for (int i = 0; i < 16; ++i) indices2[i] = bits.read(i == 0 ? m.index2Bits - 1 : m.index2Bits);
+            }
+
+            // modes 4 and 5 weight color and alpha with separate indices, the selection bit swaps them
+            const uint8_t* colorWeights = weights(m.indexBits);
+            const uint8_t* alphaWeights = colorWeights;
+            const uint32_t* colorIndices = indices;
+            const uint32_t* alphaIndices = indices;
+            if (m.index2Bits > 0) {
+                alphaWeights = weights(m.index2Bits);
+                alphaIndices = indices2;
+                if (indexSelection) {
+                    std::swap(colorWeights, alphaWeights);
+                    std::swap(colorIndices, alphaIndices);
+                }
+            }
+
+            for (int i = 0; i < 16; ++i) {
+                const uint32_t* e0 = endpoints[2 * subsetOf[i]];
+                const uint32_t* e1 = endpoints[2 * subsetOf[i] + 1];
+                uint8_t* texel = texels + i * 4;
+                uint32_t w = colorWeights[colorIndices[i]];
+                for (int c = 0; c < 3; ++c) texel[c] = static_cast<uint8_t>(((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+                uint32_t wa = alphaWeights[alphaIndices[i]];
+                texel[3] = static_cast<uint8_t>(((64 - wa) * e0[3] + wa * e1[3] + 32) >> 6);
+                // rotation 1..3 swaps alpha with red, green or blue
+                if (rotation > 0) std::swap(texel[3], texel[rotation - 1]);
+            }
+        }
+    }
+
+    bool BlockDecoder::canDecode(VkFormat format) {
+        return decodedFormat(format) != VK_FORMAT_UNDEFINED;
+    }
+
+    VkFormat BlockDecoder::decodedFormat(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+                return VK_FORMAT_R8G8B8A8_UNORM;
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                return VK_FORMAT_R8G8B8A8_SRGB;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                return VK_FORMAT_R8G8_UNORM;
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+                return VK_FORMAT_R8G8_SNORM;
+            default:
+                return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    uint32_t BlockDecoder::blockBytes(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                return 8;
+            default:
+                return 16;
+        }
+    }
+
+    uint32_t BlockDecoder::decodedTexelBytes(VkFormat format) {
+        VkFormat decoded = decodedFormat(format);
+        return decoded == VK_FORMAT_R8G8_UNORM || decoded == VK_FORMAT_R8G8_SNORM ? 2 : 4;
+    }
+
+    void BlockDecoder::decodeBlock(VkFormat format, const uint8_t* block, uint8_t* texels) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                decodeBc1(block, texels, false, false);
+                break;
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                decodeBc1(block, texels, true, false);
+                break;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+                // the color half always has four colors here
+                decodeBc1(block + 8, texels, false, true);
+                decodeBc4(block, texels + 3, 4);
+                break;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                decodeBc4(block, texels, 2);
+                decodeBc4(block + 8, texels + 1, 2);
+                break;
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+                decodeBc4Signed(block, texels, 2);
+                decodeBc4Signed(block + 8, texels + 1, 2);
+                break;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                decodeBc7(block, texels);
+                break;
+            default:
+                throw std::runtime_error("Block format can't be decoded on the cpu");
+        }
+    }
+
+    void BlockDecoder::decode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height,
+        uint8_t* out, unsigned int threadCount) {
+        if (!canDecode(format)) throw std::runtime_error("Block format can't be decoded on the cpu");
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+        const uint32_t blockSize = blockBytes(format);
+        const uint32_t texelBytes = decodedTexelBytes(format);
+
+        // rows of blocks [first, last), edge blocks are clipped to the image
+        auto decodeRows = [&](uint32_t first, uint32_t last) {
+            uint8_t texels[16 * 4];
+            for (uint32_t by = first; by < last; ++by) {
+                for (uint32_t bx = 0; bx < blocksX; ++bx) {
+                    decodeBlock(format, blocks + (static_cast<size_t>(by) * blocksX + bx) * blockSize, texels);
+                    uint32_t columns = std::min(4u, width - bx * 4);
+                    uint32_t rows = std::min(4u, height - by * 4);
+                    for (uint32_t y = 0; y < rows; ++y) {
+                        std::memcpy(out + ((static_cast<size_t>(by) * 4 + y) * width + bx * 4) * texelBytes,
+                            texels + y * 4 * texelBytes, columns * texelBytes);
+                    }
+                }
+            }
+        };
+
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+        size_t blockCount = static_cast<size_t>(blocksX) * blocksY;
+        uint32_t workers = static_cast<uint32_t>(std::min<size_t>({threadCount, blocksY, blockCount / MIN_BLOCKS_PER_THREAD + 1}));
+        if (workers <= 1) {
+            decodeRows(0, blocksY);
+            return;
+        }
+
+        std::vector<std::exception_ptr> errors(workers);
+        std::vector<std::thread> threads;
+        threads.reserve(workers);
+        for (uint32_t i = 0; i < workers; ++i) {
+            threads.emplace_back([&, i]() {
+                try {
+                    decodeRows(blocksY * i / workers, blocksY * (i + 1) / workers);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        for (auto& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+    }
+}
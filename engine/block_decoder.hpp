@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+/*
+    CPU decoder for block compressed textures, the fallback for devices without
+    textureCompressionBC (most mobile gpus)
+
+    format                     | block    | decodes to
+    BC1 rgb / rgba, unorm/srgb | 8 bytes  | R8G8B8A8, unorm/srgb kept
+    BC3 unorm/srgb             | 16 bytes | R8G8B8A8, unorm/srgb kept
+    BC5 unorm/snorm            | 16 bytes | R8G8, unorm/snorm kept
+    BC7 unorm/srgb             | 16 bytes | R8G8B8A8, unorm/srgb kept
+
+    Blocks are independent, so decode() splits the rows of blocks across worker threads.
+    The decoded texture takes 4x (BC3/5/7) to 8x (BC1) the memory of the blocks.
+*/
+
+namespace engine {
+    class BlockDecoder {
+        public:
+            // below this many blocks per thread the workers cost more than they save
+            static constexpr uint32_t MIN_BLOCKS_PER_THREAD = 4096;
+
+            static bool canDecode(VkFormat format);
+            // the uncompressed format the blocks of format decode into
+            static VkFormat decodedFormat(VkFormat format);
+            static uint32_t blockBytes(VkFormat format);
+            // bytes per texel of decodedFormat(format)
+            static uint32_t decodedTexelBytes(VkFormat format);
+
+            // out receives width x height tightly packed texels of decodedFormat(format);
+            // threadCount 0 uses std::thread::hardware_concurrency()
+            static void decode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height,
+                uint8_t* out, unsigned int threadCount = 0);
+            // one block into 16 texels, row by row
+            static void decodeBlock(VkFormat format, const uint8_t* block, uint8_t* texels);
+    };
+}
@@ -6,13 +6,17 @@
  */
 
 #include "buffer.hpp"
+#include "deletion_queue.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
 namespace engine {
 
+    Buffer::WriteStats Buffer::writeStats{};
+
     /**
      * Returns the minimum instance size required to be compatible with devices minOffsetAlignment
      *
@@ -35,7 +39,8 @@ namespace engine {
         uint32_t instanceCount,
         VkBufferUsageFlags usageFlags,
         VkMemoryPropertyFlags memoryPropertyFlags,
-        VkDeviceSize minOffsetAlignment)
+        VkDeviceSize minOffsetAlignment,
+        VkSharingMode sharingMode)
         : device{device},
         instanceSize{instanceSize},
         instanceCount{instanceCount},
@@ -43,18 +48,24 @@ namespace engine {
         memoryPropertyFlags{memoryPropertyFlags} {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        // only concurrent when the device has a separate transfer queue family to share with
+        this->sharingMode = sharingMode == VK_SHARING_MODE_CONCURRENT && device.hasTransferQueue()
+            ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation, this->sharingMode);
+        hostCoherent = device.allocator().isHostCoherent(allocation.memoryType);
     }
 
     Buffer::~Buffer() {
         unmap();
-        vkDestroyBuffer(device.device(), buffer, nullptr);
-        vkFreeMemory(device.device(), memory, nullptr);
+        // frames in flight may still read it
+        device.deletionQueue().destroyBuffer(buffer, allocation);
     }
 
     /**
      * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
      *
+     * @note The memory block is mapped once by the allocator, this only points into that mapping
+     *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
      * @param offset (Optional) Byte offset from beginning
@@ -62,8 +73,14 @@ namespace engine {
      * @return VkResult of the buffer mapping call
      */
     VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(device.device(), memory, offset, size, 0, &mapped);
+        assert(buffer && allocation.memory && "Called map on buffer before create");
+        assert(offset <= bufferSize && (size == VK_WHOLE_SIZE || size <= bufferSize - offset) &&
+            "Mapped range exceeds the buffer");
+        (void)size;
+        if (allocation.mapped == nullptr) return VK_ERROR_MEMORY_MAP_FAILED;
+        mapped = static_cast<char *>(allocation.mapped) + offset;
+        mappedOffset = offset;
+        return VK_SUCCESS;
     }
 
     /**
@@ -72,11 +89,8 @@ namespace engine {
      * @note Does not return a result as vkUnmapMemory can't fail
      */
     void Buffer::unmap() {
-    if (mapped) {
-        vkUnmapMemory(device.device(), memory);
         mapped = nullptr;
     }
-    }
 
     /**
      * Copies the specified data to the mapped buffer. Default value writes whole buffer range
@@ -92,11 +106,69 @@ namespace engine {
 
         if (size == VK_WHOLE_SIZE) {
             memcpy(mapped, data, bufferSize);
+            markDirty(bufferSize, mappedOffset);
         } else {
             char *memOffset = (char *)mapped;
             memOffset += offset;
             memcpy(memOffset, data, size);
+            markDirty(size, mappedOffset + offset);
+        }
+    }
+
+    /**
+     * Records a range written by the host, flushed by the next flushDirty()
+     *
+     * @note Only tracked for non-coherent memory, coherent writes are just counted
+     *
+     * @param size (Optional) Size of the written range. Pass VK_WHOLE_SIZE for the rest of the buffer
+     * @param offset (Optional) Byte offset from beginning of the buffer
+     */
+    void Buffer::markDirty(VkDeviceSize size, VkDeviceSize offset) {
+        if (size == VK_WHOLE_SIZE) size = bufferSize - offset;
+        writeStats.writtenBytes += size;
+        if (hostCoherent || size == 0) return;
+        dirtyRanges.emplace_back(offset, offset + size);
+    }
+
+    /**
+     * Flush the ranges recorded since the last call to make them visible to the device
+     *
+     * Overlapping and touching ranges are merged after widening them to nonCoherentAtomSize, so
+     * a buffer written in several small pieces still costs one vkFlushMappedMemoryRanges call
+     * of as few ranges as possible.
+     *
+     * @return VkResult of the flush call
+     */
+    VkResult Buffer::flushDirty() {
+        if (dirtyRanges.empty()) return VK_SUCCESS;
+        std::sort(dirtyRanges.begin(), dirtyRanges.end());
+
+        std::vector<VkMappedMemoryRange> ranges;
+        for (const auto &dirty : dirtyRanges) {
+            VkMappedMemoryRange range = memoryRange(dirty.second - dirty.first, dirty.first);
+            if (!ranges.empty()) {
+                VkMappedMemoryRange &last = ranges.back();
+                if (last.size == VK_WHOLE_SIZE) continue;
+                if (range.offset <= last.offset + last.size) {
+                    last.size = range.size == VK_WHOLE_SIZE
+                        ? VK_WHOLE_SIZE : std::max(last.offset + last.size, range.offset + range.size) - last.offset;
+                    continue;
+                }
+            }
+            ranges.push_back(range);
+        }
+        dirtyRanges.clear();
+
+        for (const auto &range : ranges) {
+            // VK_WHOLE_SIZE only ends a dedicated allocation
+            writeStats.flushedBytes += range.size == VK_WHOLE_SIZE ? allocation.size - range.offset : range.size;
         }
+        return vkFlushMappedMemoryRanges(device.device(), static_cast<uint32_t>(ranges.size()), ranges.data());
+    }
+
+    void Buffer::resetWriteStats() {
+        writeStats.writtenBytes = 0;
+        writeStats.flushedBytes = 0;
     }
 
     /**
@@ -111,11 +183,9 @@ namespace engine {
      * @return VkResult of the flush call
      */
     VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
+        if (hostCoherent) return VK_SUCCESS;
+        VkMappedMemoryRange mappedRange = memoryRange(size, offset);
+        writeStats.flushedBytes += mappedRange.size == VK_WHOLE_SIZE ? allocation.size - mappedRange.offset : mappedRange.size;
         return vkFlushMappedMemoryRanges(device.device(), 1, &mappedRange);
     }
 
@@ -131,12 +201,35 @@ namespace engine {
      * @return VkResult of the invalidate call
      */
     VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
+        VkMappedMemoryRange mappedRange = memoryRange(size, offset);
+        return vkInvalidateMappedMemoryRanges(device.device(), 1, &mappedRange);
+    }
+
+    /**
+     * Translates a range of the buffer to the device memory it shares with other resources
+     *
+     * @param size Size of the range, VK_WHOLE_SIZE ends at the end of the buffer's allocation
+     * @param offset Byte offset from beginning of the buffer
+     *
+     * @return VkMappedMemoryRange for flush and invalidate
+     */
+    VkMappedMemoryRange Buffer::memoryRange(VkDeviceSize size, VkDeviceSize offset) const {
+        // flushed ranges have to start and end on nonCoherentAtomSize, the widened range stays inside
+        // the allocation: buddies are powers of two of at least 256 bytes, the atom is at most 256
+        VkDeviceSize atom = device.properties.limits.nonCoherentAtomSize;
+        VkDeviceSize begin = allocation.offset + offset;
+        VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+        begin = begin / atom * atom;
+        end = std::min((end + atom - 1) / atom * atom, allocation.offset + allocation.size);
+
         VkMappedMemoryRange mappedRange = {};
         mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(device.device(), 1, &mappedRange);
+        mappedRange.memory = allocation.memory;
+        mappedRange.offset = begin;
+        mappedRange.size = end - begin;
+        // a dedicated allocation's size needn't be a multiple of the atom, VK_WHOLE_SIZE covers its tail
+        if (allocation.block == nullptr && end == allocation.size) mappedRange.size = VK_WHOLE_SIZE;
+        return mappedRange;
     }
 
     /**
@@ -174,6 +267,36 @@ namespace engine {
      */
     VkResult Buffer::flushIndex(int index) { return flush(alignmentSize, index * alignmentSize); }
 
+    /**
+     * Move the buffer to memory in another block of the allocator, for defragmentation
+     *
+     * @note The copy only runs when commandBuffer is submitted, a barrier after it has to make
+     * it visible to the commands that read the buffer
+     *
+     * @param commandBuffer Command buffer recording, outside a render pass
+     * @param retired Receives the old handle and memory, to free once commandBuffer finished
+     *
+     * @return false when no other block had room, nothing changed then
+     */
+    bool Buffer::relocate(VkCommandBuffer commandBuffer, Retired &retired) {
+        VkBuffer newBuffer;
+        MemoryAllocator::Allocation newAllocation;
+        if (!device.createBufferOutside(bufferSize, usageFlags, allocation, newBuffer, newAllocation, sharingMode)) {
+            return false;
+        }
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = bufferSize;
+        vkCmdCopyBuffer(commandBuffer, buffer, newBuffer, 1, &copyRegion);
+
+        retired.buffer = buffer;
+        retired.allocation = allocation;
+        buffer = newBuffer;
+        allocation = newAllocation;
+        if (mapped) mapped = static_cast<char *>(allocation.mapped) + mappedOffset;
+        return true;
+    }
+
     /**
      * Create a buffer info descriptor
      *
@@ -2,17 +2,37 @@
 
 #include "device.hpp"
 
+// std
+#include <atomic>
+#include <utility>
+#include <vector>
+
 namespace  engine{
 
 class Buffer {
  public:
+  // host writes through writeToBuffer / markDirty and what reached vkFlushMappedMemoryRanges,
+  // summed over all buffers since the last resetWriteStats()
+  struct WriteStats {
+    std::atomic<uint64_t> writtenBytes{0};
+    std::atomic<uint64_t> flushedBytes{0};
+  };
+
+  // a buffer handle and its memory replaced by relocate(), freed once the gpu is done with them
+  struct Retired {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocator::Allocation allocation{};
+  };
+
   Buffer(
       Device& device,
       VkDeviceSize instanceSize,
       uint32_t instanceCount,
       VkBufferUsageFlags usageFlags,
       VkMemoryPropertyFlags memoryPropertyFlags,
-      VkDeviceSize minOffsetAlignment = 1);
+      VkDeviceSize minOffsetAlignment = 1,
+      VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
+  // the handle and memory go through Device::deletionQueue()
   ~Buffer();
 
   Buffer(const Buffer&) = delete;
@@ -23,9 +43,18 @@ class Buffer {
 
   void writeToBuffer(void* data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
   VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+  // records a range written through getMappedMemory(), writeToBuffer does this itself
+  void markDirty(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+  // flushes the ranges written since the last call, merged, nothing on coherent memory
+  VkResult flushDirty();
   VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
   VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
+  // moves the contents into memory outside the current block (see MemoryAllocator::shouldRelocate),
+  // recording the copy into commandBuffer. The buffer needs transfer src and dst usage. getBuffer()
+  // returns the new handle from here on, the old one is handed out in retired
+  bool relocate(VkCommandBuffer commandBuffer, Retired& retired);
+
   void writeToIndex(void* data, int index);
   VkResult flushIndex(int index);
   VkDescriptorBufferInfo descriptorInfoForIndex(int index);
@@ -39,14 +68,25 @@ class Buffer {
   VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
   VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
   VkDeviceSize getBufferSize() const { return bufferSize; }
+  VkSharingMode getSharingMode() const { return sharingMode; }
+  const MemoryAllocator::Allocation& getAllocation() const { return allocation; }
+  bool isHostCoherent() const { return hostCoherent; }
+
+  static const WriteStats& getWriteStats() { return writeStats; }
+  static void resetWriteStats();
 
  private:
   static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
+  // a range of the buffer as a range of the shared device memory, widened to nonCoherentAtomSize
+  VkMappedMemoryRange memoryRange(VkDeviceSize size, VkDeviceSize offset) const;
 
   Device& device;
   void* mapped = nullptr;
+  // buffer offset mapped points to
+  VkDeviceSize mappedOffset = 0;
   VkBuffer buffer = VK_NULL_HANDLE;
-  VkDeviceMemory memory = VK_NULL_HANDLE;
+  // sub-allocated from device.allocator(), host visible blocks stay mapped
+  MemoryAllocator::Allocation allocation{};
 
   VkDeviceSize bufferSize;
   uint32_t instanceCount;
@@ -54,6 +94,12 @@ class Buffer {
   VkDeviceSize alignmentSize;
   VkBufferUsageFlags usageFlags;
   VkMemoryPropertyFlags memoryPropertyFlags;
+  VkSharingMode sharingMode;
+  bool hostCoherent;
+  // [begin, end) written and not yet flushed, only tracked on non-coherent memory
+  std::vector<std::pair<VkDeviceSize, VkDeviceSize>> dirtyRanges;
+
+  static WriteStats writeStats;
 };
 
 }  // namespace 
@@ -95,4 +95,33 @@ namespace engine{
             position.x, position.y, position.z, 1
         };
     }
+
+    Frustum Camera::getFrustum() const{
+        /* 
+        Gribb/Hartmann plane extraction: a point p is inside when
+        -w <= x <= w, -w <= y <= w and 0 <= z <= w (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+        for clip = projection * view * p, every bound is a dot product with a row
+         */
+        const glm::mat4 m = projection * view;
+        auto row = [&m](int i){ return glm::vec4{m[0][i], m[1][i], m[2][i], m[3][i]}; };
+
+        Frustum frustum{};
+        frustum.planes[0] = row(3) + row(0); // left
+        frustum.planes[1] = row(3) - row(0); // right
+        frustum.planes[2] = row(3) + row(1); // top (y points down)
+        frustum.planes[3] = row(3) - row(1); // bottom
+        frustum.planes[4] = row(2);          // near
+        frustum.planes[5] = row(3) - row(2); // far
+        for (auto& plane : frustum.planes){
+            plane /= glm::length(glm::vec3{plane});
+        }
+        return frustum;
+    }
+
+    bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const{
+        for (const auto& plane : planes){
+            if (glm::dot(glm::vec3{plane}, center) + plane.w < -radius) return false;
+        }
+        return true;
+    }
 }
\ No newline at end of file
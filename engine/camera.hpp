@@ -8,6 +8,13 @@
 #include <limits>
 
 namespace engine{
+    // world space view volume, plane normals point inwards
+    struct Frustum{
+        glm::vec4 planes[6]{};
+
+        bool intersectsSphere(const glm::vec3& center, float radius) const;
+    };
+
     class Camera{
         public:
             void setOrthographicProjection(
@@ -31,6 +38,8 @@ namespace engine{
             const glm::mat4& getView() const { return view; }
             const glm::mat4& getInverseView() const { return inverseView; }
             const glm::vec3& getPosition() const { return inverseView[3]; }
+            // extracted from projection * view, so it follows both setters
+            Frustum getFrustum() const;
 
         private:
             glm::mat4 projection{1.f};
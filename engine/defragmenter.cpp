@@ -0,0 +1,95 @@
+#include "defragmenter.hpp"
+
+#include <stdexcept>
+
+namespace engine {
+    Defragmenter::Defragmenter(Device& device) : device{device} {}
+
+    Defragmenter::~Defragmenter() {
+        for (auto& frameRetired : retired) freeRetired(frameRetired);
+    }
+
+    void Defragmenter::track(Buffer* buffer, std::function<void(Buffer&)> onMoved) {
+        VkBufferUsageFlags transfer = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        if ((buffer->getUsageFlags() & transfer) != transfer) {
+            throw std::runtime_error("Relocatable buffers need transfer src and dst usage");
+        }
+        buffers[buffer] = std::move(onMoved);
+    }
+
+    void Defragmenter::untrack(Buffer* buffer) {
+        buffers.erase(buffer);
+    }
+
+    void Defragmenter::freeRetired(std::vector<Buffer::Retired>& frameRetired) {
+        for (auto& old : frameRetired) {
+            vkDestroyBuffer(device.device(), old.buffer, nullptr);
+            device.allocator().free(old.allocation);
+        }
+        frameRetired.clear();
+    }
+
+    bool Defragmenter::update(VkCommandBuffer commandBuffer, int frameIndex, float budgetMs) {
+        // the last submission of this frame index finished, nothing reads its old buffers anymore
+        freeRetired(retired[frameIndex]);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto& allocator = device.allocator();
+        VkDeviceSize movedBytes = 0;
+        bool candidates = false;
+        for (auto& kv : buffers) {
+            Buffer& buffer = *kv.first;
+            if (!allocator.shouldRelocate(buffer.getAllocation())) continue;
+
+            float elapsed = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - start).count();
+            if (elapsed > budgetMs || movedBytes >= MAX_BYTES_PER_FRAME) {
+                candidates = true;
+                break;
+            }
+
+            MemoryAllocator::Stats before = passActive ? MemoryAllocator::Stats{} : allocator.getStats();
+            Buffer::Retired old{};
+            // no room elsewhere (buddy fragmentation), it stays where it is
+            if (!buffer.relocate(commandBuffer, old)) continue;
+            if (!passActive) {
+                passActive = true;
+                passStart = before;
+            }
+            candidates = true;
+            retired[frameIndex].push_back(old);
+            movedBytes += buffer.getBufferSize();
+            ++stats.moves;
+            stats.movedBytes += buffer.getBufferSize();
+            if (kv.second) kv.second(buffer);
+        }
+
+        if (movedBytes > 0) {
+            // the draws of this frame read the new buffers
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        if (!passActive || candidates) return false;
+        for (const auto& frameRetired : retired) {
+            if (!frameRetired.empty()) return false;
+        }
+
+        // nothing left to move and every old buffer is gone
+        allocator.releaseEmptyBlocks();
+        MemoryAllocator::Stats passEnd = allocator.getStats();
+        stats.fragmentationBefore = passStart.fragmentation();
+        stats.fragmentationAfter = passEnd.fragmentation();
+        stats.blocksBefore = passStart.blockCount;
+        stats.blocksAfter = passEnd.blockCount;
+        ++stats.passes;
+        passActive = false;
+        return true;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+#include "swap_chain.hpp"
+
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Moves live buffers out of nearly empty allocator blocks, a few per frame, so the blocks
+    can be handed back to the driver
+
+    Loading and unloading models leaves blocks with a handful of allocations each. update()
+    runs every frame on the frame's command buffer, before the render pass:
+
+    frame N    | free what frame N - MAX_FRAMES_IN_FLIGHT retired | relocate, copy, barrier | draw
+    frame N+2  | old buffers of frame N destroyed (its fence was waited for) ...
+
+    Each relocation creates a new buffer in a fuller block (MemoryAllocator::shouldRelocate /
+    allocateOutside), records the copy and swaps the handle inside the Buffer, so holders of the
+    Buffer (Model) draw from the new one right away. Whoever caches the VkBuffer, e.g. in a
+    descriptor set, passes onMoved to track() and rewrites it there. Work per frame stops after
+    the time budget or MAX_BYTES_PER_FRAME of copies.
+
+    Only track buffers the host no longer writes (geometry), a host write after the relocation
+    would be overwritten by the pending copy.
+
+    A pass starts with the first relocation and ends when no tracked buffer is worth moving and
+    the old memory is freed, the empty blocks are released then and the fragmentation before and
+    after is kept in the stats.
+*/
+
+namespace engine {
+    class Defragmenter {
+        public:
+            static constexpr float DEFAULT_BUDGET_MS = 0.5f;
+            // copy bandwidth spent per frame at most
+            static constexpr VkDeviceSize MAX_BYTES_PER_FRAME = 8 * 1024 * 1024;
+
+            struct Stats {
+                uint64_t moves = 0;
+                VkDeviceSize movedBytes = 0;
+                uint32_t passes = 0;
+                // of the last finished pass
+                float fragmentationBefore = 0.f;
+                float fragmentationAfter = 0.f;
+                uint32_t blocksBefore = 0;
+                uint32_t blocksAfter = 0;
+            };
+
+            Defragmenter(Device& device);
+            // frees the retired buffers, the device has to be idle
+            ~Defragmenter();
+
+            Defragmenter(const Defragmenter&) = delete;
+            Defragmenter& operator=(const Defragmenter&) = delete;
+
+            // the buffer needs transfer src and dst usage, untrack it before destroying it
+            void track(Buffer* buffer, std::function<void(Buffer&)> onMoved = nullptr);
+            void untrack(Buffer* buffer);
+
+            // frameIndex's fence has to be waited for, commandBuffer recording outside a render pass;
+            // true when a pass finished this frame
+            bool update(VkCommandBuffer commandBuffer, int frameIndex, float budgetMs = DEFAULT_BUDGET_MS);
+
+            const Stats& getStats() const { return stats; }
+
+        private:
+            void freeRetired(std::vector<Buffer::Retired>& retired);
+
+            Device& device;
+            std::unordered_map<Buffer*, std::function<void(Buffer&)>> buffers{};
+            // per frame in flight, freed when the frame comes around again
+            std::vector<Buffer::Retired> retired[SwapChain::MAX_FRAMES_IN_FLIGHT];
+            bool passActive = false;
+            MemoryAllocator::Stats passStart{};
+            Stats stats{};
+    };
+}
@@ -0,0 +1,79 @@
+#include "deletion_queue.hpp"
+
+namespace engine {
+    DeletionQueue::DeletionQueue(VkDevice device, MemoryAllocator& allocator) : device{device}, allocator{allocator} {}
+
+    DeletionQueue::~DeletionQueue() {
+        flush();
+    }
+
+    void DeletionQueue::push(std::function<void()> deleter) {
+        frames[currentFrame].push_back(std::move(deleter));
+        ++stats.deferred;
+        ++stats.pending;
+    }
+
+    void DeletionQueue::destroyBuffer(VkBuffer buffer, const MemoryAllocator::Allocation& allocation) {
+        push([this, buffer, allocation]() mutable {
+            vkDestroyBuffer(device, buffer, nullptr);
+            allocator.free(allocation);
+        });
+    }
+
+    void DeletionQueue::destroyImage(VkImage image, VkImageView view, const MemoryAllocator::Allocation& allocation) {
+        push([this, image, view, allocation]() mutable {
+            if (view != VK_NULL_HANDLE) vkDestroyImageView(device, view, nullptr);
+            vkDestroyImage(device, image, nullptr);
+            allocator.free(allocation);
+        });
+    }
+
+    void DeletionQueue::destroyImageView(VkImageView view) {
+        push([this, view] { vkDestroyImageView(device, view, nullptr); });
+    }
+
+    void DeletionQueue::destroySampler(VkSampler sampler) {
+        push([this, sampler] { vkDestroySampler(device, sampler, nullptr); });
+    }
+
+    void DeletionQueue::destroyPipeline(VkPipeline pipeline) {
+        push([this, pipeline] { vkDestroyPipeline(device, pipeline, nullptr); });
+    }
+
+    void DeletionQueue::destroyPipelineLayout(VkPipelineLayout layout) {
+        push([this, layout] { vkDestroyPipelineLayout(device, layout, nullptr); });
+    }
+
+    void DeletionQueue::freeDescriptorSets(VkDescriptorPool pool, std::vector<VkDescriptorSet> sets) {
+        push([this, pool, sets = std::move(sets)] {
+            vkFreeDescriptorSets(device, pool, static_cast<uint32_t>(sets.size()), sets.data());
+        });
+    }
+
+    void DeletionQueue::destroyDescriptorPool(VkDescriptorPool pool) {
+        push([this, pool] { vkDestroyDescriptorPool(device, pool, nullptr); });
+    }
+
+    void DeletionQueue::beginFrame(int frameIndex) {
+        currentFrame = frameIndex;
+        run(frames[frameIndex]);
+    }
+
+    void DeletionQueue::flush() {
+        // the list after the current one was queued first; again while deleters queued more
+        while (stats.pending > 0) {
+            for (int i = 1; i <= SwapChain::MAX_FRAMES_IN_FLIGHT; ++i) {
+                run(frames[(currentFrame + i) % SwapChain::MAX_FRAMES_IN_FLIGHT]);
+            }
+        }
+    }
+
+    void DeletionQueue::run(std::vector<std::function<void()>>& deleters) {
+        // a deleter may queue more (e.g. by destroying a Buffer it owns), those wait for the next round
+        std::vector<std::function<void()>> current = std::move(deleters);
+        deleters.clear();
+        for (auto& deleter : current) deleter();
+        stats.destroyed += current.size();
+        stats.pending -= static_cast<uint32_t>(current.size());
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "memory_allocator.hpp"
+#include "swap_chain.hpp"
+
+#include <functional>
+#include <vector>
+
+/*
+    Destroys gpu objects once no submitted frame can still use them, instead of right away
+    (which needs vkDeviceWaitIdle to be safe)
+
+    Everything queued goes into the list of the frame that was begun last, the one being
+    recorded or the last one submitted. Renderer::beginFrame waits for the fence of a frame
+    index and calls beginFrame(frameIndex), which runs that frame's list from
+    MAX_FRAMES_IN_FLIGHT frames ago:
+
+    frame       | 0            | 1     | 2 (fence of 0 waited) | 3 (fence of 1 waited)
+    queued      | model A      | B     |                       |
+    destroyed   |              |       | A                     | B
+
+    Queued between two frames (e.g. a model unloaded before beginFrame), the object goes with
+    the last submitted frame, frames submitted before it finish first.
+
+    Buffer, Pipeline, DescriptorPool and GeometryPool queue their objects here, so unloading
+    and reloading never stalls. Main thread only, like every other Vulkan call.
+*/
+
+namespace engine {
+    class DeletionQueue {
+        public:
+            struct Stats {
+                uint64_t deferred = 0;
+                uint64_t destroyed = 0;
+                // queued and not destroyed yet
+                uint32_t pending = 0;
+            };
+
+            DeletionQueue(VkDevice device, MemoryAllocator& allocator);
+            // runs everything left, the device has to be idle
+            ~DeletionQueue();
+
+            DeletionQueue(const DeletionQueue&) = delete;
+            DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+            void push(std::function<void()> deleter);
+            void destroyBuffer(VkBuffer buffer, const MemoryAllocator::Allocation& allocation);
+            // view may be VK_NULL_HANDLE
+            void destroyImage(VkImage image, VkImageView view, const MemoryAllocator::Allocation& allocation);
+            void destroyImageView(VkImageView view);
+            void destroySampler(VkSampler sampler);
+            void destroyPipeline(VkPipeline pipeline);
+            void destroyPipelineLayout(VkPipelineLayout layout);
+            void freeDescriptorSets(VkDescriptorPool pool, std::vector<VkDescriptorSet> sets);
+            void destroyDescriptorPool(VkDescriptorPool pool);
+
+            // the fence of frameIndex was waited for, runs what was queued the last time it was begun
+            void beginFrame(int frameIndex);
+            // runs every list, oldest first, the device has to be idle
+            void flush();
+
+            const Stats& getStats() const { return stats; }
+
+        private:
+            void run(std::vector<std::function<void()>>& deleters);
+
+            VkDevice device;
+            MemoryAllocator& allocator;
+            std::vector<std::function<void()>> frames[SwapChain::MAX_FRAMES_IN_FLIGHT];
+            int currentFrame = 0;
+            Stats stats{};
+    };
+}
@@ -1,4 +1,5 @@
 #include "descriptors.hpp"
+#include "deletion_queue.hpp"
 
 // std
 #include <cassert>
@@ -99,7 +100,8 @@ DescriptorPool::DescriptorPool(
 }
 
 DescriptorPool::~DescriptorPool() {
-  vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr);
+  // frames in flight may still bind sets from it
+  device.deletionQueue().destroyDescriptorPool(descriptorPool);
 }
 
 bool DescriptorPool::allocateDescriptor(
@@ -119,11 +121,7 @@ bool DescriptorPool::allocateDescriptor(
 }
 
 void DescriptorPool::freeDescriptors(std::vector<VkDescriptorSet> &descriptors) const {
-  vkFreeDescriptorSets(
-      device.device(),
-      descriptorPool,
-      static_cast<uint32_t>(descriptors.size()),
-      descriptors.data());
+  device.deletionQueue().freeDescriptorSets(descriptorPool, descriptors);
 }
 
 void DescriptorPool::resetPool() {
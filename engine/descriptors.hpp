@@ -78,6 +78,7 @@ namespace engine {
             bool allocateDescriptor(
                 const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet &descriptor) const;
 
+            // once the frames in flight are done with them
             void freeDescriptors(std::vector<VkDescriptorSet> &descriptors) const;
 
             void resetPool();
@@ -1,6 +1,11 @@
 #include "device.hpp"
+#include "deletion_queue.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_manager.hpp"
+#include "sampler_cache.hpp"
 
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -54,11 +59,29 @@ Device::Device(Window &window) : window{window} {
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
+  allocator_ = std::make_unique<MemoryAllocator>(device_, physicalDevice, getMemoryProperties2);
+  deletionQueue_ = std::make_unique<DeletionQueue>(device_, *allocator_);
+  samplerCache_ = std::make_unique<SamplerCache>(device_, properties);
+  pipelineCache_ = std::make_unique<PipelineCache>(device_, properties);
+  pipelineManager_ = std::make_unique<PipelineManager>(*this);
   createCommandPool();
+  createTransferTimeline();
 }
 
 Device::~Device() {
+  if (hasTransferQueue()) {
+    vkDestroySemaphore(device_, transferTimeline_, nullptr);
+    vkDestroyCommandPool(device_, transferCommandPool, nullptr);
+  }
   vkDestroyCommandPool(device_, commandPool, nullptr);
+  // joins the workers, dropped pipelines go to the deletion queue
+  pipelineManager_.reset();
+  // whatever the owners queued last, the app waited for the device before tearing down
+  deletionQueue_.reset();
+  samplerCache_.reset();
+  // writes the cache file
+  pipelineCache_.reset();
+  allocator_.reset();
   vkDestroyDevice(device_, nullptr);
 
   if (enableValidationLayers) {
@@ -80,7 +103,23 @@ void Device::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  // 1.2 for timeline semaphores where the loader has it; older loaders get them from
+  // VK_KHR_timeline_semaphore or upload on the graphics queue, see checkTimelineSemaphoreSupport.
+  // vkEnumerateInstanceVersion only exists from 1.1 on
+  auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+      vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+  if (enumerateInstanceVersion == nullptr ||
+      enumerateInstanceVersion(&instanceVersion) != VK_SUCCESS) {
+    instanceVersion = VK_API_VERSION_1_0;
+  }
+  if (instanceVersion >= VK_API_VERSION_1_2) {
+    appInfo.apiVersion = VK_API_VERSION_1_2;
+  } else if (instanceVersion >= VK_API_VERSION_1_1) {
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+  } else {
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+  }
+  instanceVersion = appInfo.apiVersion;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -145,13 +184,48 @@ void Device::pickPhysicalDevice() {
 
   vkGetPhysicalDeviceProperties(physicalDevice, &properties);
   std::cout << "physical device: " << properties.deviceName << std::endl;
+
+  directUploads = checkDirectUploadSupport(physicalDevice);
+  std::cout << "direct geometry uploads: " << (directUploads ? "yes" : "no") << std::endl;
+}
+
+bool Device::checkDirectUploadSupport(VkPhysicalDevice device) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
+
+  // a host visible type on a small device local heap is the 256 MB BAR window of a discrete gpu
+  // without resizable BAR, too scarce for geometry
+  VkDeviceSize largestHeap = 0;
+  for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+    if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      largestHeap = std::max(largestHeap, memProperties.memoryHeaps[i].size);
+    }
+  }
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    const VkMemoryType &type = memProperties.memoryTypes[i];
+    if ((type.propertyFlags & DIRECT_UPLOAD_MEMORY) == DIRECT_UPLOAD_MEMORY &&
+        memProperties.memoryHeaps[type.heapIndex].size == largestHeap) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void Device::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  // the transfer queue signals a timeline semaphore the frame submission waits on
+  bool useTransferQueue =
+      indices.transferFamilyHasValue && checkTimelineSemaphoreSupport(physicalDevice);
+  if (!useTransferQueue) {
+    indices.transferFamilyHasValue = false;
+  }
+  queueIndices = indices;
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  if (useTransferQueue) {
+    uniqueQueueFamilies.insert(indices.transferFamily);
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -163,8 +237,12 @@ void Device::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // optional, without it BC textures are decoded on the cpu (see ktx2_loader.hpp)
+  deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -173,8 +251,25 @@ void Device::createLogicalDevice() {
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+  timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+  timelineFeatures.timelineSemaphore = VK_TRUE;
+  if (useTransferQueue) {
+    createInfo.pNext = &timelineFeatures;
+  }
+
+  // the memory budget extension is optional, budgets are estimated without it
+  std::vector<const char *> extensions = deviceExtensions;
+  if (useTransferQueue && timelineSemaphoreExtension) {
+    extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+  }
+  memoryBudget = checkMemoryBudgetSupport(physicalDevice);
+  if (memoryBudget) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -191,6 +286,36 @@ void Device::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  if (useTransferQueue) {
+    vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+  }
+}
+
+bool Device::checkTimelineSemaphoreSupport(VkPhysicalDevice device) {
+  // core in 1.2 when both the instance and the device have it, otherwise the extension
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  timelineSemaphoreExtension =
+      instanceVersion < VK_API_VERSION_1_2 || deviceProperties.apiVersion < VK_API_VERSION_1_2;
+  if (timelineSemaphoreExtension && !hasDeviceExtension(device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+    return false;
+  }
+
+  VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+  timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &timelineFeatures;
+  // core from 1.1, a 1.0 instance has it from VK_KHR_get_physical_device_properties2
+  auto getFeatures2 = instanceVersion >= VK_API_VERSION_1_1
+      ? vkGetPhysicalDeviceFeatures2
+      : reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+  if (getFeatures2 == nullptr) {
+    return false;
+  }
+  getFeatures2(device, &features);
+  return timelineFeatures.timelineSemaphore == VK_TRUE;
 }
 
 void Device::createCommandPool() {
@@ -205,6 +330,70 @@ void Device::createCommandPool() {
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+
+  if (hasTransferQueue()) {
+    poolInfo.queueFamilyIndex = queueIndices.transferFamily;
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create transfer command pool!");
+    }
+  }
+}
+
+void Device::createTransferTimeline() {
+  if (!hasTransferQueue()) {
+    return;
+  }
+
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+  if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &transferTimeline_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create transfer timeline semaphore!");
+  }
+}
+
+void Device::completeTransfer(
+    uint64_t value,
+    const std::vector<VkBufferMemoryBarrier> &bufferAcquires,
+    const std::vector<VkImageMemoryBarrier> &imageAcquires,
+    const std::vector<std::function<void(VkCommandBuffer)>> &graphicsWork) {
+  completedTransferValue = std::max(completedTransferValue, value);
+  pendingBufferAcquires.insert(
+      pendingBufferAcquires.end(), bufferAcquires.begin(), bufferAcquires.end());
+  pendingImageAcquires.insert(
+      pendingImageAcquires.end(), imageAcquires.begin(), imageAcquires.end());
+  pendingGraphicsWork.insert(pendingGraphicsWork.end(), graphicsWork.begin(), graphicsWork.end());
+}
+
+void Device::recordTransferAcquires(VkCommandBuffer commandBuffer) {
+  if (pendingBufferAcquires.empty() && pendingImageAcquires.empty() && pendingGraphicsWork.empty()) {
+    return;
+  }
+
+  // the submission waits on the timeline for all commands, so the barriers chain to that wait
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0,
+      0,
+      nullptr,
+      static_cast<uint32_t>(pendingBufferAcquires.size()),
+      pendingBufferAcquires.data(),
+      static_cast<uint32_t>(pendingImageAcquires.size()),
+      pendingImageAcquires.data());
+  pendingBufferAcquires.clear();
+  pendingImageAcquires.clear();
+
+  for (auto &work : pendingGraphicsWork) {
+    work(commandBuffer);
+  }
+  pendingGraphicsWork.clear();
 }
 
 void Device::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -334,6 +523,44 @@ bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool Device::checkMemoryBudgetSupport(VkPhysicalDevice device) {
+  getMemoryProperties2 = nullptr;
+  if (!hasDeviceExtension(device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    return false;
+  }
+  // the budget is chained into vkGetPhysicalDeviceMemoryProperties2: core when the instance and the
+  // device are 1.1, otherwise the KHR entry point of VK_KHR_get_physical_device_properties2
+  // (createInstance enables it); neither leaves the allocator to its estimate
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  if (instanceVersion >= VK_API_VERSION_1_1 && deviceProperties.apiVersion >= VK_API_VERSION_1_1) {
+    getMemoryProperties2 = vkGetPhysicalDeviceMemoryProperties2;
+  } else {
+    getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+  }
+  return getMemoryProperties2 != nullptr;
+}
+
+bool Device::hasDeviceExtension(VkPhysicalDevice device, const char *name) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      device,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -345,6 +572,11 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
+    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+        !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.transferFamilyHasValue) {
+      indices.transferFamily = i;
+      indices.transferFamilyHasValue = true;
+    }
     if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
@@ -355,7 +587,7 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
     }
-    if (indices.isComplete()) {
+    if (indices.isComplete() && indices.transferFamilyHasValue) {
       break;
     }
 
@@ -407,6 +639,15 @@ VkFormat Device::findSupportedFormat(
   throw std::runtime_error("failed to find supported format!");
 }
 
+bool Device::supportsFormatFeatures(
+    VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) {
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+  VkFormatFeatureFlags supported =
+      tiling == VK_IMAGE_TILING_LINEAR ? props.linearTilingFeatures : props.optimalTilingFeatures;
+  return (supported & features) == features;
+}
+
 uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
   VkPhysicalDeviceMemoryProperties memProperties;
   vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
@@ -425,30 +666,70 @@ void Device::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
-  VkBufferCreateInfo bufferInfo{};
-  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = size;
-  bufferInfo.usage = usage;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    MemoryAllocator::Allocation &bufferMemory,
+    VkSharingMode sharingMode) {
+  buffer = createBufferHandle(size, usage, sharingMode);
 
-  if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create vertex buffer!");
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
+
+  bufferMemory = allocator_->allocate(
+      memRequirements,
+      findMemoryType(memRequirements.memoryTypeBits, properties),
+      true);
+
+  if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind vertex buffer memory!");
   }
+}
+
+bool Device::createBufferOutside(
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    const MemoryAllocator::Allocation &current,
+    VkBuffer &buffer,
+    MemoryAllocator::Allocation &bufferMemory,
+    VkSharingMode sharingMode) {
+  buffer = createBufferHandle(size, usage, sharingMode);
 
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  bufferMemory = allocator_->allocateOutside(memRequirements, current.memoryType, true, current.block);
+  if (bufferMemory.memory == VK_NULL_HANDLE) {
+    vkDestroyBuffer(device_, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+    return false;
+  }
+
+  if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind vertex buffer memory!");
+  }
+  return true;
+}
+
+VkBuffer Device::createBufferHandle(
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    VkSharingMode sharingMode) {
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  uint32_t sharedFamilies[] = {queueIndices.graphicsFamily, queueIndices.transferFamily};
+  if (sharingMode == VK_SHARING_MODE_CONCURRENT && hasTransferQueue()) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices = sharedFamilies;
   }
 
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+  VkBuffer buffer;
+  if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create vertex buffer!");
+  }
+  return buffer;
 }
 
 VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -466,6 +747,8 @@ VkCommandBuffer Device::beginSingleTimeCommands() {
   beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
   vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  // e.g. a geometry pool repack may read buffers the transfer queue just filled
+  recordTransferAcquires(commandBuffer);
   return commandBuffer;
 }
 
@@ -477,6 +760,19 @@ void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
+  uint64_t waitValue = transferWaitValue();
+  VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  if (waitValue > 0) {
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = &waitValue;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &transferTimeline_;
+    submitInfo.pWaitDstStageMask = &waitStage;
+  }
+
   vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
   vkQueueWaitIdle(graphicsQueue_);
 
@@ -526,7 +822,7 @@ void Device::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
+    MemoryAllocator::Allocation &imageMemory) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
@@ -534,16 +830,13 @@ void Device::createImageWithInfo(
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
+  // optimal tiling images are kept apart from buffers because of bufferImageGranularity
+  imageMemory = allocator_->allocate(
+      memRequirements,
+      findMemoryType(memRequirements.memoryTypeBits, properties),
+      imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+  if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
     throw std::runtime_error("failed to bind image memory!");
   }
 }
@@ -1,13 +1,21 @@
 #pragma once
 
+#include "memory_allocator.hpp"
 #include "window.hpp"
 
 // std lib headers
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace engine {
 
+class DeletionQueue;
+class PipelineCache;
+class PipelineManager;
+class SamplerCache;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +25,11 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // a family that can transfer but not draw, usually a dedicated copy engine
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -42,22 +53,80 @@ class Device {
   VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
+  VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
 
+  // Dedicated transfer queue, only set up when the device has a transfer-only queue family and
+  // timeline semaphores; without it uploads are submitted to the graphics queue
+  bool hasTransferQueue() { return transferQueue_ != VK_NULL_HANDLE; }
+  VkQueue transferQueue() { return transferQueue_; }
+  VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+  uint32_t graphicsQueueFamily() { return queueIndices.graphicsFamily; }
+  uint32_t transferQueueFamily() { return queueIndices.transferFamily; }
+
+  // Timeline semaphore signaled by transfer queue submissions, each one with the next value
+  VkSemaphore transferTimeline() { return transferTimeline_; }
+  uint64_t nextTransferValue() { return ++transferValue; }
+  // Called once the transfer submission that signals value has finished. Its acquire barriers are
+  // recorded by the next graphics submission, which waits for the timeline to reach value.
+  // graphicsWork is recorded right behind the barriers (e.g. mip blits, the transfer queue can't blit)
+  void completeTransfer(
+      uint64_t value,
+      const std::vector<VkBufferMemoryBarrier> &bufferAcquires,
+      const std::vector<VkImageMemoryBarrier> &imageAcquires,
+      const std::vector<std::function<void(VkCommandBuffer)>> &graphicsWork = {});
+  // Records the pending acquire barriers and graphics work, the submission of commandBuffer has to
+  // wait for transferTimeline() to reach transferWaitValue() (0: nothing to wait for)
+  void recordTransferAcquires(VkCommandBuffer commandBuffer);
+  uint64_t transferWaitValue() { return completedTransferValue; }
+
+  // UMA, resizable BAR and software implementations: the main device local heap is host visible,
+  // so geometry can be written into it without a staging copy
+  bool supportsDirectUploads() { return directUploads; }
+  static constexpr VkMemoryPropertyFlags DIRECT_UPLOAD_MEMORY = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  // Sub-allocates the memory of createBuffer and createImageWithInfo, see memory_allocator.hpp
+  MemoryAllocator &allocator() { return *allocator_; }
+  // VK_EXT_memory_budget is enabled, allocator().getHeapBudgets() reports driver values
+  bool supportsMemoryBudget() { return memoryBudget; }
+  // Destroys buffers, images, pipelines and descriptor sets once the frames that may use them
+  // finished, see deletion_queue.hpp
+  DeletionQueue &deletionQueue() { return *deletionQueue_; }
+  // Samplers shared by every texture, see sampler_cache.hpp
+  SamplerCache &samplerCache() { return *samplerCache_; }
+  // Shared by every pipeline, loaded from and saved to disk, see pipeline_cache.hpp
+  PipelineCache &pipelineCache() { return *pipelineCache_; }
+  // Deduplicates pipelines and compiles them on worker threads, see pipeline_manager.hpp
+  PipelineManager &pipelineManager() { return *pipelineManager_; }
+
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+  bool supportsFormatFeatures(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
 
   // Buffer Helper Functions
+  // concurrent buffers are shared by the graphics and transfer queue families
+  // without ownership transfers. The memory comes from allocator(), free it there
   void createBuffer(
       VkDeviceSize size,
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      MemoryAllocator::Allocation &bufferMemory,
+      VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
+  // For the defragmenter: a buffer like createBuffer's, in the memory type of current but in
+  // another block the allocator already has. False, with nothing created, when none has room
+  bool createBufferOutside(
+      VkDeviceSize size,
+      VkBufferUsageFlags usage,
+      const MemoryAllocator::Allocation &current,
+      VkBuffer &buffer,
+      MemoryAllocator::Allocation &bufferMemory,
+      VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -68,7 +137,7 @@ class Device {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      MemoryAllocator::Allocation &imageMemory);
 
   VkPhysicalDeviceProperties properties;
 
@@ -79,6 +148,8 @@ class Device {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createTransferTimeline();
+  VkBuffer createBufferHandle(VkDeviceSize size, VkBufferUsageFlags usage, VkSharingMode sharingMode);
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -88,6 +159,10 @@ class Device {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool checkTimelineSemaphoreSupport(VkPhysicalDevice device);
+  bool checkDirectUploadSupport(VkPhysicalDevice device);
+  bool checkMemoryBudgetSupport(VkPhysicalDevice device);
+  bool hasDeviceExtension(VkPhysicalDevice device, const char *name);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
@@ -101,6 +176,29 @@ class Device {
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
 
+  QueueFamilyIndices queueIndices;
+  std::unique_ptr<MemoryAllocator> allocator_;
+  std::unique_ptr<DeletionQueue> deletionQueue_;
+  std::unique_ptr<SamplerCache> samplerCache_;
+  std::unique_ptr<PipelineCache> pipelineCache_;
+  std::unique_ptr<PipelineManager> pipelineManager_;
+  bool directUploads = false;
+  bool memoryBudget = false;
+  // reads the budget, core from 1.1 or VK_KHR_get_physical_device_properties2; nullptr without memoryBudget
+  PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2 = nullptr;
+  // what the loader supports, the instance is created with up to 1.2 of it
+  uint32_t instanceVersion = VK_API_VERSION_1_0;
+  // timeline semaphores come from VK_KHR_timeline_semaphore, not from core 1.2
+  bool timelineSemaphoreExtension = false;
+  VkQueue transferQueue_ = VK_NULL_HANDLE;
+  VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+  VkSemaphore transferTimeline_ = VK_NULL_HANDLE;
+  uint64_t transferValue = 0;
+  uint64_t completedTransferValue = 0;
+  std::vector<VkBufferMemoryBarrier> pendingBufferAcquires;
+  std::vector<VkImageMemoryBarrier> pendingImageAcquires;
+  std::vector<std::function<void(VkCommandBuffer)>> pendingGraphicsWork;
+
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, "VK_KHR_portability_subset"};
 };
@@ -0,0 +1,47 @@
+#include "frame_allocator.hpp"
+#include "swap_chain.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace engine {
+    FrameAllocator::FrameAllocator(Device& device, VkDeviceSize frameSize, VkBufferUsageFlags usage) : device{device} {
+        // partitions start on an offset every binding type accepts
+        const auto& limits = device.properties.limits;
+        VkDeviceSize alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+        this->frameSize = (frameSize + alignment - 1) / alignment * alignment;
+
+        buffer = std::make_unique<Buffer>(
+            device,
+            this->frameSize,
+            SwapChain::MAX_FRAMES_IN_FLIGHT,
+            usage,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        if (buffer->map() != VK_SUCCESS) throw std::runtime_error("Failed to map frame allocator buffer");
+    }
+
+    void FrameAllocator::beginFrame(int frameIndex) {
+        frameStart = frameSize * frameIndex;
+        head = frameStart;
+    }
+
+    FrameAllocator::Allocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+        if (alignment == 0) alignment = device.properties.limits.minUniformBufferOffsetAlignment;
+        VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+        if (offset + size > frameStart + frameSize) {
+            throw std::runtime_error("Frame allocator out of memory, " + std::to_string(frameSize) + " bytes per frame");
+        }
+        head = offset + size;
+
+        Allocation allocation{};
+        allocation.data = static_cast<char*>(buffer->getMappedMemory()) + offset;
+        allocation.offset = static_cast<uint32_t>(offset);
+        allocation.size = size;
+        return allocation;
+    }
+
+    void FrameAllocator::write(const Allocation& allocation, const void* data) {
+        buffer->writeToBuffer(const_cast<void*>(data), allocation.size, allocation.offset);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+
+#include <memory>
+
+/*
+    Per-frame bump allocator for data the cpu writes once and the gpu reads in the same frame
+    (the global ubo, per-draw uniforms, dynamic storage data)
+
+    One persistently mapped buffer, split in a partition per frame in flight:
+
+    buffer  | frame 0          | frame 1          |
+            |ubo|draw|draw|    |ubo|              |
+                          ^ head            ^ head
+
+    allocate() moves the head of the current partition forward and returns the host pointer
+    to write to and the offset to pass as the dynamic offset of a
+    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC / STORAGE_BUFFER_DYNAMIC binding, so one
+    descriptor set (descriptorInfo()) serves every frame and every draw.
+
+    beginFrame(frameIndex) rewinds the partition, call it after Renderer::beginFrame, which
+    waited for the fence of that frame, so nothing the gpu may still read is overwritten.
+    Nothing is allocated or freed per frame.
+*/
+
+namespace engine {
+    class FrameAllocator {
+        public:
+            static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 256 * 1024;
+
+            struct Allocation {
+                // host pointer, write before the frame is submitted
+                void* data = nullptr;
+                // dynamic offset into the buffer
+                uint32_t offset = 0;
+                VkDeviceSize size = 0;
+            };
+
+            FrameAllocator(Device& device, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE,
+                VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+            FrameAllocator(const FrameAllocator&) = delete;
+            FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+            void beginFrame(int frameIndex);
+            // alignment 0: minUniformBufferOffsetAlignment, throws when the frame's partition is full
+            Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+            // copies allocation.size bytes, writes through allocation.data skip the dirty tracking
+            void write(const Allocation& allocation, const void* data);
+            template<typename T>
+            Allocation push(const T& data) {
+                Allocation allocation = allocate(sizeof(T));
+                write(allocation, &data);
+                return allocation;
+            }
+            // flushes what write() touched this frame, nothing on coherent memory
+            void flush() { buffer->flushDirty(); }
+
+            // binds range bytes at the dynamic offset, range is the size of the largest struct read through it
+            VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) { return buffer->descriptorInfo(range, 0); }
+            VkBuffer getBuffer() const { return buffer->getBuffer(); }
+            VkDeviceSize getFrameSize() const { return frameSize; }
+            // bytes allocated in the current frame
+            VkDeviceSize getUsedBytes() const { return head - frameStart; }
+
+        private:
+            Device& device;
+            VkDeviceSize frameSize;
+            std::unique_ptr<Buffer> buffer;
+            VkDeviceSize frameStart = 0;
+            VkDeviceSize head = 0;
+    };
+}
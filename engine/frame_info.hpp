@@ -37,5 +37,9 @@ namespace engine {
         Camera& camera;
         VkDescriptorSet globalDescriptorSet;
         GameObject::Map &gameObjects; 
+        // size of the render target, screen-space measures (LOD selection) depend on it
+        VkExtent2D extent;
+        // dynamic offset of this frame's GlobalUbo, bound with globalDescriptorSet
+        uint32_t globalUboOffset;
     };
 }
\ No newline at end of file
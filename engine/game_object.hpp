@@ -1,6 +1,7 @@
 #pragma once
 
 #include "model.hpp"
+#include "texture.hpp"
 
 #include <memory>
 #include <unordered_map>
@@ -62,6 +63,8 @@ namespace engine {
 
             // optional components
             std::shared_ptr<Model> model{};
+            // sampled with the model's uvs, nullptr draws the vertex colors alone (a white texture)
+            std::shared_ptr<Texture> texture{};
             std::unique_ptr<PointLightComponent> pointLight = nullptr;
 
         private:
@@ -0,0 +1,258 @@
+#include "geometry_pool.hpp"
+#include "deletion_queue.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace engine {
+    namespace {
+        VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+            // vertex sizes are not powers of two, so no bit tricks here
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    GeometryPool::GeometryPool(Device& device, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity)
+        : device{device} {
+        vertices.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        indices.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        for (auto* region : {&vertices, &indices}) {
+            region->capacity = region == &vertices ? vertexCapacity : indexCapacity;
+            region->buffer = createBuffer(*region, region->capacity);
+            region->freeRanges.emplace(0, region->capacity);
+        }
+    }
+
+    GeometryPool::~GeometryPool() {
+        // releases queued by free() point at this pool
+        device.deletionQueue().flush();
+    }
+
+    std::unique_ptr<Buffer> GeometryPool::createBuffer(const Region& region, VkDeviceSize capacity) {
+        // transfer src for compaction, transfer dst for uploads; shared with the transfer queue, since
+        // ownership transfers of single ranges would have to cover every repack as well
+        auto buffer = std::make_unique<Buffer>(
+            device,
+            1,
+            static_cast<uint32_t>(capacity),
+            region.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            device.supportsDirectUploads() ? Device::DIRECT_UPLOAD_MEMORY : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            1,
+            VK_SHARING_MODE_CONCURRENT);
+        // stays mapped, models write their geometry in place
+        if (device.supportsDirectUploads()) buffer->map();
+        return buffer;
+    }
+
+    GeometryPool::Allocation* GeometryPool::allocate(Region& region, VkDeviceSize size, VkDeviceSize alignment, UploadBatch* upload) {
+        auto allocation = std::make_unique<Allocation>();
+        allocation->size = size;
+        allocation->alignment = alignment;
+
+        if (!tryAllocate(region, *allocation)) {
+            // repack the holes away, and grow when the packed contents plus the request still don't fit
+            VkDeviceSize needed = size + alignment;
+            for (const auto& live : region.allocations) needed += live->size + live->alignment;
+            VkDeviceSize capacity = region.capacity;
+            while (capacity < needed) capacity *= 2;
+            repack(region, capacity, upload);
+            if (!tryAllocate(region, *allocation)) throw std::runtime_error("Failed to allocate from the geometry pool");
+        }
+        // while a repack is in flight this points into the target, which is fine: nothing draws
+        // the range before the batch uploading it completed, and the swap sets it again
+        allocation->offset = allocation->uploadOffset;
+
+        region.used += size;
+        region.allocations.push_back(std::move(allocation));
+        return region.allocations.back().get();
+    }
+
+    bool GeometryPool::tryAllocate(Region& region, Allocation& allocation) {
+        // first fit, the padding in front of an aligned range stays free
+        for (auto it = region.freeRanges.begin(); it != region.freeRanges.end(); ++it) {
+            VkDeviceSize rangeStart = it->first;
+            VkDeviceSize rangeEnd = it->first + it->second;
+            VkDeviceSize offset = alignUp(rangeStart, allocation.alignment);
+            if (offset + allocation.size > rangeEnd) continue;
+
+            region.freeRanges.erase(it);
+            if (offset > rangeStart) region.freeRanges.emplace(rangeStart, offset - rangeStart);
+            if (offset + allocation.size < rangeEnd) {
+                region.freeRanges.emplace(offset + allocation.size, rangeEnd - (offset + allocation.size));
+            }
+            allocation.uploadOffset = offset;
+            return true;
+        }
+        return false;
+    }
+
+    void GeometryPool::free(Allocation* allocation) {
+        for (auto* region : {&vertices, &indices}) {
+            auto& allocations = region->allocations;
+            auto it = std::find_if(allocations.begin(), allocations.end(),
+                [allocation](const std::unique_ptr<Allocation>& live) { return live.get() == allocation; });
+            if (it == allocations.end()) continue;
+
+            region->used -= allocation->size;
+            device.deletionQueue().push([this, region, offset = allocation->uploadOffset, size = allocation->size,
+                generation = region->generation] {
+                if (region->generation == generation) release(*region, offset, size);
+            });
+            allocations.erase(it);
+            return;
+        }
+        throw std::runtime_error("Allocation does not belong to this geometry pool");
+    }
+
+    void GeometryPool::release(Region& region, VkDeviceSize offset, VkDeviceSize size) {
+        auto inserted = region.freeRanges.emplace(offset, size).first;
+        // merge with the following range, then with the preceding one
+        auto next = std::next(inserted);
+        if (next != region.freeRanges.end() && inserted->first + inserted->second == next->first) {
+            inserted->second += next->second;
+            region.freeRanges.erase(next);
+        }
+        if (inserted != region.freeRanges.begin()) {
+            auto previous = std::prev(inserted);
+            if (previous->first + previous->second == inserted->first) {
+                previous->second += inserted->second;
+                region.freeRanges.erase(inserted);
+            }
+        }
+    }
+
+    float GeometryPool::fragmentation(const Region& region) const {
+        // free ranges below the end of the last allocation are holes, unless they are alignment
+        // padding, which a repack would keep anyway
+        VkDeviceSize end = 0;
+        for (const auto& live : region.allocations) end = std::max(end, live->uploadOffset + live->size);
+        if (end == 0) return 0.f;
+        VkDeviceSize holes = 0;
+        for (const auto& range : region.freeRanges) {
+            if (range.first < end && range.second >= MIN_HOLE_SIZE) holes += range.second;
+        }
+        return static_cast<float>(holes) / static_cast<float>(end);
+    }
+
+    bool GeometryPool::compactIfFragmented() {
+        if (isRepackPending()) return false;
+        if (fragmentation(vertices) <= MAX_FRAGMENTATION && fragmentation(indices) <= MAX_FRAGMENTATION) return false;
+        compact();
+        return true;
+    }
+
+    VkDeviceSize GeometryPool::fitCapacity(const Region& region, VkDeviceSize freed) const {
+        if (region.target != nullptr) return region.capacity;
+        // the same reserve allocate() grows by, the padding in front of every range included
+        VkDeviceSize needed = 0;
+        for (const auto& live : region.allocations) needed += live->size + live->alignment;
+        needed -= std::min(needed, freed);
+        VkDeviceSize capacity = region.capacity;
+        while (capacity / 2 >= std::max(needed, MIN_CAPACITY)) capacity /= 2;
+        return capacity;
+    }
+
+    VkDeviceSize GeometryPool::getShrinkableBytes(VkDeviceSize vertexBytesFreed, VkDeviceSize indexBytesFreed) const {
+        return vertices.capacity - fitCapacity(vertices, vertexBytesFreed) +
+            indices.capacity - fitCapacity(indices, indexBytesFreed);
+    }
+
+    VkDeviceSize GeometryPool::shrinkToFit() {
+        if (isRepackPending()) return 0;
+        VkDeviceSize released = 0;
+        for (auto* region : {&vertices, &indices}) {
+            VkDeviceSize capacity = fitCapacity(*region);
+            if (capacity == region->capacity) continue;
+            released += region->capacity - capacity;
+            repack(*region, capacity);
+        }
+        return released;
+    }
+
+    void GeometryPool::compact() {
+        repack(vertices, vertices.capacity);
+        repack(indices, indices.capacity);
+    }
+
+    void GeometryPool::repack(Region& region, VkDeviceSize capacity, UploadBatch* upload) {
+        bool deferred = upload != nullptr && upload->usesTransferQueue();
+        // the pending batch may still be writing the target
+        if (region.target != nullptr && !deferred) {
+            throw std::runtime_error("Geometry pool repack in flight on the transfer queue");
+        }
+        // the copies read what the uploads so far wrote
+        Buffer& source = region.target != nullptr ? *region.target : *region.buffer;
+        std::unique_ptr<Buffer> packed = createBuffer(region, capacity);
+        region.capacity = capacity;
+        ++region.generation;
+
+        // live ranges in offset order, moved down as far as their alignment allows
+        std::vector<Allocation*> live{};
+        for (const auto& allocation : region.allocations) live.push_back(allocation.get());
+        std::sort(live.begin(), live.end(),
+            [](const Allocation* a, const Allocation* b) { return a->uploadOffset < b->uploadOffset; });
+
+        std::vector<VkBufferCopy> copies{};
+        region.freeRanges.clear();
+        VkDeviceSize end = 0;
+        for (Allocation* allocation : live) {
+            VkDeviceSize offset = alignUp(end, allocation->alignment);
+            // only the alignment padding between packed ranges stays free
+            if (offset > end) region.freeRanges.emplace(end, offset - end);
+            copies.push_back({allocation->uploadOffset, offset, allocation->size});
+            allocation->uploadOffset = offset;
+            // deferred, draws keep the old offset until the swap
+            if (!deferred) allocation->offset = offset;
+            end = offset + allocation->size;
+        }
+        if (end < region.capacity) region.freeRanges.emplace(end, region.capacity - end);
+
+        if (!copies.empty()) {
+            VkCommandBuffer commandBuffer = upload != nullptr ? upload->getCommandBuffer() : device.beginSingleTimeCommands();
+            // uploads submitted or recorded earlier may still be writing the old buffer
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+            vkCmdCopyBuffer(commandBuffer, source.getBuffer(), packed->getBuffer(),
+                static_cast<uint32_t>(copies.size()), copies.data());
+            if (upload == nullptr) {
+                barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                    0, 1, &barrier, 0, nullptr, 0, nullptr);
+                // waits for the queue, so no frame reads the old buffer once it is destroyed below
+                device.endSingleTimeCommands(commandBuffer);
+            }
+        }
+
+        if (deferred) {
+            // frames keep drawing region.buffer at the old offsets; a target replaced by this repack
+            // is read by the copies above and written by the uploads before them
+            if (region.target != nullptr) upload->keepAlive(std::move(region.target));
+            region.target = std::move(packed);
+            // runs on the host once the batch completed, ahead of the first frame waiting for it
+            upload->recordOnGraphicsQueue([&region, generation = region.generation](VkCommandBuffer) {
+                // a later repack took over the target, its own batch swaps it in
+                if (region.generation != generation) return;
+                region.buffer = std::move(region.target);
+                for (auto& allocation : region.allocations) allocation->offset = allocation->uploadOffset;
+            });
+        } else {
+            std::unique_ptr<Buffer> old = std::move(region.buffer);
+            region.buffer = std::move(packed);
+            // the batch makes its copies visible when submitted; frames submitted before it
+            // still read the old buffer, which goes with the staging buffers
+            if (upload != nullptr && !copies.empty()) upload->keepAlive(std::move(old));
+        }
+        ++compactions;
+    }
+
+    void GeometryPool::bind(VkCommandBuffer commandBuffer, VkIndexType indexType) {
+        VkBuffer buffers[] = {vertices.buffer->getBuffer()};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indices.buffer->getBuffer(), 0, indexType);
+    }
+}
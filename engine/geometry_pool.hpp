@@ -0,0 +1,141 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+#include "upload_batch.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+/*
+    Shared geometry storage: one device local vertex buffer and one index buffer
+    for every Model created while the pool is set (Model::setGeometryPool)
+
+    Models sub-allocate byte ranges from the two buffers. A vertex range starts at a
+    multiple of its vertex size and an index range at a multiple of its index size,
+    so models draw with vertexOffset / firstIndex into buffers bound once, whatever
+    their vertex layout or index type.
+
+    vertex buffer | room (44 B) |free| vase (24 B) | quad (20 B) |   free   |
+    index buffer  | room (u16) | vase (u16) |   free    | quad (u16) | free |
+
+    Where the device supports direct uploads both buffers live in host visible
+    device local memory and stay mapped, so models write into them without staging.
+
+    Free ranges are kept sorted by offset and merged with their neighbours. When a
+    request doesn't fit, or compact() is called after unloads left holes, the live
+    ranges are copied packed into a new buffer (twice as big if needed) and every
+    Allocation's offset is updated in place.
+
+    A repack recorded into a batch on the dedicated transfer queue runs alongside the
+    frames, so the new buffer only replaces the bound one once the batch completed:
+
+    transfer queue | uploads, repack copies -> target | signal N |
+    graphics queue | frame (buffer, offset) | frame (buffer, offset) | wait N, swap: frame (target, uploadOffset) |
+
+    Until then uploads go to the target at uploadOffset, and draws keep using offset.
+*/
+
+namespace engine {
+    class GeometryPool {
+        public:
+            static constexpr VkDeviceSize DEFAULT_VERTEX_CAPACITY = 16 * 1024 * 1024;
+            static constexpr VkDeviceSize DEFAULT_INDEX_CAPACITY = 4 * 1024 * 1024;
+            // compactIfFragmented() repacks once the holes hold this share of the used range
+            static constexpr float MAX_FRAGMENTATION = 0.25f;
+            // smaller free ranges are alignment padding (at most one vertex), not holes
+            static constexpr VkDeviceSize MIN_HOLE_SIZE = 64;
+            // shrinkToFit() doesn't go below this per buffer
+            static constexpr VkDeviceSize MIN_CAPACITY = 1024 * 1024;
+
+            // a byte range of one of the buffers, owned by the pool, offset changes on compaction
+            struct Allocation {
+                // where draws find it in the bound buffer
+                VkDeviceSize offset = 0;
+                // where uploads write it, differs from offset while a repack is in flight
+                VkDeviceSize uploadOffset = 0;
+                VkDeviceSize size = 0;
+                VkDeviceSize alignment = 1;
+            };
+
+            GeometryPool(Device& device,
+                VkDeviceSize vertexCapacity = DEFAULT_VERTEX_CAPACITY, VkDeviceSize indexCapacity = DEFAULT_INDEX_CAPACITY);
+
+            // runs the queued range releases, the device has to be idle
+            ~GeometryPool();
+
+            GeometryPool(const GeometryPool&) = delete;
+            GeometryPool& operator=(const GeometryPool&) = delete;
+
+            // alignment doubles as the element size, offset / alignment is the vertexOffset (firstIndex);
+            // pass the batch the caller records its copy into, a repack then goes into the same batch
+            // behind the copies already recorded into the old buffer
+            Allocation* allocateVertices(VkDeviceSize size, VkDeviceSize vertexSize, UploadBatch* upload = nullptr) {
+                return allocate(vertices, size, vertexSize, upload);
+            }
+            Allocation* allocateIndices(VkDeviceSize size, VkDeviceSize indexSize, UploadBatch* upload = nullptr) {
+                return allocate(indices, size, indexSize, upload);
+            }
+            // the range is reused once the frames in flight are done with it (Device::deletionQueue())
+            void free(Allocation* allocation);
+
+            // repacks both buffers, waits for the copies; not while a transfer queue repack is in flight
+            void compact();
+            // false while a transfer queue repack is in flight
+            bool compactIfFragmented();
+            // repacks a buffer into one of half the size (or less) while its live ranges fit, waits for
+            // the copies; returns the bytes handed back, 0 while a transfer queue repack is in flight
+            VkDeviceSize shrinkToFit();
+            // what shrinkToFit() would hand back once ranges of that many more bytes were freed
+            VkDeviceSize getShrinkableBytes(VkDeviceSize vertexBytesFreed = 0, VkDeviceSize indexBytesFreed = 0) const;
+
+            // binds both buffers, the index type applies to every index range drawn until the next bind
+            void bind(VkCommandBuffer commandBuffer, VkIndexType indexType);
+
+            // the bound buffers, replaced by every repack, don't hold on to them
+            Buffer& getVertexBuffer() const { return *vertices.buffer; }
+            Buffer& getIndexBuffer() const { return *indices.buffer; }
+            // the buffers uploads write at Allocation::uploadOffset
+            Buffer& getUploadVertexBuffer() const { return vertices.target ? *vertices.target : *vertices.buffer; }
+            Buffer& getUploadIndexBuffer() const { return indices.target ? *indices.target : *indices.buffer; }
+            bool isRepackPending() const { return vertices.target || indices.target; }
+            VkDeviceSize getCapacity() const { return vertices.capacity + indices.capacity; }
+            VkDeviceSize getUsedBytes() const { return vertices.used + indices.used; }
+            uint32_t getCompactionCount() const { return compactions; }
+
+        private:
+            struct Region {
+                VkBufferUsageFlags usage;
+                std::unique_ptr<Buffer> buffer;
+                // written by a transfer queue repack, replaces buffer once the batch completed
+                std::unique_ptr<Buffer> target;
+                // of the newest buffer, as are the free ranges
+                VkDeviceSize capacity = 0;
+                VkDeviceSize used = 0;
+                // uploadOffset -> size
+                std::map<VkDeviceSize, VkDeviceSize> freeRanges{};
+                std::vector<std::unique_ptr<Allocation>> allocations{};
+                // bumped by every repack, ranges freed before it are free in the new buffer already
+                uint32_t generation = 0;
+            };
+
+            Allocation* allocate(Region& region, VkDeviceSize size, VkDeviceSize alignment, UploadBatch* upload);
+            bool tryAllocate(Region& region, Allocation& allocation);
+            void release(Region& region, VkDeviceSize offset, VkDeviceSize size);
+            // copies the live ranges packed into a new buffer of at least capacity bytes, waits for the
+            // copies unless they are recorded into upload, which then keeps the old buffer alive; on
+            // the transfer queue the new buffer is bound only once upload completed
+            void repack(Region& region, VkDeviceSize capacity, UploadBatch* upload = nullptr);
+            float fragmentation(const Region& region) const;
+            // the smallest power of two fraction of the capacity the live ranges, less freed bytes, fit into
+            VkDeviceSize fitCapacity(const Region& region, VkDeviceSize freed = 0) const;
+            std::unique_ptr<Buffer> createBuffer(const Region& region, VkDeviceSize capacity);
+
+            Device& device;
+            Region vertices{};
+            Region indices{};
+            uint32_t compactions = 0;
+    };
+}
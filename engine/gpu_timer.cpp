@@ -0,0 +1,58 @@
+#include "gpu_timer.hpp"
+
+#include <stdexcept>
+
+namespace engine {
+    GpuTimer::GpuTimer(Device& device, uint32_t frameCount)
+        : device{device}, timestampPeriod{device.properties.limits.timestampPeriod}, measured(frameCount, false) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &familyCount, families.data());
+        uint32_t validBits = families[device.graphicsQueueFamily()].timestampValidBits;
+        if (validBits == 0 || timestampPeriod == 0.0) return;
+        timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = frameCount * 2;
+        if (vkCreateQueryPool(device.device(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+    }
+
+    GpuTimer::~GpuTimer() {
+        vkDestroyQueryPool(device.device(), queryPool, nullptr);
+    }
+
+    bool GpuTimer::collect(int frameIndex, double& milliseconds) {
+        if (!isSupported() || !measured[frameIndex]) return false;
+        measured[frameIndex] = false;
+
+        uint64_t timestamps[2];
+        if (vkGetQueryPoolResults(device.device(), queryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps,
+                sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return false;
+        }
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+        milliseconds = static_cast<double>(ticks) * timestampPeriod / 1e6;
+        return true;
+    }
+
+    void GpuTimer::reset(VkCommandBuffer commandBuffer, int frameIndex) {
+        if (!isSupported()) return;
+        vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * 2, 2);
+    }
+
+    void GpuTimer::begin(VkCommandBuffer commandBuffer, int frameIndex) {
+        if (!isSupported()) return;
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frameIndex * 2);
+    }
+
+    void GpuTimer::end(VkCommandBuffer commandBuffer, int frameIndex) {
+        if (!isSupported()) return;
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frameIndex * 2 + 1);
+        measured[frameIndex] = true;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <vector>
+
+/*
+    GPU time of a span of a frame's commands, from a pair of timestamp queries per frame in flight
+
+    frame N:  beginFrame() (fence of N - frameCount waited) | collect(): read N - frameCount's pair
+              reset()  (outside the render pass)            | begin() ... commands ... end()
+
+    The slot of a frame is read once the frame that reused it waited for its fence, so
+    collect() never stalls. When the graphics queue family has no timestamp bits,
+    isSupported() is false and every call does nothing. Differences are taken modulo
+    2^timestampValidBits, the counter may wrap between begin() and end().
+*/
+
+namespace engine {
+    class GpuTimer {
+        public:
+            GpuTimer(Device& device, uint32_t frameCount);
+            ~GpuTimer();
+
+            GpuTimer(const GpuTimer&) = delete;
+            GpuTimer& operator=(const GpuTimer&) = delete;
+
+            bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+
+            // milliseconds between begin() and end() the last time frameIndex was recorded,
+            // false when nothing was measured with it yet
+            bool collect(int frameIndex, double& milliseconds);
+            // outside a render pass, before begin()
+            void reset(VkCommandBuffer commandBuffer, int frameIndex);
+            void begin(VkCommandBuffer commandBuffer, int frameIndex);
+            void end(VkCommandBuffer commandBuffer, int frameIndex);
+
+        private:
+            Device& device;
+            VkQueryPool queryPool = VK_NULL_HANDLE;
+            // nanoseconds per tick
+            double timestampPeriod;
+            // bits of the graphics queue's timestamps that count
+            uint64_t timestampMask = 0;
+            // begin() and end() were recorded since the last collect()
+            std::vector<bool> measured;
+    };
+}
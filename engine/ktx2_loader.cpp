@@ -0,0 +1,168 @@
+#include "ktx2_loader.hpp"
+#include "block_decoder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace engine {
+    Ktx2Loader::Stats Ktx2Loader::stats{};
+
+    namespace {
+        const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+        // identifier, 9 uint32 fields, the dfd / kvd / sgd index
+        constexpr size_t HEADER_SIZE = 80;
+        // per level: byteOffset, byteLength, uncompressedByteLength
+        constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24;
+        // Texture::Builder::Level offsets, covers every block and texel size
+        constexpr size_t LEVEL_ALIGNMENT = 16;
+
+        // the fields are little endian, as is every host we build for
+        template <typename T>
+        T read(const std::vector<uint8_t>& bytes, size_t offset) {
+            T value;
+            std::memcpy(&value, bytes.data() + offset, sizeof(T));
+            return value;
+        }
+
+        size_t alignLevel(size_t offset) {
+            return (offset + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+        }
+
+        double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<double, std::milli>(end - start).count();
+        }
+    }
+
+    Texture::Builder Ktx2Loader::parse(const std::string& filePath) {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::ifstream file{filePath, std::ios::ate | std::ios::binary};
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + filePath);
+        }
+        std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        file.close();
+
+        Texture::Builder builder = parse(bytes);
+        ++stats.files;
+        stats.fileBytes += bytes.size();
+        stats.parseMs += millisecondsSince(start);
+        return builder;
+    }
+
+    Texture::Builder Ktx2Loader::parse(const std::vector<uint8_t>& bytes) {
+        if (bytes.size() < HEADER_SIZE || std::memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+            throw std::runtime_error("Not a KTX2 file");
+        }
+        Texture::Builder builder{};
+        builder.format = static_cast<VkFormat>(read<uint32_t>(bytes, 12));
+        builder.width = read<uint32_t>(bytes, 20);
+        builder.height = read<uint32_t>(bytes, 24);
+        uint32_t depth = read<uint32_t>(bytes, 28);
+        uint32_t layerCount = read<uint32_t>(bytes, 32);
+        uint32_t faceCount = read<uint32_t>(bytes, 36);
+        uint32_t levelCount = std::max(read<uint32_t>(bytes, 40), 1u);
+        uint32_t supercompression = read<uint32_t>(bytes, 44);
+
+        if (!BlockDecoder::canDecode(builder.format)) {
+            throw std::runtime_error("KTX2 file isn't BC1, BC3, BC5 or BC7");
+        }
+        if (builder.width == 0 || builder.height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) {
+            throw std::runtime_error("KTX2 file isn't a plain 2d image");
+        }
+        if (supercompression != 0) {
+            throw std::runtime_error("KTX2 supercompression isn't supported");
+        }
+        if (levelCount > Texture::mipLevelCount(builder.width, builder.height) ||
+            bytes.size() < HEADER_SIZE + levelCount * LEVEL_INDEX_ENTRY_SIZE) {
+            throw std::runtime_error("KTX2 level index is corrupt");
+        }
+
+        // levels are stored smallest first, the builder wants level 0 first
+        const uint32_t blockBytes = BlockDecoder::blockBytes(builder.format);
+        size_t totalSize = 0;
+        for (uint32_t level = 0; level < levelCount; ++level) {
+            size_t entry = HEADER_SIZE + level * LEVEL_INDEX_ENTRY_SIZE;
+            uint64_t byteOffset = read<uint64_t>(bytes, entry);
+            uint64_t byteLength = read<uint64_t>(bytes, entry + 8);
+
+            Texture::Builder::Level range{};
+            range.width = std::max(builder.width >> level, 1u);
+            range.height = std::max(builder.height >> level, 1u);
+            range.offset = alignLevel(totalSize);
+            range.size = static_cast<size_t>((range.width + 3) / 4) * ((range.height + 3) / 4) * blockBytes;
+            if (byteLength != range.size || byteOffset > bytes.size() || byteLength > bytes.size() - byteOffset) {
+                throw std::runtime_error("KTX2 level index is corrupt");
+            }
+            builder.levels.push_back(range);
+            totalSize = range.offset + range.size;
+        }
+
+        builder.pixels.resize(totalSize);
+        for (uint32_t level = 0; level < levelCount; ++level) {
+            uint64_t byteOffset = read<uint64_t>(bytes, HEADER_SIZE + level * LEVEL_INDEX_ENTRY_SIZE);
+            const auto& range = builder.levels[level];
+            std::memcpy(builder.pixels.data() + range.offset, bytes.data() + byteOffset, range.size);
+        }
+        return builder;
+    }
+
+    Texture::Builder Ktx2Loader::transcode(const Texture::Builder& compressed, unsigned int threadCount) {
+        Texture::Builder builder{};
+        builder.width = compressed.width;
+        builder.height = compressed.height;
+        builder.format = BlockDecoder::decodedFormat(compressed.format);
+        const uint32_t texelBytes = BlockDecoder::decodedTexelBytes(compressed.format);
+
+        size_t totalSize = 0;
+        for (const auto& level : compressed.levels) {
+            Texture::Builder::Level range{};
+            range.width = level.width;
+            range.height = level.height;
+            range.offset = alignLevel(totalSize);
+            range.size = static_cast<size_t>(level.width) * level.height * texelBytes;
+            builder.levels.push_back(range);
+            totalSize = range.offset + range.size;
+        }
+        builder.pixels.resize(totalSize);
+        for (size_t level = 0; level < compressed.levels.size(); ++level) {
+            const auto& source = compressed.levels[level];
+            BlockDecoder::decode(compressed.format, compressed.pixels.data() + source.offset, source.width, source.height,
+                builder.pixels.data() + builder.levels[level].offset, threadCount);
+        }
+        return builder;
+    }
+
+    VkDeviceSize Ktx2Loader::rgbaSize(const Texture::Builder& builder) {
+        VkDeviceSize size = 0;
+        for (const auto& level : builder.levels) size += static_cast<VkDeviceSize>(level.width) * level.height * 4;
+        return size;
+    }
+
+    Texture::Builder Ktx2Loader::prepare(Device& device, const std::string& filePath, unsigned int threadCount) {
+        Texture::Builder builder = parse(filePath);
+        VkFormat decoded = BlockDecoder::decodedFormat(builder.format);
+        VkFormat format = device.findSupportedFormat({builder.format, decoded}, VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+            VK_FORMAT_FEATURE_TRANSFER_DST_BIT);
+        if (format != builder.format) {
+            auto start = std::chrono::high_resolution_clock::now();
+            builder = transcode(builder, threadCount);
+            stats.transcodeMs += millisecondsSince(start);
+            ++stats.transcodedFiles;
+        }
+        stats.uploadBytes += builder.pixels.size();
+        stats.rgbaBytes += rgbaSize(builder);
+        return builder;
+    }
+
+    std::shared_ptr<Texture> Ktx2Loader::load(Device& device, const std::string& filePath,
+        UploadBatch* upload, unsigned int threadCount) {
+        return std::make_shared<Texture>(device, prepare(device, filePath, threadCount), upload);
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "texture.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+    Reader for .ktx2 textures holding BC1 / BC3 / BC5 / BC7 blocks
+
+    Block compressed levels are copied to the image as they are stored, so they take
+    1/8 (BC1) or 1/4 (BC3/5/7) of the staging memory, upload bandwidth and VRAM of rgba8.
+
+    prepare(): read file | parse header + level index | pick format              |
+                                                       file format supported?  -> the blocks
+                                                       otherwise               -> BlockDecoder on all cores
+    load():    prepare() | Texture, one copy region per level
+
+    The format is picked with Device::findSupportedFormat from {file format, decoded
+    format}; the decoded one (rgba8 / rg8, see block_decoder.hpp) is sampleable everywhere.
+
+    Only plain 2d images are read: no arrays, cube maps or 3d images, no supercompression
+    (transcode those with ktx create / toktx without --zstd). A file without levels gets
+    only level 0, the mip chain is expected to be built offline.
+*/
+
+namespace engine {
+    class Ktx2Loader {
+        public:
+            // summed over every load() since the last resetStats()
+            struct Stats {
+                uint32_t files = 0;
+                uint32_t transcodedFiles = 0;
+                VkDeviceSize fileBytes = 0;
+                // staged and copied to the images
+                VkDeviceSize uploadBytes = 0;
+                // the same chains as rgba8
+                VkDeviceSize rgbaBytes = 0;
+                double parseMs = 0.0;
+                double transcodeMs = 0.0;
+            };
+
+            // the levels of the file in a builder, format is the one stored in the file
+            static Texture::Builder parse(const std::string& filePath);
+            static Texture::Builder parse(const std::vector<uint8_t>& bytes);
+            // every level through BlockDecoder, threadCount 0 uses std::thread::hardware_concurrency()
+            static Texture::Builder transcode(const Texture::Builder& compressed, unsigned int threadCount = 0);
+            // what the chain of builder takes as rgba8
+            static VkDeviceSize rgbaSize(const Texture::Builder& builder);
+
+            // parse() and, where the device can't sample the blocks, transcode()
+            static Texture::Builder prepare(Device& device, const std::string& filePath, unsigned int threadCount = 0);
+            static std::shared_ptr<Texture> load(Device& device, const std::string& filePath,
+                UploadBatch* upload = nullptr, unsigned int threadCount = 0);
+
+            static const Stats& getStats() { return stats; }
+            static void resetStats() { stats = Stats{}; }
+
+        private:
+            static Stats stats;
+    };
+}
@@ -0,0 +1,317 @@
+#include "memory_allocator.hpp"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+namespace engine {
+    struct MemoryAllocator::Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkDeviceSize size = 0;
+        uint32_t memoryType = 0;
+        uint32_t maxOrder = 0;
+        // offsets of the free nodes, per order
+        std::vector<std::set<VkDeviceSize>> freeNodes{};
+        VkDeviceSize used = 0;
+        VkDeviceSize requested = 0;
+        uint32_t allocations = 0;
+        // the pool the block belongs to, the pool vectors are never resized
+        Pool* pool = nullptr;
+    };
+
+    MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice,
+        PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2, VkDeviceSize blockSize)
+        : device{device}, physicalDevice{physicalDevice}, getMemoryProperties2{getMemoryProperties2},
+          memoryBudget{getMemoryProperties2 != nullptr} {
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+        heapBytes.resize(memoryProperties.memoryHeapCount);
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        bufferImageGranularity = properties.limits.bufferImageGranularity;
+
+        linearPools.resize(memoryProperties.memoryTypeCount);
+        optimalPools.resize(memoryProperties.memoryTypeCount);
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+            // small heaps (the 256 MB BAR window) get smaller blocks, so one block doesn't eat them
+            VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+            VkDeviceSize size = blockSize;
+            while (size > MIN_NODE_SIZE && size > heapSize / 8) size /= 2;
+            blockSizes.push_back(size);
+        }
+    }
+
+    MemoryAllocator::~MemoryAllocator() {
+        for (auto* pools : {&linearPools, &optimalPools}) {
+            for (auto& pool : *pools) {
+                for (auto& block : pool) destroyBlock(*block);
+            }
+        }
+    }
+
+    bool MemoryAllocator::isHostVisible(uint32_t memoryType) const {
+        return memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    }
+
+    bool MemoryAllocator::isHostCoherent(uint32_t memoryType) const {
+        return memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+
+    uint32_t MemoryAllocator::orderOf(VkDeviceSize size) const {
+        uint32_t order = 0;
+        while (nodeSize(order) < size) ++order;
+        return order;
+    }
+
+    MemoryAllocator::Allocation MemoryAllocator::allocate(
+        const VkMemoryRequirements& requirements, uint32_t memoryType, bool linear) {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (memoryType >= memoryProperties.memoryTypeCount) throw std::runtime_error("Invalid memory type");
+
+        VkDeviceSize blockSize = blockSizes[memoryType];
+        if (requirements.size > blockSize / 2) return allocateDedicated(requirements, memoryType);
+
+        Pool& pool = poolOf(memoryType, linear);
+        uint32_t order = orderOf(std::max(requirements.size, requirements.alignment));
+
+        VkDeviceSize offset = 0;
+        for (auto& block : pool) {
+            if (allocateNode(*block, order, offset)) return allocateInBlock(*block, requirements, order, offset);
+        }
+        Block* block = createBlock(pool, memoryType, blockSize);
+        allocateNode(*block, order, offset);
+        return allocateInBlock(*block, requirements, order, offset);
+    }
+
+    MemoryAllocator::Pool& MemoryAllocator::poolOf(uint32_t memoryType, bool linear) {
+        return linear || bufferImageGranularity <= 1 ? linearPools[memoryType] : optimalPools[memoryType];
+    }
+
+    MemoryAllocator::Allocation MemoryAllocator::allocateInBlock(Block& block, const VkMemoryRequirements& requirements,
+        uint32_t order, VkDeviceSize offset) {
+        block.used += nodeSize(order);
+        block.requested += requirements.size;
+        ++block.allocations;
+
+        Allocation allocation{};
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = nodeSize(order);
+        allocation.memoryType = block.memoryType;
+        allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + offset : nullptr;
+        allocation.block = &block;
+        allocation.requestedSize = requirements.size;
+        return allocation;
+    }
+
+    bool MemoryAllocator::shouldRelocate(const Allocation& allocation) const {
+        if (allocation.block == nullptr) return false;
+        std::lock_guard<std::mutex> lock{mutex};
+        const Block& source = *allocation.block;
+        const Pool& pool = *source.pool;
+        if (pool.size() < 2 || source.used > source.size / 2) return false;
+
+        VkDeviceSize freeElsewhere = 0;
+        bool afterSource = false;
+        for (const auto& block : pool) {
+            if (block.get() == &source) {
+                afterSource = true;
+                continue;
+            }
+            // ties go to the later block, allocate() fills the first ones first
+            if (block->used < source.used || (block->used == source.used && afterSource)) return false;
+            freeElsewhere += block->size - block->used;
+        }
+        return freeElsewhere >= source.used;
+    }
+
+    MemoryAllocator::Allocation MemoryAllocator::allocateOutside(const VkMemoryRequirements& requirements,
+        uint32_t memoryType, bool linear, const Block* source) {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (requirements.size > blockSizes[memoryType] / 2) return Allocation{};
+
+        uint32_t order = orderOf(std::max(requirements.size, requirements.alignment));
+        VkDeviceSize offset = 0;
+        for (auto& block : poolOf(memoryType, linear)) {
+            if (block.get() == source) continue;
+            if (allocateNode(*block, order, offset)) return allocateInBlock(*block, requirements, order, offset);
+        }
+        return Allocation{};
+    }
+
+    void MemoryAllocator::releaseEmptyBlocks() {
+        std::lock_guard<std::mutex> lock{mutex};
+        for (auto* pools : {&linearPools, &optimalPools}) {
+            for (auto& pool : *pools) {
+                for (auto& block : pool) {
+                    if (block->allocations == 0) destroyBlock(*block);
+                }
+                pool.erase(std::remove_if(pool.begin(), pool.end(),
+                    [](const std::unique_ptr<Block>& block) { return block->memory == VK_NULL_HANDLE; }), pool.end());
+            }
+        }
+    }
+
+    MemoryAllocator::Allocation MemoryAllocator::allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryType) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = requirements.size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        Allocation allocation{};
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate dedicated device memory");
+        }
+        if (isHostVisible(memoryType)) vkMapMemory(device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped);
+        allocation.size = requirements.size;
+        allocation.memoryType = memoryType;
+        allocation.requestedSize = requirements.size;
+
+        ++dedicatedCount;
+        dedicatedBytes += requirements.size;
+        heapBytes[memoryProperties.memoryTypes[memoryType].heapIndex] += requirements.size;
+        return allocation;
+    }
+
+    MemoryAllocator::Block* MemoryAllocator::createBlock(Pool& pool, uint32_t memoryType, VkDeviceSize size) {
+        auto block = std::make_unique<Block>();
+        block->size = size;
+        block->memoryType = memoryType;
+        block->maxOrder = orderOf(size);
+        block->freeNodes.resize(block->maxOrder + 1);
+        block->freeNodes[block->maxOrder].insert(0);
+        block->pool = &pool;
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate device memory block");
+        }
+        if (isHostVisible(memoryType)) vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+        heapBytes[memoryProperties.memoryTypes[memoryType].heapIndex] += size;
+
+        pool.push_back(std::move(block));
+        return pool.back().get();
+    }
+
+    void MemoryAllocator::destroyBlock(Block& block) {
+        // freeing implicitly unmaps
+        vkFreeMemory(device, block.memory, nullptr);
+        block.memory = VK_NULL_HANDLE;
+        heapBytes[memoryProperties.memoryTypes[block.memoryType].heapIndex] -= block.size;
+    }
+
+    bool MemoryAllocator::allocateNode(Block& block, uint32_t order, VkDeviceSize& offset) {
+        if (order > block.maxOrder) return false;
+        uint32_t available = order;
+        while (available <= block.maxOrder && block.freeNodes[available].empty()) ++available;
+        if (available > block.maxOrder) return false;
+
+        // the lowest free node, keeps allocations packed towards the start of the block
+        auto& nodes = block.freeNodes[available];
+        offset = *nodes.begin();
+        nodes.erase(nodes.begin());
+        // split down to the requested order, the upper halves stay free
+        while (available > order) {
+            --available;
+            block.freeNodes[available].insert(offset + nodeSize(available));
+        }
+        return true;
+    }
+
+    void MemoryAllocator::freeNode(Block& block, VkDeviceSize offset, uint32_t order) {
+        // merge with the buddy as long as it is free as a whole
+        while (order < block.maxOrder) {
+            VkDeviceSize buddy = offset ^ nodeSize(order);
+            if (block.freeNodes[order].erase(buddy) == 0) break;
+            offset = std::min(offset, buddy);
+            ++order;
+        }
+        block.freeNodes[order].insert(offset);
+    }
+
+    void MemoryAllocator::free(const Allocation& allocation) {
+        if (allocation.memory == VK_NULL_HANDLE) return;
+        std::lock_guard<std::mutex> lock{mutex};
+
+        if (allocation.block == nullptr) {
+            vkFreeMemory(device, allocation.memory, nullptr);
+            --dedicatedCount;
+            dedicatedBytes -= allocation.size;
+            heapBytes[memoryProperties.memoryTypes[allocation.memoryType].heapIndex] -= allocation.size;
+            return;
+        }
+
+        Block& block = *allocation.block;
+        freeNode(block, allocation.offset, orderOf(allocation.size));
+        block.used -= allocation.size;
+        block.requested -= allocation.requestedSize;
+        --block.allocations;
+        if (block.allocations > 0) return;
+
+        // one empty block per pool stays around for the next allocation, the others go back to the driver
+        Pool& pool = *block.pool;
+        bool otherEmpty = std::any_of(pool.begin(), pool.end(),
+            [&](const std::unique_ptr<Block>& other) { return other.get() != &block && other->allocations == 0; });
+        if (!otherEmpty) return;
+        destroyBlock(block);
+        pool.erase(std::find_if(pool.begin(), pool.end(),
+            [&](const std::unique_ptr<Block>& other) { return other.get() == &block; }));
+    }
+
+    MemoryAllocator::Stats MemoryAllocator::getStats() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        Stats stats{};
+        for (auto* pools : {&linearPools, &optimalPools}) {
+            for (const auto& pool : *pools) {
+                for (const auto& block : pool) {
+                    ++stats.blockCount;
+                    stats.allocationCount += block->allocations;
+                    stats.blockBytes += block->size;
+                    stats.usedBytes += block->used;
+                    stats.requestedBytes += block->requested;
+                    stats.freeBytes += block->size - block->used;
+                    for (uint32_t order = block->maxOrder + 1; order-- > 0;) {
+                        if (block->freeNodes[order].empty()) continue;
+                        stats.largestFreeRange = std::max(stats.largestFreeRange, nodeSize(order));
+                        break;
+                    }
+                }
+            }
+        }
+        stats.dedicatedCount = dedicatedCount;
+        stats.dedicatedBytes = dedicatedBytes;
+        stats.allocationCount += dedicatedCount;
+        stats.requestedBytes += dedicatedBytes;
+        return stats;
+    }
+
+    std::vector<MemoryAllocator::HeapBudget> MemoryAllocator::getHeapBudgets() const {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        if (memoryBudget) {
+            // the values change as memory is allocated anywhere on the system, so they are queried every time
+            VkPhysicalDeviceMemoryProperties2 properties{};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            properties.pNext = &budgetProperties;
+            getMemoryProperties2(physicalDevice, &properties);
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        std::vector<HeapBudget> budgets(memoryProperties.memoryHeapCount);
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+            budgets[i].size = memoryProperties.memoryHeaps[i].size;
+            budgets[i].deviceLocal = memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+            if (memoryBudget) {
+                budgets[i].budget = budgetProperties.heapBudget[i];
+                budgets[i].usage = budgetProperties.heapUsage[i];
+            } else {
+                budgets[i].budget = budgets[i].size / 5 * 4;
+                budgets[i].usage = heapBytes[i];
+            }
+        }
+        return budgets;
+    }
+}
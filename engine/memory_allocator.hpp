@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+    Device memory sub-allocation for Buffer and images (Device::allocator())
+
+    vkAllocateMemory is slow and capped at maxMemoryAllocationCount (4096 on many
+    drivers), so resources share large blocks instead of owning one allocation each.
+    Every memory type has its own pools of 64 MB blocks, split with a buddy allocator:
+
+    block  |               64 MB                 |
+    split  |      32 MB       |      32 MB       |
+           | 16 MB  |  16 MB  |      32 MB       |
+           |mesh|   |  depth  |       free       |
+
+    A request is rounded up to a power of two of at least its alignment, buddies are
+    naturally aligned to their size, so any alignment the driver asks for holds. Freed
+    buddies merge back with their sibling. Resources of half a block or more get a
+    dedicated allocation of their own.
+
+    Linear resources (buffers, linear images) and optimal tiling images never share a
+    block when the device reports a bufferImageGranularity above 1, so they can't end
+    up on the same granularity page.
+
+    Host visible blocks are mapped once when created, Allocation::mapped points into
+    that mapping (vkMapMemory can't be called twice on one VkDeviceMemory).
+
+    Moving allocations (see defragmenter.hpp): shouldRelocate() picks the allocations of the
+    emptiest block of a pool, allocateOutside() places their copies in the other blocks, and
+    releaseEmptyBlocks() hands the emptied blocks back to the driver.
+
+    getHeapBudgets() reports how much of each heap the process may use and uses, from
+    VK_EXT_memory_budget when the device has it (other processes and the driver count
+    too), otherwise estimated as 80% of the heap against what this allocator reserved.
+*/
+
+namespace engine {
+    class MemoryAllocator {
+        public:
+            static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+            // smallest buddy, keeps the free lists short
+            static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+
+            struct Block;
+
+            struct Allocation {
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                VkDeviceSize offset = 0;
+                // the buddy size, at least the requested size
+                VkDeviceSize size = 0;
+                uint32_t memoryType = 0;
+                // host address of offset when the memory type is host visible
+                void* mapped = nullptr;
+                // nullptr for dedicated allocations
+                Block* block = nullptr;
+                VkDeviceSize requestedSize = 0;
+            };
+
+            struct Stats {
+                uint32_t blockCount = 0;
+                uint32_t dedicatedCount = 0;
+                uint32_t allocationCount = 0;
+                // reserved from the driver in blocks and in dedicated allocations
+                VkDeviceSize blockBytes = 0;
+                VkDeviceSize dedicatedBytes = 0;
+                // handed out from blocks (rounded up to buddy sizes) and what was asked for
+                VkDeviceSize usedBytes = 0;
+                VkDeviceSize requestedBytes = 0;
+                VkDeviceSize freeBytes = 0;
+                VkDeviceSize largestFreeRange = 0;
+
+                // 0 when the free memory is one range, close to 1 when it is scattered in small pieces
+                float fragmentation() const {
+                    return freeBytes == 0 ? 0.f : 1.f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+                }
+            };
+
+            struct HeapBudget {
+                VkDeviceSize size = 0;
+                VkDeviceSize budget = 0;
+                VkDeviceSize usage = 0;
+                bool deviceLocal = false;
+            };
+
+            // getMemoryProperties2: the core or KHR entry point when VK_EXT_memory_budget is enabled on
+            // device, nullptr estimates the budgets
+            MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice,
+                PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2 = nullptr,
+                VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+            // frees every block, live allocations included
+            ~MemoryAllocator();
+
+            MemoryAllocator(const MemoryAllocator&) = delete;
+            MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+            // linear: buffers and linear tiling images, optimal tiling images pass false
+            Allocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryType, bool linear);
+            void free(const Allocation& allocation);
+
+            // the allocation sits in the emptiest block of its pool, at most half used, and the
+            // other blocks have room for all of that block's allocations
+            bool shouldRelocate(const Allocation& allocation) const;
+            // like allocate, but only in blocks that already exist other than source, the allocation
+            // has no memory when none of them has room
+            Allocation allocateOutside(const VkMemoryRequirements& requirements, uint32_t memoryType, bool linear,
+                const Block* source);
+            // every empty block, free() keeps one per pool
+            void releaseEmptyBlocks();
+
+            Stats getStats() const;
+            std::vector<HeapBudget> getHeapBudgets() const;
+            bool isHostVisible(uint32_t memoryType) const;
+            // host writes need no vkFlushMappedMemoryRanges
+            bool isHostCoherent(uint32_t memoryType) const;
+
+        private:
+            using Pool = std::vector<std::unique_ptr<Block>>;
+
+            Allocation allocateInBlock(Block& block, const VkMemoryRequirements& requirements, uint32_t order,
+                VkDeviceSize offset);
+            Pool& poolOf(uint32_t memoryType, bool linear);
+            Allocation allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryType);
+            Block* createBlock(Pool& pool, uint32_t memoryType, VkDeviceSize size);
+            void destroyBlock(Block& block);
+            // buddy allocation inside one block, false when no node of the order is free
+            bool allocateNode(Block& block, uint32_t order, VkDeviceSize& offset);
+            void freeNode(Block& block, VkDeviceSize offset, uint32_t order);
+            uint32_t orderOf(VkDeviceSize size) const;
+            VkDeviceSize nodeSize(uint32_t order) const { return MIN_NODE_SIZE << order; }
+
+            VkDevice device;
+            VkPhysicalDevice physicalDevice;
+            PFN_vkGetPhysicalDeviceMemoryProperties2 getMemoryProperties2;
+            bool memoryBudget;
+            VkPhysicalDeviceMemoryProperties memoryProperties;
+            VkDeviceSize bufferImageGranularity;
+            // per memory type: linear and optimal pools (the same one when the granularity is 1)
+            std::vector<Pool> linearPools;
+            std::vector<Pool> optimalPools;
+            std::vector<VkDeviceSize> blockSizes;
+            uint32_t dedicatedCount = 0;
+            VkDeviceSize dedicatedBytes = 0;
+            // reserved from the driver per heap, blocks and dedicated allocations
+            std::vector<VkDeviceSize> heapBytes;
+            mutable std::mutex mutex;
+    };
+}
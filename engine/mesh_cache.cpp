@@ -0,0 +1,141 @@
+#include "mesh_cache.hpp"
+
+// posix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace engine {
+    namespace {
+        constexpr uint64_t BLOCK_ALIGNMENT = 16;
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        bool statSource(const std::string& sourcePath, uint64_t& size, int64_t& mtime) {
+            struct stat st{};
+            if (stat(sourcePath.c_str(), &st) != 0) return false;
+            size = static_cast<uint64_t>(st.st_size);
+            mtime = static_cast<int64_t>(st.st_mtime);
+            return true;
+        }
+    }
+
+    MeshCache::MappedMesh::~MappedMesh() {
+        munmap(data, size);
+    }
+
+    std::string MeshCache::cachePathFor(const std::string& sourcePath) {
+        return sourcePath + ".meshcache";
+    }
+
+    std::unique_ptr<MeshCache::MappedMesh> MeshCache::open(const std::string& sourcePath) {
+        uint64_t sourceSize;
+        int64_t sourceMtime;
+        if (!statSource(sourcePath, sourceSize, sourceMtime)) return nullptr;
+
+        int fd = ::open(cachePathFor(sourcePath).c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+            close(fd);
+            return nullptr;
+        }
+
+        size_t fileSize = static_cast<size_t>(st.st_size);
+        void* data = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping stays valid after the descriptor is closed
+        close(fd);
+        if (data == MAP_FAILED) return nullptr;
+
+        auto mesh = std::make_unique<MappedMesh>(data, fileSize);
+        const Header& header = mesh->header();
+
+        // reject caches written by another version, another Vertex layout, or from an older source
+        bool valid = header.magic == MAGIC &&
+            header.version == VERSION &&
+            header.vertexStride == sizeof(Model::Vertex) &&
+            header.indexSize == sizeof(uint32_t) &&
+            header.sourceSize == sourceSize &&
+            header.sourceMtime == sourceMtime &&
+            header.vertexOffset + uint64_t{header.vertexCount} * header.vertexStride <= fileSize &&
+            header.indexOffset + uint64_t{header.indexCount} * header.indexSize <= fileSize &&
+            header.lodOffset + uint64_t{header.lodCount} * sizeof(Model::Lod) <= fileSize;
+        if (!valid) return nullptr;
+
+        for (uint32_t i = 0; i < header.lodCount; ++i) {
+            const Model::Lod& lod = mesh->lods()[i];
+            if (uint64_t{lod.firstIndex} + lod.indexCount > header.indexCount) return nullptr;
+        }
+
+        return mesh;
+    }
+
+    bool MeshCache::write(const std::string& sourcePath, const Model::Builder& builder, uint32_t lodLimit) {
+        Header header{};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        if (!statSource(sourcePath, header.sourceSize, header.sourceMtime)) return false;
+
+        header.vertexStride = sizeof(Model::Vertex);
+        header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        header.indexSize = sizeof(uint32_t);
+        header.indexCount = static_cast<uint32_t>(builder.indices.size());
+        header.vertexOffset = alignUp(sizeof(Header), BLOCK_ALIGNMENT);
+        header.indexOffset = alignUp(header.vertexOffset + uint64_t{header.vertexCount} * header.vertexStride, BLOCK_ALIGNMENT);
+        header.lodLimit = lodLimit;
+        header.lodCount = static_cast<uint32_t>(builder.lods.size());
+        header.lodOffset = alignUp(header.indexOffset + uint64_t{header.indexCount} * header.indexSize, BLOCK_ALIGNMENT);
+
+        std::fill(header.boundsMin, header.boundsMin + 3, std::numeric_limits<float>::max());
+        std::fill(header.boundsMax, header.boundsMax + 3, std::numeric_limits<float>::lowest());
+        for (const auto& vertex : builder.vertices) {
+            for (int axis = 0; axis < 3; ++axis) {
+                header.boundsMin[axis] = std::min(header.boundsMin[axis], vertex.position[axis]);
+                header.boundsMax[axis] = std::max(header.boundsMax[axis], vertex.position[axis]);
+            }
+        }
+
+        // write to a temporary file first so a crash never leaves a truncated cache behind
+        std::string cachePath = cachePathFor(sourcePath);
+        std::string tmpPath = cachePath + ".tmp";
+        {
+            std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+            if (!file.is_open()) {
+                std::cerr << "failed to write mesh cache: " << cachePath << std::endl;
+                return false;
+            }
+
+            const char padding[BLOCK_ALIGNMENT] = {};
+            file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            file.write(padding, header.vertexOffset - sizeof(Header));
+            file.write(reinterpret_cast<const char*>(builder.vertices.data()), uint64_t{header.vertexCount} * header.vertexStride);
+            file.write(padding, header.indexOffset - (header.vertexOffset + uint64_t{header.vertexCount} * header.vertexStride));
+            file.write(reinterpret_cast<const char*>(builder.indices.data()), uint64_t{header.indexCount} * header.indexSize);
+            file.write(padding, header.lodOffset - (header.indexOffset + uint64_t{header.indexCount} * header.indexSize));
+            file.write(reinterpret_cast<const char*>(builder.lods.data()), uint64_t{header.lodCount} * sizeof(Model::Lod));
+
+            if (!file.good()) {
+                file.close();
+                std::remove(tmpPath.c_str());
+                std::cerr << "failed to write mesh cache: " << cachePath << std::endl;
+                return false;
+            }
+        }
+
+        if (std::rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*
+    Binary mesh cache for Model::Builder
+
+    Parsing an .obj file (tinyobjloader + vertex dedup) is the slow part of
+    loading a model, so the result is written once to <source>.meshcache and
+    memory mapped on the next launch.
+
+    File layout (native endian, offsets are 16 byte aligned):
+    | Header | vertex block (vertexCount * vertexStride) | index block (indexCount * indexSize) | lod block (lodCount * Model::Lod) |
+
+    The index block holds every level of the LOD chain, the lod block their ranges.
+
+    The cache is considered stale when the version, vertex stride, or the
+    source file's size / mtime differ from the values recorded in the header.
+*/
+
+namespace engine {
+    class MeshCache {
+        public:
+            static constexpr uint32_t MAGIC = 0x48534D5A; // "ZMSH"
+            // 2: geometry is stored after Model::Builder::optimize
+            // 3: LOD chain (Model::Builder::buildLods) appended to the indices
+            static constexpr uint32_t VERSION = 3;
+
+            struct Header {
+                uint32_t magic;
+                uint32_t version;
+                uint64_t sourceSize;
+                int64_t sourceMtime;
+                uint32_t vertexStride;
+                uint32_t vertexCount;
+                uint32_t indexSize;
+                uint32_t indexCount;
+                uint64_t vertexOffset;
+                uint64_t indexOffset;
+                float boundsMin[3];
+                float boundsMax[3];
+                // lodCount levels were built, at most lodLimit were requested
+                uint32_t lodLimit;
+                uint32_t lodCount;
+                uint64_t lodOffset;
+            };
+
+            // read-only view of a mapped cache file, unmapped on destruction
+            class MappedMesh {
+                public:
+                    MappedMesh(void* data, size_t size) : data{data}, size{size} {}
+                    ~MappedMesh();
+
+                    MappedMesh(const MappedMesh&) = delete;
+                    MappedMesh& operator=(const MappedMesh&) = delete;
+
+                    const Header& header() const { return *static_cast<const Header*>(data); }
+                    const Model::Vertex* vertices() const {
+                        return reinterpret_cast<const Model::Vertex*>(static_cast<const char*>(data) + header().vertexOffset);
+                    }
+                    const uint32_t* indices() const {
+                        return reinterpret_cast<const uint32_t*>(static_cast<const char*>(data) + header().indexOffset);
+                    }
+                    uint32_t vertexCount() const { return header().vertexCount; }
+                    uint32_t indexCount() const { return header().indexCount; }
+                    const Model::Lod* lods() const {
+                        return reinterpret_cast<const Model::Lod*>(static_cast<const char*>(data) + header().lodOffset);
+                    }
+                    uint32_t lodCount() const { return header().lodCount; }
+
+                private:
+                    void* data;
+                    size_t size;
+            };
+
+            static std::string cachePathFor(const std::string& sourcePath);
+
+            // returns nullptr if there is no cache file or it is stale
+            static std::unique_ptr<MappedMesh> open(const std::string& sourcePath);
+            // returns false (and leaves no partial file behind) if the cache couldn't be written
+            static bool write(const std::string& sourcePath, const Model::Builder& builder, uint32_t lodLimit = 1);
+    };
+}
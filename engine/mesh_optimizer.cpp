@@ -0,0 +1,242 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace engine {
+    namespace {
+        // FIFO post-transform cache, a vertex is transformed again once CACHE_SIZE newer vertices were
+        class FifoCache {
+            public:
+                FifoCache(size_t vertexCount, uint32_t cacheSize)
+                    : timestamps(vertexCount, 0), cacheSize{cacheSize} {}
+
+                // returns true on a cache miss
+                bool access(uint32_t vertex) {
+                    if (time - timestamps[vertex] < cacheSize && timestamps[vertex] != 0) return false;
+                    timestamps[vertex] = ++time;
+                    return true;
+                }
+
+                void clear() {
+                    // moving the clock past every stored timestamp empties the cache
+                    time += cacheSize;
+                }
+
+            private:
+                std::vector<uint64_t> timestamps;
+                uint32_t cacheSize;
+                uint64_t time = 0;
+        };
+
+        // triangles using each vertex, in compressed row storage
+        struct Adjacency {
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> triangles;
+        };
+
+        Adjacency buildAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount) {
+            Adjacency adjacency{};
+            adjacency.offsets.assign(vertexCount + 1, 0);
+            for (uint32_t index : indices) adjacency.offsets[index + 1]++;
+            std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+            adjacency.triangles.resize(indices.size());
+            std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); ++i) {
+                adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+            return adjacency;
+        }
+    }
+
+    MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(
+        const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+        CacheStats stats{};
+        if (indexCount < 3 || vertexCount == 0) return stats;
+
+        FifoCache cache{vertexCount, cacheSize};
+        size_t misses = 0;
+        for (size_t i = 0; i < indexCount; ++i) misses += cache.access(indices[i]);
+
+        stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+        stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+        return stats;
+    }
+
+    std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(
+        std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+        /*
+        Tipsify: fan around a vertex, emitting all of its remaining triangles, then
+        continue with the neighbour that will still be in the cache and has the most
+        triangles left. Dead ends fall back to recently emitted vertices, then to the
+        next vertex in input order.
+         */
+        std::vector<uint32_t> hardClusters{};
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) return hardClusters;
+
+        Adjacency adjacency = buildAdjacency(indices, vertexCount);
+        std::vector<uint32_t> liveTriangles(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+        std::vector<uint32_t> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> deadEnd{};
+        std::vector<uint32_t> candidates{};
+        std::vector<uint32_t> output{};
+        output.reserve(indices.size());
+
+        uint32_t time = cacheSize + 1;
+        size_t cursor = 0;
+        int64_t fanning = 0;
+        bool newCluster = true;
+        while (fanning >= 0) {
+            uint32_t vertex = static_cast<uint32_t>(fanning);
+            candidates.clear();
+            for (uint32_t a = adjacency.offsets[vertex]; a < adjacency.offsets[vertex + 1]; ++a) {
+                uint32_t triangle = adjacency.triangles[a];
+                if (emitted[triangle]) continue;
+                if (newCluster) {
+                    hardClusters.push_back(static_cast<uint32_t>(output.size() / 3));
+                    newCluster = false;
+                }
+
+                for (int corner = 0; corner < 3; ++corner) {
+                    uint32_t v = indices[3 * triangle + corner];
+                    output.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    liveTriangles[v]--;
+                    if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+                }
+                emitted[triangle] = true;
+            }
+
+            // best candidate: still cached after fanning around it, and furthest back in the cache
+            fanning = -1;
+            uint32_t bestPriority = 0;
+            for (uint32_t v : candidates) {
+                if (liveTriangles[v] == 0) continue;
+                uint32_t priority = 0;
+                if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) priority = time - cacheTime[v];
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    fanning = v;
+                }
+            }
+
+            if (fanning < 0) {
+                // dead end, every later cluster boundary starts here
+                newCluster = true;
+                while (!deadEnd.empty() && fanning < 0) {
+                    uint32_t v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (liveTriangles[v] > 0) fanning = v;
+                }
+                while (fanning < 0 && cursor < vertexCount) {
+                    if (liveTriangles[cursor] > 0) fanning = static_cast<int64_t>(cursor);
+                    ++cursor;
+                }
+            }
+        }
+
+        indices.swap(output);
+        return hardClusters;
+    }
+
+    size_t MeshOptimizer::optimizeOverdraw(
+        std::vector<uint32_t>& indices, const std::vector<Model::Vertex>& vertices,
+        const std::vector<uint32_t>& hardClusters, float threshold) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) return 0;
+
+        // soft boundaries: cut a hard cluster wherever its running ACMR is back within the threshold
+        std::vector<uint32_t> clusters{};
+        FifoCache cache{vertices.size(), CACHE_SIZE};
+        for (size_t c = 0; c < hardClusters.size(); ++c) {
+            size_t begin = hardClusters[c];
+            size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : triangleCount;
+
+            cache.clear();
+            size_t clusterMisses = 0;
+            for (size_t i = 3 * begin; i < 3 * end; ++i) clusterMisses += cache.access(indices[i]);
+            float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+            cache.clear();
+            clusters.push_back(static_cast<uint32_t>(begin));
+            size_t start = begin;
+            size_t misses = 0;
+            for (size_t t = begin; t < end; ++t) {
+                for (int corner = 0; corner < 3; ++corner) misses += cache.access(indices[3 * t + corner]);
+                if (t + 1 < end && static_cast<float>(misses) <= clusterThreshold * static_cast<float>(t + 1 - start)) {
+                    clusters.push_back(static_cast<uint32_t>(t + 1));
+                    start = t + 1;
+                    misses = 0;
+                    cache.clear();
+                }
+            }
+        }
+
+        // area weighted centroid of the mesh and of every cluster, plus the cluster's average normal
+        glm::vec3 meshCentroid{0.f};
+        float meshArea = 0.f;
+        std::vector<glm::vec3> clusterCentroids(clusters.size(), glm::vec3{0.f});
+        std::vector<glm::vec3> clusterNormals(clusters.size(), glm::vec3{0.f});
+        for (size_t c = 0; c < clusters.size(); ++c) {
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            float clusterArea = 0.f;
+            for (size_t t = clusters[c]; t < end; ++t) {
+                const glm::vec3& p0 = vertices[indices[3 * t + 0]].position;
+                const glm::vec3& p1 = vertices[indices[3 * t + 1]].position;
+                const glm::vec3& p2 = vertices[indices[3 * t + 2]].position;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+                clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.f);
+                clusterNormals[c] += normal;
+                clusterArea += area;
+            }
+            meshCentroid += clusterCentroids[c];
+            meshArea += clusterArea;
+            if (clusterArea > 0.f) clusterCentroids[c] /= clusterArea;
+        }
+        if (meshArea > 0.f) meshCentroid /= meshArea;
+
+        std::vector<float> sortKeys(clusters.size());
+        for (size_t c = 0; c < clusters.size(); ++c) {
+            sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+        }
+        std::vector<uint32_t> order(clusters.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> output{};
+        output.reserve(indices.size());
+        for (uint32_t c : order) {
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            output.insert(output.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * end);
+        }
+        indices.swap(output);
+        return clusters.size();
+    }
+
+    void MeshOptimizer::optimizeVertexFetch(std::vector<Model::Vertex>& vertices, std::vector<uint32_t>& indices) {
+        constexpr uint32_t UNUSED = UINT32_MAX;
+        std::vector<uint32_t> remap(vertices.size(), UNUSED);
+        std::vector<Model::Vertex> reordered{};
+        reordered.reserve(vertices.size());
+
+        for (uint32_t& index : indices) {
+            if (remap[index] == UNUSED) {
+                remap[index] = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        // vertices no triangle references are kept at the end
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            if (remap[v] == UNUSED) reordered.push_back(vertices[v]);
+        }
+        vertices.swap(reordered);
+    }
+}
@@ -0,0 +1,246 @@
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace engine {
+    namespace {
+        constexpr uint32_t NONE = UINT32_MAX;
+
+        // symmetric 4x4 matrix of a sum of squared plane distances, weight is the summed plane weight
+        struct Quadric {
+            double a2 = 0, ab = 0, ac = 0, ad = 0;
+            double b2 = 0, bc = 0, bd = 0;
+            double c2 = 0, cd = 0;
+            double d2 = 0;
+            double weight = 0;
+
+            static Quadric plane(const glm::vec3& normal, float distance, double weight) {
+                double a = normal.x, b = normal.y, c = normal.z, d = distance;
+                Quadric q{};
+                q.a2 = a * a * weight; q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+                q.b2 = b * b * weight; q.bc = b * c * weight; q.bd = b * d * weight;
+                q.c2 = c * c * weight; q.cd = c * d * weight;
+                q.d2 = d * d * weight;
+                q.weight = weight;
+                return q;
+            }
+
+            Quadric& operator+=(const Quadric& o) {
+                a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+                b2 += o.b2; bc += o.bc; bd += o.bd;
+                c2 += o.c2; cd += o.cd;
+                d2 += o.d2;
+                weight += o.weight;
+                return *this;
+            }
+
+            // mean squared distance of p to the planes
+            double error(const glm::vec3& p) const {
+                double x = p.x, y = p.y, z = p.z;
+                double sum = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                    + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                    + c2 * z * z + 2 * cd * z
+                    + d2;
+                return weight > 0 ? std::max(sum, 0.0) / weight : 0.0;
+            }
+        };
+
+        struct Collapse {
+            double cost;
+            uint32_t from;
+            uint32_t to;
+            uint32_t fromVersion;
+            uint32_t toVersion;
+
+            // std::priority_queue pops the largest element, so the cheapest collapse compares largest
+            bool operator<(const Collapse& other) const { return cost > other.cost; }
+        };
+
+        float attributeDistance(const Model::Vertex& a, const Model::Vertex& b) {
+            glm::vec3 normal = a.normal - b.normal;
+            glm::vec3 color = a.color - b.color;
+            glm::vec2 uv = a.uv - b.uv;
+            return glm::dot(normal, normal) + glm::dot(color, color) + glm::dot(uv, uv);
+        }
+    }
+
+    std::vector<uint32_t> MeshSimplifier::simplify(
+        const std::vector<Model::Vertex>& vertices, const std::vector<uint32_t>& indices,
+        size_t targetIndexCount, float& error) {
+        error = 0.f;
+        size_t triangleCount = indices.size() / 3;
+
+        // positions: vertices that only differ by their attributes share one
+        std::vector<uint32_t> order(vertices.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto lessPosition = [&](uint32_t a, uint32_t b) {
+            const glm::vec3& p = vertices[a].position;
+            const glm::vec3& q = vertices[b].position;
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        };
+        std::sort(order.begin(), order.end(), lessPosition);
+        std::vector<uint32_t> positionOf(vertices.size());
+        std::vector<std::vector<uint32_t>> members{};
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (i == 0 || lessPosition(order[i - 1], order[i])) members.emplace_back();
+            positionOf[order[i]] = static_cast<uint32_t>(members.size() - 1);
+            members.back().push_back(order[i]);
+        }
+        size_t positionCount = members.size();
+        auto point = [&](uint32_t position) -> const glm::vec3& { return vertices[members[position][0]].position; };
+
+        std::vector<std::array<uint32_t, 3>> triangles(triangleCount);
+        std::vector<bool> alive(triangleCount, true);
+        size_t aliveCount = 0;
+        std::vector<Quadric> quadrics(positionCount);
+        std::vector<std::vector<uint32_t>> trianglesOf(positionCount);
+        std::unordered_map<uint64_t, uint32_t> edgeUse{};
+        auto edgeKey = [](uint32_t a, uint32_t b) { return (uint64_t{std::min(a, b)} << 32) | std::max(a, b); };
+
+        for (size_t t = 0; t < triangleCount; ++t) {
+            triangles[t] = {indices[3 * t], indices[3 * t + 1], indices[3 * t + 2]};
+            uint32_t p0 = positionOf[triangles[t][0]], p1 = positionOf[triangles[t][1]], p2 = positionOf[triangles[t][2]];
+            // degenerate input triangles cover no area, they are dropped right away
+            if (p0 == p1 || p1 == p2 || p0 == p2) {
+                alive[t] = false;
+                continue;
+            }
+            ++aliveCount;
+
+            glm::vec3 normal = glm::cross(point(p1) - point(p0), point(p2) - point(p0));
+            float area = glm::length(normal);
+            if (area > 0.f) normal /= area;
+            Quadric q = Quadric::plane(normal, -glm::dot(normal, point(p0)), area * 0.5);
+            for (uint32_t p : {p0, p1, p2}) {
+                quadrics[p] += q;
+                trianglesOf[p].push_back(static_cast<uint32_t>(t));
+            }
+            edgeUse[edgeKey(p0, p1)]++;
+            edgeUse[edgeKey(p1, p2)]++;
+            edgeUse[edgeKey(p2, p0)]++;
+        }
+
+        // open borders get a plane through the edge, perpendicular to its triangle
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (!alive[t]) continue;
+            uint32_t p[3] = {positionOf[triangles[t][0]], positionOf[triangles[t][1]], positionOf[triangles[t][2]]};
+            glm::vec3 normal = glm::cross(point(p[1]) - point(p[0]), point(p[2]) - point(p[0]));
+            for (int e = 0; e < 3; ++e) {
+                uint32_t a = p[e], b = p[(e + 1) % 3];
+                if (edgeUse[edgeKey(a, b)] != 1) continue;
+                glm::vec3 edge = point(b) - point(a);
+                glm::vec3 perpendicular = glm::cross(edge, normal);
+                float length = glm::length(perpendicular);
+                if (!(length > 0.f)) continue;
+                perpendicular /= length;
+                Quadric q = Quadric::plane(perpendicular, -glm::dot(perpendicular, point(a)),
+                    static_cast<double>(glm::dot(edge, edge)) * BORDER_WEIGHT);
+                quadrics[a] += q;
+                quadrics[b] += q;
+            }
+        }
+
+        std::vector<uint32_t> version(positionCount, 0);
+        std::vector<bool> removed(positionCount, false);
+        std::priority_queue<Collapse> queue{};
+        auto collapseCost = [&](uint32_t from, uint32_t to) {
+            Quadric q = quadrics[from];
+            q += quadrics[to];
+            return q.error(point(to));
+        };
+        auto push = [&](uint32_t a, uint32_t b) {
+            double ab = collapseCost(a, b);
+            double ba = collapseCost(b, a);
+            if (ab <= ba) queue.push({ab, a, b, version[a], version[b]});
+            else queue.push({ba, b, a, version[b], version[a]});
+        };
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (!alive[t]) continue;
+            for (int e = 0; e < 3; ++e) push(positionOf[triangles[t][e]], positionOf[triangles[t][(e + 1) % 3]]);
+        }
+
+        // a collapse must not turn any remaining triangle of from around
+        auto flips = [&](uint32_t from, uint32_t to) {
+            for (uint32_t t : trianglesOf[from]) {
+                if (!alive[t]) continue;
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                bool touchesTarget = false;
+                for (int corner = 0; corner < 3; ++corner) {
+                    uint32_t p = positionOf[triangles[t][corner]];
+                    touchesTarget |= p == to;
+                    before[corner] = point(p);
+                    after[corner] = p == from ? point(to) : point(p);
+                }
+                if (touchesTarget) continue;
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(n0, n1) <= 0.f) return true;
+            }
+            return false;
+        };
+
+        double maxCost = 0.0;
+        size_t targetTriangles = targetIndexCount / 3;
+        while (aliveCount > targetTriangles && !queue.empty()) {
+            Collapse collapse = queue.top();
+            queue.pop();
+            uint32_t from = collapse.from;
+            uint32_t to = collapse.to;
+            if (removed[from] || removed[to]) continue;
+            if (version[from] != collapse.fromVersion || version[to] != collapse.toVersion) continue;
+            if (flips(from, to)) continue;
+
+            for (uint32_t t : trianglesOf[from]) {
+                if (!alive[t]) continue;
+                bool touchesTarget = false;
+                for (uint32_t v : triangles[t]) touchesTarget |= positionOf[v] == to;
+                if (touchesTarget) {
+                    alive[t] = false;
+                    --aliveCount;
+                    continue;
+                }
+                // each vertex at from moves to the vertex at to with the closest attributes
+                for (uint32_t& v : triangles[t]) {
+                    if (positionOf[v] != from) continue;
+                    uint32_t best = members[to][0];
+                    for (uint32_t candidate : members[to]) {
+                        if (attributeDistance(vertices[v], vertices[candidate]) < attributeDistance(vertices[v], vertices[best])) {
+                            best = candidate;
+                        }
+                    }
+                    v = best;
+                }
+                trianglesOf[to].push_back(t);
+            }
+
+            trianglesOf[from].clear();
+            removed[from] = true;
+            quadrics[to] += quadrics[from];
+            ++version[to];
+            maxCost = std::max(maxCost, collapse.cost);
+
+            // every edge at to changed its cost, drop the dead triangles while revisiting them
+            auto& around = trianglesOf[to];
+            around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !alive[t]; }), around.end());
+            for (uint32_t t : around) {
+                for (uint32_t v : triangles[t]) {
+                    if (positionOf[v] != to) push(to, positionOf[v]);
+                }
+            }
+        }
+
+        std::vector<uint32_t> result{};
+        result.reserve(aliveCount * 3);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (alive[t]) result.insert(result.end(), triangles[t].begin(), triangles[t].end());
+        }
+        error = static_cast<float>(std::sqrt(maxCost));
+        return result;
+    }
+}
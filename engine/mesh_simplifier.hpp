@@ -0,0 +1,40 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/*
+    Quadric error mesh simplification (Garland & Heckbert 1997) for the LOD chain
+    built by Model::Builder::buildLods
+
+    Every position accumulates the planes of its triangles (area weighted) plus
+    perpendicular planes along open borders, so borders stay in place. Edges are
+    collapsed cheapest first onto one of their two endpoints (half-edge collapse),
+    so no new vertices are created and every LOD indexes the same vertex buffer.
+
+    Vertices welded apart by their normal or uv (seams) share a position and are
+    collapsed together; each one moves to the vertex of the target position with
+    the closest attributes, so seams never tear open.
+
+    The error of a collapse is the area weighted mean squared distance to the
+    original planes, simplify() reports the square root of the largest one, in
+    model units.
+*/
+
+namespace engine {
+    class MeshSimplifier {
+        public:
+            // meshes (or LODs) with fewer triangles are not simplified any further
+            static constexpr uint32_t MIN_TRIANGLES = 64;
+            // border planes count this much more than the planes of the triangles themselves
+            static constexpr float BORDER_WEIGHT = 10.f;
+
+            // returns at most targetIndexCount indices where the mesh allows it, error receives the
+            // largest collapse error; vertices are only read, the result references the same ones
+            static std::vector<uint32_t> simplify(
+                const std::vector<Model::Vertex>& vertices, const std::vector<uint32_t>& indices,
+                size_t targetIndexCount, float& error);
+    };
+}
@@ -0,0 +1,189 @@
+#include "meshlet_builder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace engine {
+    namespace {
+        constexpr uint32_t NONE = UINT32_MAX;
+        // cones wider than this (minimum normal / axis cosine) are never backfacing in practice
+        constexpr float MIN_CONE_COSINE = 0.1f;
+        // how much a triangle facing away from the meshlet's average normal counts as being further away
+        constexpr float CONE_WEIGHT = 4.f;
+
+        glm::vec3 unitNormal(const Model::Vertex* vertices, const uint32_t* triangle) {
+            const glm::vec3& p0 = vertices[triangle[0]].position;
+            glm::vec3 normal = glm::cross(vertices[triangle[1]].position - p0, vertices[triangle[2]].position - p0);
+            float length = glm::length(normal);
+            return length > 0.f ? normal / length : glm::vec3{0.f};
+        }
+
+        // bounding sphere and normal cone of the meshlet's index range
+        void computeBounds(const Model::Vertex* vertices, const uint32_t* indices, Model::Meshlet& meshlet) {
+            glm::vec3 min{std::numeric_limits<float>::max()};
+            glm::vec3 max{std::numeric_limits<float>::lowest()};
+            for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+                const glm::vec3& p = vertices[indices[meshlet.firstIndex + i]].position;
+                min = glm::min(min, p);
+                max = glm::max(max, p);
+            }
+            meshlet.center = (min + max) * 0.5f;
+            meshlet.radius = 0.f;
+            for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+                const glm::vec3& p = vertices[indices[meshlet.firstIndex + i]].position;
+                meshlet.radius = std::max(meshlet.radius, glm::length(p - meshlet.center));
+            }
+
+            // the axis is the average unit normal, the cone has to reach the normal furthest from it
+            std::vector<glm::vec3> normals{};
+            normals.reserve(meshlet.indexCount / 3);
+            glm::vec3 axis{0.f};
+            for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+                glm::vec3 normal = unitNormal(vertices, indices + meshlet.firstIndex + i);
+                // degenerate triangles are invisible, they don't widen the cone
+                if (normal == glm::vec3{0.f}) continue;
+                normals.push_back(normal);
+                axis += normal;
+            }
+
+            meshlet.coneAxis = glm::vec3{0.f, 0.f, 1.f};
+            meshlet.coneCutoff = 1.f;
+            float axisLength = glm::length(axis);
+            if (normals.empty() || !(axisLength > 0.f)) return;
+            axis /= axisLength;
+
+            float minCosine = 1.f;
+            for (const auto& normal : normals) minCosine = std::min(minCosine, glm::dot(normal, axis));
+            if (minCosine < MIN_CONE_COSINE) return;
+
+            meshlet.coneAxis = axis;
+            meshlet.coneCutoff = std::sqrt(1.f - minCosine * minCosine);
+        }
+    }
+
+    std::vector<Model::Meshlet> MeshletBuilder::build(
+        const Model::Vertex* vertices, uint32_t vertexCount, std::vector<uint32_t>& indices,
+        uint32_t maxVertices, uint32_t maxTriangles) {
+        std::vector<Model::Meshlet> meshlets{};
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) return meshlets;
+
+        // triangles using each vertex, in compressed row storage
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (uint32_t index : indices) offsets[index + 1]++;
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i) adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+        std::vector<bool> used(triangleCount, false);
+        // id of the meshlet currently holding each vertex
+        std::vector<uint32_t> owner(vertexCount, NONE);
+        std::vector<uint32_t> meshletVertices{};
+        std::vector<uint32_t> meshletTriangles{};
+        std::vector<uint32_t> output{};
+        output.reserve(indices.size());
+
+        auto newVertices = [&](uint32_t triangle, uint32_t id) {
+            const uint32_t* t = &indices[3 * triangle];
+            uint32_t count = 0;
+            for (int corner = 0; corner < 3; ++corner) {
+                bool repeated = (corner > 0 && t[corner] == t[0]) || (corner > 1 && t[corner] == t[1]);
+                if (owner[t[corner]] != id && !repeated) ++count;
+            }
+            return count;
+        };
+
+        size_t cursor = 0;
+        while (true) {
+            while (cursor < triangleCount && used[cursor]) ++cursor;
+            if (cursor == triangleCount) break;
+
+            uint32_t id = static_cast<uint32_t>(meshlets.size());
+            meshletVertices.clear();
+            meshletTriangles.clear();
+            glm::vec3 centroidSum{0.f};
+            glm::vec3 normalSum{0.f};
+            auto add = [&](uint32_t triangle) {
+                used[triangle] = true;
+                normalSum += unitNormal(vertices, &indices[3 * triangle]);
+                meshletTriangles.push_back(triangle);
+                for (int corner = 0; corner < 3; ++corner) {
+                    uint32_t v = indices[3 * triangle + corner];
+                    if (owner[v] == id) continue;
+                    owner[v] = id;
+                    meshletVertices.push_back(v);
+                    centroidSum += vertices[v].position;
+                }
+            };
+
+            add(static_cast<uint32_t>(cursor));
+            while (meshletTriangles.size() < maxTriangles) {
+                glm::vec3 centroid = centroidSum / static_cast<float>(meshletVertices.size());
+                float normalLength = glm::length(normalSum);
+                glm::vec3 normal = normalLength > 0.f ? normalSum / normalLength : glm::vec3{0.f};
+                uint32_t best = NONE;
+                uint32_t bestNew = NONE;
+                float bestDistance = 0.f;
+                for (uint32_t v : meshletVertices) {
+                    for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a) {
+                        uint32_t triangle = adjacency[a];
+                        if (used[triangle]) continue;
+                        uint32_t added = newVertices(triangle, id);
+                        if (meshletVertices.size() + added > maxVertices || added > bestNew) continue;
+
+                        const uint32_t* t = &indices[3 * triangle];
+                        glm::vec3 center = (vertices[t[0]].position + vertices[t[1]].position + vertices[t[2]].position) / 3.f;
+                        glm::vec3 offset = center - centroid;
+                        // keeping the normals together keeps the cone narrow enough to cull
+                        float spread = 1.f - glm::dot(unitNormal(vertices, t), normal);
+                        float distance = glm::dot(offset, offset) * (1.f + CONE_WEIGHT * spread);
+                        if (added < bestNew || distance < bestDistance) {
+                            best = triangle;
+                            bestNew = added;
+                            bestDistance = distance;
+                        }
+                    }
+                }
+
+                // no connected triangle fits, continue with the next one in index order,
+                // after optimize() it is usually close by
+                if (best == NONE) {
+                    while (cursor < triangleCount && used[cursor]) ++cursor;
+                    if (cursor == triangleCount) break;
+                    if (meshletVertices.size() + newVertices(static_cast<uint32_t>(cursor), id) > maxVertices) break;
+                    best = static_cast<uint32_t>(cursor);
+                }
+                add(best);
+            }
+
+            // keep the input order inside the meshlet, it is already tuned for the vertex cache
+            std::sort(meshletTriangles.begin(), meshletTriangles.end());
+            Model::Meshlet meshlet{};
+            meshlet.firstIndex = static_cast<uint32_t>(output.size());
+            meshlet.indexCount = static_cast<uint32_t>(meshletTriangles.size() * 3);
+            for (uint32_t triangle : meshletTriangles) {
+                output.insert(output.end(), indices.begin() + 3 * triangle, indices.begin() + 3 * triangle + 3);
+            }
+            meshlets.push_back(meshlet);
+        }
+
+        indices.swap(output);
+        for (auto& meshlet : meshlets) computeBounds(vertices, indices.data(), meshlet);
+        return meshlets;
+    }
+
+    bool MeshletBuilder::isBackfacing(const Model::Meshlet& meshlet, const glm::vec3& cameraPosition) {
+        /*
+        a triangle faces away when its normal points away from the camera: dot(p - camera, n) >= 0.
+        For all points of the bounding sphere and all normals of the cone this holds when the
+        view direction to the sphere lies within 90 degrees - half angle of the axis, which with
+        coneCutoff = sin(half angle) becomes:
+        dot(center - camera, axis) >= coneCutoff * |center - camera| + radius
+         */
+        glm::vec3 toCenter = meshlet.center - cameraPosition;
+        return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+    }
+}
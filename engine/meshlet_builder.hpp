@@ -0,0 +1,37 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/*
+    Splits an indexed triangle list into meshlets (Model::Meshlet) for per-cluster culling
+
+    Meshlets are grown greedily from the first unused triangle in index order: the next
+    triangle is the neighbour that adds the fewest new vertices, ties go to the one
+    closest to the meshlet's centroid, with triangles facing away from the meshlet's
+    average normal counted as further away. Each meshlet's triangles keep their relative order
+    and are moved next to each other, so a meshlet is a plain index range drawn with
+    vkCmdDrawIndexed by the regular triangle-list pipeline (no mesh shaders).
+
+    Culling, done on the cpu per object and frame:
+    - bounding sphere against the camera frustum (Frustum::intersectsSphere)
+    - normal cone: every triangle of the meshlet faces away from the camera (isBackfacing)
+*/
+
+namespace engine {
+    class MeshletBuilder {
+        public:
+            static constexpr uint32_t MAX_VERTICES = 64;
+            static constexpr uint32_t MAX_TRIANGLES = 124;
+
+            // reorders indices so every meshlet is a contiguous range, returns the meshlets in index order
+            static std::vector<Model::Meshlet> build(
+                const Model::Vertex* vertices, uint32_t vertexCount, std::vector<uint32_t>& indices,
+                uint32_t maxVertices = MAX_VERTICES, uint32_t maxTriangles = MAX_TRIANGLES);
+
+            // cameraPosition in the meshlet's model space, triangles are front facing when counter-clockwise
+            static bool isBackfacing(const Model::Meshlet& meshlet, const glm::vec3& cameraPosition);
+    };
+}
@@ -1,106 +1,434 @@
 #include "model.hpp"
-#include "utils.hpp"
+#include "defragmenter.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "meshlet_builder.hpp"
+#include "mesh_simplifier.hpp"
+#include "obj_parser.hpp"
+#include "vertex_packing.hpp"
+#include "vertex_welder.hpp"
 
 #include <tiny_obj_loader.h>
-// GLM_GTX is an experimental extension
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 
+#include <algorithm>
 #include <cassert>
-#include <unordered_map>
+#include <cstring>
 #include <iostream>
+#include <limits>
 
-namespace std{
-    // create hash value for Vertex struct
-    template<> struct hash<engine::Model::Vertex>{
-        size_t operator()(engine::Model::Vertex const& vertex) const{
-            size_t seed = 0;
-            engine::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-            return seed;
-        }
-    };
+namespace engine {
+    namespace {
+        void loadWithTinyObj(const std::string& filePath, ObjData& obj) {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string warn;
+            std::string err;
+
+            if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.c_str())){
+                throw std::runtime_error(warn + err);
+            }
 
-}
+            obj.vertices = std::move(attrib.vertices);
+            obj.colors = std::move(attrib.colors);
+            obj.normals = std::move(attrib.normals);
+            obj.texcoords = std::move(attrib.texcoords);
+            for(const auto& shape: shapes){
+                for(const auto& index : shape.mesh.indices){
+                    obj.indices.push_back({index.vertex_index, index.normal_index, index.texcoord_index});
+                }
+            }
+        }
+    }
 
-namespace engine {
-    void Model::Builder::loadModel(const std::string& filePath){
+    void Model::Builder::loadModel(const std::string& filePath, ObjLoader loader){
         /* 
-        This function will call the tinyobjloader to load the .obj model from the file path
+        This function will call the tinyobjloader (or the multi-threaded ObjParser)
+        to load the .obj model from the file path
          */
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn;
-        std::string err;
-
-        if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.c_str())){
-            throw std::runtime_error(warn + err);
-        }
-
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-        for(const auto& shape: shapes){
-            for(const auto& index : shape.mesh.indices){
-                Vertex vertex{};
-                if(index.vertex_index >= 0){
-                    vertex.position = {
-                        attrib.vertices[3 * index.vertex_index + 0],
-                        attrib.vertices[3 * index.vertex_index + 1],
-                        attrib.vertices[3 * index.vertex_index + 2]
-                    };
-
-                    vertex.color = {
-                        attrib.colors[3 * index.vertex_index + 0],
-                        attrib.colors[3 * index.vertex_index + 1],
-                        attrib.colors[3 * index.vertex_index + 2]
-                    };
-                }
+        ObjData obj{};
+        // ObjParser declines files with n-gons, tinyobjloader handles those
+        if(loader != ObjLoader::Parallel || !ObjParser::parse(filePath, obj)){
+            obj = ObjData{};
+            loadWithTinyObj(filePath, obj);
+        }
 
-                if(index.normal_index >= 0){
-                    vertex.normal = {
-                        attrib.normals[3 * index.normal_index + 0],
-                        attrib.normals[3 * index.normal_index + 1],
-                        attrib.normals[3 * index.normal_index + 2]
-                    };
-                }
+        // one position per unique vertex is a good first guess for the welding table size
+        VertexWelder welder{vertices, obj.vertices.size() / 3};
+        indices.reserve(indices.size() + obj.indices.size());
+        for(const auto& index : obj.indices){
+            Vertex vertex{};
+            if(index.vertex >= 0){
+                vertex.position = {
+                    obj.vertices[3 * index.vertex + 0],
+                    obj.vertices[3 * index.vertex + 1],
+                    obj.vertices[3 * index.vertex + 2]
+                };
+
+                vertex.color = {
+                    obj.colors[3 * index.vertex + 0],
+                    obj.colors[3 * index.vertex + 1],
+                    obj.colors[3 * index.vertex + 2]
+                };
+            }
 
-                if(index.texcoord_index >= 0){
-                    vertex.uv = {
-                        attrib.texcoords[2 * index.texcoord_index + 0],
-                        attrib.texcoords[2 * index.texcoord_index + 1],
-                    };
-                }
+            if(index.normal >= 0){
+                vertex.normal = {
+                    obj.normals[3 * index.normal + 0],
+                    obj.normals[3 * index.normal + 1],
+                    obj.normals[3 * index.normal + 2]
+                };
+            }
 
-                // check if the vertex is new => if it's in the uniqueVertices map
-                // if it's new, add it to the uniqueVertices map and the vertices vector to record its index
-                if(uniqueVertices.count(vertex) == 0){
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                    vertices.push_back(vertex);
-                }
-                indices.push_back(uniqueVertices[vertex]);
+            if(index.texcoord >= 0){
+                vertex.uv = {
+                    obj.texcoords[2 * index.texcoord + 0],
+                    obj.texcoords[2 * index.texcoord + 1],
+                };
             }
 
+            // new vertices are appended to the vertices vector, repeated ones reuse their first index
+            indices.push_back(welder.weld(vertex));
         }
     }
-    
 
-    Model::Model(Device& device, const Builder& builder) : device{device} {
-        createVertexBuffers(builder.vertices);
-        createIndexBuffers(builder.indices);
+    std::vector<Model::Builder::OptimizeStep> Model::Builder::optimize(){
+        std::vector<OptimizeStep> steps{};
+        auto record = [&](const char* name) {
+            auto stats = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+            steps.push_back({name, stats.acmr, stats.atvr});
+        };
+
+        record("input");
+        auto hardClusters = MeshOptimizer::optimizeVertexCache(indices, vertices.size());
+        record("vertex cache");
+        MeshOptimizer::optimizeOverdraw(indices, vertices, hardClusters);
+        record("overdraw");
+        MeshOptimizer::optimizeVertexFetch(vertices, indices);
+        record("vertex fetch");
+        return steps;
+    }
+
+    void Model::Builder::buildMeshlets(){
+        // only the full resolution level is split, the lods behind it keep their order
+        size_t fullCount = lods.empty() ? indices.size() : lods[0].indexCount;
+        std::vector<uint32_t> full(indices.begin(), indices.begin() + fullCount);
+        meshlets = MeshletBuilder::build(vertices.data(), static_cast<uint32_t>(vertices.size()), full);
+        std::copy(full.begin(), full.end(), indices.begin());
+    }
+
+    void Model::Builder::buildLods(uint32_t lodCount, float reduction){
+        // rebuilding replaces the previous chain
+        if (!lods.empty()) indices.resize(lods[0].indexCount);
+        lods.assign(1, Lod{0, static_cast<uint32_t>(indices.size()), 0.f});
+
+        // each level simplifies the previous one, so the errors add up
+        std::vector<uint32_t> previous = indices;
+        float error = 0.f;
+        while (lods.size() < lodCount) {
+            size_t targetTriangles = static_cast<size_t>(previous.size() / 3 * reduction);
+            if (targetTriangles < MeshSimplifier::MIN_TRIANGLES) break;
+
+            float levelError = 0.f;
+            auto level = MeshSimplifier::simplify(vertices, previous, targetTriangles * 3, levelError);
+            // stop once the simplifier gets stuck far from the target (e.g. on borders)
+            if (level.size() / 3 > (previous.size() / 3 + targetTriangles) / 2) break;
+
+            MeshOptimizer::optimizeVertexCache(level, vertices.size());
+            error += levelError;
+            lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), error});
+            indices.insert(indices.end(), level.begin(), level.end());
+            previous = std::move(level);
+        }
     }
 
-    Model::~Model() {}
+    Model::Model(Device& device, const Builder& builder, VertexLayout layout)
+        : Model(device,
+            builder.vertices.data(), static_cast<uint32_t>(builder.vertices.size()),
+            builder.indices.data(), static_cast<uint32_t>(builder.indices.size()), layout,
+            builder.lods.data(), static_cast<uint32_t>(builder.lods.size())) {
+        meshlets = builder.meshlets;
+    }
+
+    Model::Model(Device& device, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+        VertexLayout layout, const Lod* lods, uint32_t lodCount, UploadBatch* upload)
+        : device{device} {
+        create(vertices, vertexCount, indices, indexCount, layout, lods, lodCount, upload);
+    }
+
+    Model::Model(Device& device, const Builder& builder, VertexLayout layout, UploadBatch& upload)
+        : device{device} {
+        create(builder.vertices.data(), static_cast<uint32_t>(builder.vertices.size()),
+            builder.indices.data(), static_cast<uint32_t>(builder.indices.size()), layout,
+            builder.lods.data(), static_cast<uint32_t>(builder.lods.size()), &upload);
+        meshlets = builder.meshlets;
+    }
+
+    void Model::create(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+        VertexLayout layout, const Lod* lods, uint32_t lodCount, UploadBatch* upload) {
+        pool = geometryPool;
+        // a model on its own still waits only once, for its vertex and index copies together
+        std::unique_ptr<UploadBatch> ownBatch{};
+        if (upload == nullptr) {
+            ownBatch = std::make_unique<UploadBatch>(device);
+            upload = ownBatch.get();
+        }
+        this->upload = upload;
+        createVertexBuffers(vertices, vertexCount, layout);
+        createIndexBuffers(indices, indexCount);
+        this->upload = nullptr;
+        // nothing to wait for when all geometry was written in place
+        if (ownBatch && ownBatch->getCopyCount() > 0) {
+            ownBatch->submit();
+            ownBatch->wait();
+        }
+        // without a chain the whole index buffer is the only level
+        if (lodCount > 0) this->lods.assign(lods, lods + lodCount);
+        else this->lods.assign(1, Lod{0, indexCount, 0.f});
+    }
+
+    Model::~Model() {
+        if (relocator != nullptr) {
+            relocator->untrack(vertexBuffer.get());
+            if (indexBuffer) relocator->untrack(indexBuffer.get());
+        }
+        // the gpu side exists from restore() on and until completeEviction()
+        if (hasIndexBuffer && (resident || restoring)) {
+            indexStats.residentBytes -= uint64_t{indexCount} * indexSize;
+            indexStats.residentBytesUint32 -= uint64_t{indexCount} * sizeof(uint32_t);
+        }
+        if (pool != nullptr && vertexAllocation != nullptr) {
+            pool->free(vertexAllocation);
+            if (indexAllocation != nullptr) pool->free(indexAllocation);
+        }
+    }
+
+    VkDeviceSize Model::getGeometryBytes() const {
+        VkDeviceSize bytes = static_cast<VkDeviceSize>(vertexSize) * vertexCount;
+        if (hasIndexBuffer) bytes += static_cast<VkDeviceSize>(indexSize) * indexCount;
+        return bytes;
+    }
+
+    void Model::evict(UploadBatch* readback) {
+        if (!resident || evicting) return;
+
+        // a model on its own waits for its read back
+        std::unique_ptr<UploadBatch> ownBatch{};
+        if (readback == nullptr) {
+            ownBatch = std::make_unique<UploadBatch>(device, true);
+            readback = ownBatch.get();
+        }
+        // a relocation after the read back was recorded would retire the buffer it reads
+        if (relocator != nullptr) {
+            relocator->untrack(vertexBuffer.get());
+            if (indexBuffer) relocator->untrack(indexBuffer.get());
+            relocator = nullptr;
+        }
+
+        VkDeviceSize vertexBytes = getVertexBytes();
+        evictedVertices.resize(vertexBytes);
+        if (pool != nullptr) {
+            vertexReadback = copyFromDevice(pool->getVertexBuffer(), vertexAllocation->offset, vertexBytes,
+                evictedVertices.data(), *readback);
+        } else {
+            vertexReadback = copyFromDevice(*vertexBuffer, 0, vertexBytes, evictedVertices.data(), *readback);
+        }
+        if (hasIndexBuffer) {
+            VkDeviceSize indexBytes = getIndexBytes();
+            evictedIndices.resize(indexBytes);
+            if (pool != nullptr) {
+                indexReadback = copyFromDevice(pool->getIndexBuffer(), indexAllocation->offset, indexBytes,
+                    evictedIndices.data(), *readback);
+            } else {
+                indexReadback = copyFromDevice(*indexBuffer, 0, indexBytes, evictedIndices.data(), *readback);
+            }
+        }
+        evicting = true;
+
+        if (ownBatch) {
+            if (ownBatch->getCopyCount() > 0) {
+                ownBatch->submit();
+                ownBatch->wait();
+            }
+            completeEviction();
+        }
+    }
+
+    void Model::completeEviction() {
+        if (!evicting) return;
+        evicting = false;
+
+        // the read backs completed, the device local geometry lands in the host copy
+        if (vertexReadback) memcpy(evictedVertices.data(), vertexReadback->getMappedMemory(), evictedVertices.size());
+        if (indexReadback) memcpy(evictedIndices.data(), indexReadback->getMappedMemory(), evictedIndices.size());
+        vertexReadback.reset();
+        indexReadback.reset();
+
+        if (hasIndexBuffer) {
+            indexStats.residentBytes -= getIndexBytes();
+            indexStats.residentBytesUint32 -= uint64_t{indexCount} * sizeof(uint32_t);
+        }
+        if (pool != nullptr) {
+            pool->free(vertexAllocation);
+            if (indexAllocation != nullptr) pool->free(indexAllocation);
+            vertexAllocation = nullptr;
+            indexAllocation = nullptr;
+        }
+        vertexBuffer.reset();
+        indexBuffer.reset();
+        resident = false;
+    }
+
+    void Model::cancelEviction() {
+        if (!evicting) return;
+        evicting = false;
+        vertexReadback.reset();
+        indexReadback.reset();
+        evictedVertices = std::vector<uint8_t>{};
+        evictedIndices = std::vector<uint8_t>{};
+        // bind() hands the buffers to the defragmenter again
+    }
+
+    void Model::restore(UploadBatch* upload) {
+        if (resident || restoring) return;
+
+        std::unique_ptr<UploadBatch> ownBatch{};
+        if (upload == nullptr) {
+            ownBatch = std::make_unique<UploadBatch>(device);
+            upload = ownBatch.get();
+        }
+        // same pool, layout and index type as before the eviction
+        this->upload = upload;
+        createVertexBuffers(evictedVertices.data(), vertexSize, vertexCount);
+        if (hasIndexBuffer) uploadIndices(evictedIndices.data());
+        this->upload = nullptr;
+
+        // the staging copies were taken, the host copy can go
+        evictedVertices = std::vector<uint8_t>{};
+        evictedIndices = std::vector<uint8_t>{};
+        restoring = true;
+
+        if (ownBatch) {
+            if (ownBatch->getCopyCount() > 0) {
+                ownBatch->submit();
+                ownBatch->wait();
+            }
+            completeRestore();
+        }
+    }
+
+    void Model::completeRestore() {
+        if (!restoring) return;
+        restoring = false;
+        resident = true;
+    }
+
+    Model::IndexStats Model::indexStats{};
+    Model::UploadStats Model::uploadStats{};
+    GeometryPool* Model::geometryPool = nullptr;
+    Defragmenter* Model::defragmenter = nullptr;
+
+    void Model::resetDrawStats() {
+        indexStats.drawnBytes = 0;
+        indexStats.drawnBytesUint32 = 0;
+    }
+
+    void Model::Builder::loadCachedModel(const std::string& filePath, bool withMeshlets, uint32_t lodCount){
+        vertices.clear();
+        indices.clear();
+        meshlets.clear();
+        lods.clear();
+
+        auto cached = MeshCache::open(filePath);
+        // a cache holding a chain of another length is rebuilt like a stale one
+        if (cached && cached->header().lodLimit == lodCount) {
+            vertices.assign(cached->vertices(), cached->vertices() + cached->vertexCount());
+            indices.assign(cached->indices(), cached->indices() + cached->indexCount());
+            lods.assign(cached->lods(), cached->lods() + cached->lodCount());
+            std::cout << "vertices size: " << vertices.size() << " (mesh cache)" << std::endl;
+        }
+        else {
+            loadModel(filePath);
+            // optimized once here, the mesh cache stores the optimized order
+            auto steps = optimize();
+
+            std::cout<< "vertices size: " << vertices.size()
+                << ", ACMR " << steps.front().acmr << " -> " << steps.back().acmr << std::endl;
+
+            // the simplified levels are appended to the optimized indices and cached with them
+            buildLods(lodCount);
+            std::cout << "lods: " << lods.size() << ", coarsest " << lods.back().indexCount / 3
+                << " triangles" << std::endl;
+
+            MeshCache::write(filePath, *this, lodCount);
+        }
+
+        // built after the cache write, the cache keeps the plain optimized order
+        if (withMeshlets) {
+            buildMeshlets();
+            std::cout << "meshlets: " << meshlets.size() << std::endl;
+        }
+    }
+
+    std::unique_ptr<Model> Model::createModelFromFile(Device& device, const std::string& filePath,
+        bool withMeshlets, uint32_t lodCount, UploadBatch* upload){
+        // a valid mesh cache is mapped and uploaded as-is, skipping the .obj parse entirely
+        // (meshlets regroup the indices, so they need a copy of the mapped geometry)
+        // every asset gets the most compact vertex layout that represents it without visible loss
+        if (!withMeshlets) {
+            auto cached = MeshCache::open(filePath);
+            if (cached && cached->header().lodLimit == lodCount) {
+                std::cout << "vertices size: " << cached->vertexCount() << " (mesh cache)" << std::endl;
+                return std::make_unique<Model>(
+                    device, cached->vertices(), cached->vertexCount(), cached->indices(), cached->indexCount(),
+                    VertexPacking::chooseLayout(cached->vertices(), cached->vertexCount()), cached->lods(), cached->lodCount(),
+                    upload);
+            }
+        }
 
-    std::unique_ptr<Model> Model::createModelFromFile(Device& device, const std::string& filePath){
         // initialize the Model instance with the builder, using unique_ptr
         Model::Builder builder{};
-        builder.loadModel(filePath);
-        
-        std::cout<< "vertices size: " << builder.vertices.size() << std::endl;
-        
-        return std::make_unique<Model>(device, builder);
+        builder.loadCachedModel(filePath, withMeshlets, lodCount);
+        VertexLayout layout = VertexPacking::chooseLayout(builder.vertices.data(), static_cast<uint32_t>(builder.vertices.size()));
+        if (upload != nullptr) return std::make_unique<Model>(device, builder, layout, *upload);
+        return std::make_unique<Model>(device, builder, layout);
     }
 
-    void Model::createVertexBuffers(const std::vector<Vertex>& vertices){
+    void Model::createVertexBuffers(const Vertex* vertices, uint32_t vertexCount, VertexLayout layout){
+        // bounding sphere around the center of the bounding box, for LOD selection
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{std::numeric_limits<float>::lowest()};
+        for (uint32_t i = 0; i < vertexCount; ++i) {
+            min = glm::min(min, vertices[i].position);
+            max = glm::max(max, vertices[i].position);
+        }
+        boundsCenter = (min + max) * 0.5f;
+        boundsRadius = 0.f;
+        for (uint32_t i = 0; i < vertexCount; ++i) {
+            boundsRadius = std::max(boundsRadius, glm::length(vertices[i].position - boundsCenter));
+        }
+
+        // the packed layouts are converted on the cpu before the upload
+        vertexLayout = layout;
+        dequantizeMatrix = glm::mat4{1.f};
+        switch (layout) {
+            case VertexLayout::Packed: {
+                auto packed = VertexPacking::pack(vertices, vertexCount);
+                createVertexBuffers(packed.data(), sizeof(PackedVertex), vertexCount);
+                break;
+            }
+            case VertexLayout::PackedQuantized: {
+                auto quantized = VertexPacking::quantize(vertices, vertexCount, dequantizeMatrix);
+                createVertexBuffers(quantized.data(), sizeof(QuantizedVertex), vertexCount);
+                break;
+            }
+            default:
+                createVertexBuffers(vertices, sizeof(Vertex), vertexCount);
+                break;
+        }
+    }
+
+    void Model::createVertexBuffers(const void* vertexData, uint32_t vertexSize, uint32_t vertexCount){
         /* 
         map the memory to the vertex buffer,
         copy the data in cpu (vertices) to the gpu memory space
@@ -114,109 +442,197 @@ namespace engine {
         void *data      | vertex buffer memory
         vkMapMemory()   | 
         */
-        vertexCount = static_cast<uint32_t>(vertices.size());
+        this->vertexCount = vertexCount;
+        this->vertexSize = vertexSize;
         assert(vertexCount >= 3 && "Vertex count must be at least 3");
 
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-
-        uint32_t vertexSize = sizeof(vertices[0]);
+        VkDeviceSize bufferSize = static_cast<VkDeviceSize>(vertexSize) * vertexCount;
 
-        // use staging buffer for current static data to speed up
-        /* 
-        staging buffer is a buffer that is used as a temporary buffer to copy data from the cpu to the gpu
-        Host (cpu)      | Device (gpu)
-        ----------------|------------------
-        vertices
-        | memcpy()
-        v
-        void *data      | staging buffer memory
-        vkMapMemory()   |        | copyBuffer()
-                        |         v
-                        | vertex/ index buffer memory
-                        | (device local memory, faster)
-         */
-
-        Buffer stagingBuffer{
-            device,
-            vertexSize,
-            vertexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
-
-        // map the vertex buffer memory to the staging buffer
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*) vertices.data());
+        // a pooled model copies into its range of the shared vertex buffer instead
+        if (pool != nullptr) {
+            vertexAllocation = pool->allocateVertices(bufferSize, vertexSize, upload);
+            copyToDevice(vertexData, pool->getUploadVertexBuffer(), vertexAllocation->uploadOffset, bufferSize);
+            return;
+        }
 
-        // create the vertex buffer and copy data from staging buffer to vertex buffer
+        // create the vertex buffer and copy data from staging buffer to vertex buffer,
+        // transfer src for the read back on eviction and the defragmenter's copies
         vertexBuffer = std::make_unique<Buffer>(
             device,
             vertexSize,
             vertexCount,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            device.supportsDirectUploads() ? Device::DIRECT_UPLOAD_MEMORY : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 
-        device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+        copyToDevice(vertexData, *vertexBuffer, 0, bufferSize);
     }
 
-        void Model::createIndexBuffers(const std::vector<uint32_t>& indices){
+        void Model::createIndexBuffers(const uint32_t* indices, uint32_t indexCount){
         /* 
         same logic as createVertexBuffers
          */
-        indexCount = static_cast<uint32_t>(indices.size());
+        this->indexCount = indexCount;
         hasIndexBuffer = indexCount > 0;
 
         if (!hasIndexBuffer) return;
 
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-        uint32_t indexSize = sizeof(indices[0]);
-        
-        // call createBuffer from device.hpp
-        Buffer stagingBuffer{
+        // meshes with at most 65536 vertices only need half the index memory and fetch bandwidth
+        std::vector<uint16_t> narrowIndices{};
+        const void* indexData = indices;
+        if (vertexCount <= 65536) {
+            narrowIndices.assign(indices, indices + indexCount);
+            indexData = narrowIndices.data();
+            indexType = VK_INDEX_TYPE_UINT16;
+            indexSize = sizeof(uint16_t);
+        }
+        uploadIndices(indexData);
+    }
+
+    void Model::uploadIndices(const void* indexData){
+        VkDeviceSize bufferSize = static_cast<VkDeviceSize>(indexSize) * indexCount;
+        indexStats.residentBytes += bufferSize;
+        indexStats.residentBytesUint32 += uint64_t{indexCount} * sizeof(uint32_t);
+
+        if (pool != nullptr) {
+            indexAllocation = pool->allocateIndices(bufferSize, indexSize, upload);
+            copyToDevice(indexData, pool->getUploadIndexBuffer(), indexAllocation->uploadOffset, bufferSize);
+            return;
+        }
+
+        // create the vertex buffer and copy data from staging buffer to vertex buffer
+        indexBuffer = std::make_unique<Buffer>(
             device,
             indexSize,
             indexCount,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            device.supportsDirectUploads() ? Device::DIRECT_UPLOAD_MEMORY : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+
+        copyToDevice(indexData, *indexBuffer, 0, bufferSize);
+    }
+
+    void Model::copyToDevice(const void* data, Buffer& destination, VkDeviceSize offset, VkDeviceSize size){
+        // host visible device local memory (UMA, resizable BAR) is written in place, the range is
+        // new, so no submitted work reads it, and the next queue submission sees the host writes
+        if (destination.getMemoryPropertyFlags() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            bool mapped = destination.getMappedMemory() != nullptr;
+            if (!mapped) destination.map();
+            destination.writeToBuffer(const_cast<void*>(data), size, offset);
+            destination.flushDirty();
+            if (!mapped) destination.unmap();
+            uploadStats.directBytes += size;
+            return;
+        }
+
+        // use staging buffer for current static data to speed up
+        /* 
+        staging buffer is a buffer that is used as a temporary buffer to copy data from the cpu to the gpu
+        Host (cpu)      | Device (gpu)
+        ----------------|------------------
+        vertices
+        | memcpy()
+        v
+        void *data      | staging buffer memory
+        vkMapMemory()   |        | copyBuffer()
+                        |         v
+                        | vertex/ index buffer memory
+                        | (device local memory, faster)
+         */
+        auto stagingBuffer = std::make_unique<Buffer>(
+            device,
+            size,
+            1,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        );
 
         // map the vertex buffer memory to the staging buffer
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*) indices.data());
+        stagingBuffer->map();
+        stagingBuffer->writeToBuffer(const_cast<void*>(data));
 
-        // create the vertex buffer and copy data from staging buffer to vertex buffer
-        indexBuffer = std::make_unique<Buffer>(
+        // the batch owns the staging buffer until its fence signaled
+        upload->copyBuffer(std::move(stagingBuffer), destination, offset, size);
+        uploadStats.stagedBytes += size;
+    }
+
+    std::unique_ptr<Buffer> Model::copyFromDevice(Buffer& source, VkDeviceSize offset, VkDeviceSize size,
+        void* data, UploadBatch& readback){
+        // direct upload memory is host coherent, read in place
+        if (source.getMemoryPropertyFlags() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            bool mapped = source.getMappedMemory() != nullptr;
+            if (!mapped) source.map();
+            memcpy(data, static_cast<char*>(source.getMappedMemory()) + offset, size);
+            if (!mapped) source.unmap();
+            return nullptr;
+        }
+
+        auto readbackBuffer = std::make_unique<Buffer>(
             device,
-            indexSize,
-            indexCount,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            size,
+            1,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
         );
+        readbackBuffer->map();
+        readback.copyToHost(source, offset, size, *readbackBuffer);
+        return readbackBuffer;
+    }
+
+    int32_t Model::baseVertex() const {
+        // read at draw time, a compaction may have moved the ranges since the last frame
+        return vertexAllocation != nullptr ? static_cast<int32_t>(vertexAllocation->offset / vertexSize) : 0;
+    }
 
-        device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+    uint32_t Model::baseIndex() const {
+        return indexAllocation != nullptr ? static_cast<uint32_t>(indexAllocation->offset / indexSize) : 0;
     }
 
     void Model::bind(VkCommandBuffer commandBuffer){
         /* 
         call the model bind function after the pipeline bind function
          */
+        assert(resident && "Cannot bind an evicted model");
+        // drawn, so the uploads finished, the buffers may move from now on
+        if (pool == nullptr && relocator == nullptr && defragmenter != nullptr) {
+            relocator = defragmenter;
+            relocator->track(vertexBuffer.get());
+            if (indexBuffer) relocator->track(indexBuffer.get());
+        }
+        if (pool != nullptr) {
+            // non-indexed pooled models bind an index buffer they don't use, which is harmless
+            pool->bind(commandBuffer, indexType);
+            return;
+        }
+
         VkBuffer buffers[] = {vertexBuffer->getBuffer()};
         VkDeviceSize offsets[] = {0};
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
 
         if (hasIndexBuffer){
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, indexType);
         }
     }
 
     void Model::draw(VkCommandBuffer commandBuffer){
-        if(hasIndexBuffer){
-            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
-        }
-        else{
-            vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+        drawLod(commandBuffer, 0);
+    }
+
+    void Model::drawLod(VkCommandBuffer commandBuffer, uint32_t lod){
+        assert(lod < lods.size() && "LOD out of range");
+        // a model without indices has the one LOD {0, 0}, all of its vertices
+        if(!hasIndexBuffer){
+            vkCmdDraw(commandBuffer, vertexCount, 1, static_cast<uint32_t>(baseVertex()), 0);
+            return;
         }
+        drawRange(commandBuffer, lods[lod].firstIndex, lods[lod].indexCount);
+    }
+
+    void Model::drawRange(VkCommandBuffer commandBuffer, uint32_t firstIndex, uint32_t count){
+        assert(hasIndexBuffer && firstIndex + count <= indexCount && "Index range out of bounds");
+        vkCmdDrawIndexed(commandBuffer, count, 1, baseIndex() + firstIndex, baseVertex(), 0);
+        indexStats.drawnBytes += uint64_t{count} * indexSize;
+        indexStats.drawnBytesUint32 += uint64_t{count} * sizeof(uint32_t);
     }
 
     std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions(){
@@ -250,4 +666,40 @@ namespace engine {
         });
         return positionAttributeDescription;
     }
-}
\ No newline at end of file
+
+    std::vector<VkVertexInputBindingDescription> Model::PackedVertex::getBindingDescriptions(){
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = sizeof(PackedVertex);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> Model::PackedVertex::getAttributeDescriptions(){
+        // same locations as Vertex, the normal is decoded from its octahedral form in the shader
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PackedVertex, position)});
+        attributeDescriptions.push_back({1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color)});
+        attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal)});
+        attributeDescriptions.push_back({3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv)});
+        return attributeDescriptions;
+    }
+
+    std::vector<VkVertexInputBindingDescription> Model::QuantizedVertex::getBindingDescriptions(){
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = sizeof(QuantizedVertex);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> Model::QuantizedVertex::getAttributeDescriptions(){
+        // positions arrive in [-1, 1], the dequantize matrix is folded into the model matrix
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(QuantizedVertex, position)});
+        attributeDescriptions.push_back({1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(QuantizedVertex, color)});
+        attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal)});
+        attributeDescriptions.push_back({3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, uv)});
+        return attributeDescriptions;
+    }
+}
@@ -1,12 +1,17 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <atomic>
 #include <vector>
 
 #include "buffer.hpp"
 #include "device.hpp"
+#include "geometry_pool.hpp"
+#include "upload_batch.hpp"
 
 namespace engine{
+    class Defragmenter;
+
     class Model{
         public:
             struct Vertex
@@ -26,38 +31,255 @@ namespace engine{
                 }
             };
 
+            // index buffer totals over all live models, in bytes
+            struct IndexStats
+            {
+                // resident index buffer memory, and what it would be with uint32 indices only
+                std::atomic<uint64_t> residentBytes{0};
+                std::atomic<uint64_t> residentBytesUint32{0};
+                // indices fetched by draw() since the last resetDrawStats()
+                std::atomic<uint64_t> drawnBytes{0};
+                std::atomic<uint64_t> drawnBytesUint32{0};
+            };
+
+            // geometry bytes uploaded by all models
+            struct UploadStats
+            {
+                // copied through a staging buffer
+                std::atomic<uint64_t> stagedBytes{0};
+                // written straight into host visible device local memory, see Device::supportsDirectUploads
+                std::atomic<uint64_t> directBytes{0};
+            };
+
+            // how a model's vertices are stored on the gpu, see vertex_packing.hpp
+            enum class VertexLayout { Standard, Packed, PackedQuantized };
+
+            // 24 bytes: float position, unorm8 color, octahedral snorm16 normal, half float uv
+            struct PackedVertex
+            {
+                glm::vec3 position{};
+                uint32_t color = 0;
+                uint32_t normal = 0;
+                uint32_t uv = 0;
+                static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+                static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+            };
+
+            // 20 bytes: PackedVertex with snorm16 positions relative to the mesh bounds (w is padding)
+            struct QuantizedVertex
+            {
+                int16_t position[4]{};
+                uint32_t color = 0;
+                uint32_t normal = 0;
+                uint32_t uv = 0;
+                static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+                static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+            };
+
+            // a contiguous index range of at most 64 vertices / 124 triangles, see meshlet_builder.hpp
+            struct Meshlet
+            {
+                uint32_t firstIndex = 0;
+                uint32_t indexCount = 0;
+                // bounding sphere in model space
+                glm::vec3 center{};
+                float radius = 0.f;
+                // every triangle normal lies within the cone, coneCutoff is the sine of its half angle
+                // (1 when the cone is too wide to ever be backfacing)
+                glm::vec3 coneAxis{0.f, 0.f, 1.f};
+                float coneCutoff = 1.f;
+            };
+
+            // one level of detail, a range of the index buffer all levels share
+            struct Lod
+            {
+                uint32_t firstIndex = 0;
+                uint32_t indexCount = 0;
+                // how far (model units) the surface may be from the full resolution mesh
+                float error = 0.f;
+            };
+
+            // levels built by createModelFromFile, including the full resolution one
+            static constexpr uint32_t DEFAULT_LOD_COUNT = 4;
+            // triangle ratio between consecutive levels
+            static constexpr float LOD_REDUCTION = 0.5f;
+
             struct Builder
             {
+                // which .obj reader loadModel uses, both produce identical vertices/indices
+                enum class ObjLoader { TinyObj, Parallel };
+
                 std::vector<Vertex> vertices{};
                 std::vector<uint32_t> indices{};
 
-                void loadModel(const std::string& filePath);
+                void loadModel(const std::string& filePath, ObjLoader loader = ObjLoader::Parallel);
+
+                // vertex cache statistics after one step of optimize()
+                struct OptimizeStep
+                {
+                    const char* name;
+                    float acmr;
+                    float atvr;
+                };
+
+                // reorders triangles and vertices for the gpu (see mesh_optimizer.hpp),
+                // returns the statistics of the input followed by one entry per step
+                std::vector<OptimizeStep> optimize();
+
+                // empty unless buildMeshlets() ran, which regroups the indices cluster by cluster
+                std::vector<Meshlet> meshlets{};
+                void buildMeshlets();
+
+                // empty unless buildLods() ran, lods[0] is the full resolution mesh
+                std::vector<Lod> lods{};
+                // appends up to lodCount - 1 simplified copies of the mesh to indices (see mesh_simplifier.hpp),
+                // call after optimize(), which would mix the levels up
+                void buildLods(uint32_t lodCount = DEFAULT_LOD_COUNT, float reduction = LOD_REDUCTION);
+
+                // the cpu side of createModelFromFile: the mesh cache, or loadModel, optimize, buildLods
+                // and a cache write, then buildMeshlets; safe to run on a worker thread
+                void loadCachedModel(const std::string& filePath, bool withMeshlets = false, uint32_t lodCount = DEFAULT_LOD_COUNT);
             };
             
-            Model(Device& device, const Builder& builder);
+            // without an upload batch the constructors submit their copies in a batch of their own and wait for it
+            Model(Device& device, const Builder& builder, VertexLayout layout = VertexLayout::Standard);
+            // upload geometry straight from caller-owned memory (e.g. a mapped mesh cache)
+            Model(Device& device, const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+                VertexLayout layout = VertexLayout::Standard, const Lod* lods = nullptr, uint32_t lodCount = 0,
+                UploadBatch* upload = nullptr);
+            // records the buffer copies into upload, draw the model once upload.isComplete()
+            Model(Device& device, const Builder& builder, VertexLayout layout, UploadBatch& upload);
             ~Model();
 
             // delete copy constructor and operator to avoid copying the model
             Model(const Model&) = delete;
             Model& operator=(const Model&) = delete;
             
-            static std::unique_ptr<Model> createModelFromFile(Device& device, const std::string& filePath);
+            // withMeshlets splits big meshes into clusters the render system can cull one by one,
+            // lodCount limits the LOD chain (1 keeps the full resolution mesh only),
+            // with upload the copies join that batch instead of being waited for
+            static std::unique_ptr<Model> createModelFromFile(Device& device, const std::string& filePath,
+                bool withMeshlets = false, uint32_t lodCount = DEFAULT_LOD_COUNT, UploadBatch* upload = nullptr);
+
+            // models created while a pool is set sub-allocate their geometry from it instead of owning
+            // buffers, nullptr goes back to one vertex and index buffer per model
+            static void setGeometryPool(GeometryPool* pool) { geometryPool = pool; }
+            // models owning their buffers hand them to the defragmenter on their first bind, when the
+            // uploads are known to be done; nullptr keeps them in place
+            static void setDefragmenter(Defragmenter* manager) { defragmenter = manager; }
+
+            // moves the geometry to host memory and frees the gpu side; the gpu must be done with the
+            // model (the residency manager only evicts models idle for more frames than are in flight).
+            // With readback (created with graphicsQueue) the read back joins that batch, the model stays
+            // resident until completeEviction() after the batch completed, or cancelEviction()
+            void evict(UploadBatch* readback = nullptr);
+            void completeEviction();
+            // keeps the gpu side, e.g. the model was drawn again while its read back ran
+            void cancelEviction();
+            // uploads the evicted geometry again; with upload the copies join that batch and the model
+            // is resident after completeRestore(), once the batch completed
+            void restore(UploadBatch* upload = nullptr);
+            void completeRestore();
+            bool isResident() const { return resident; }
+            bool isEvicting() const { return evicting; }
+            bool isRestoring() const { return restoring; }
+            // vertex and index bytes, on the gpu while resident and on the host while evicted
+            VkDeviceSize getGeometryBytes() const;
+            VkDeviceSize getVertexBytes() const { return static_cast<VkDeviceSize>(vertexSize) * vertexCount; }
+            VkDeviceSize getIndexBytes() const {
+                return hasIndexBuffer ? static_cast<VkDeviceSize>(indexSize) * indexCount : 0;
+            }
+
+            static const IndexStats& getIndexStats() { return indexStats; }
+            static const UploadStats& getUploadStats() { return uploadStats; }
+            static void resetDrawStats();
 
+            // pooled models bind the shared buffers, drawing another model of the same pool and
+            // index type needs no new bind
             void bind(VkCommandBuffer commandBuffer);
+            // draws the full resolution mesh
             void draw(VkCommandBuffer commandBuffer);
+            // models without indices draw all their vertices with vkCmdDraw, whatever lod is
+            void drawLod(VkCommandBuffer commandBuffer, uint32_t lod);
+            // draws part of the index buffer, e.g. one or more adjacent meshlets
+            void drawRange(VkCommandBuffer commandBuffer, uint32_t firstIndex, uint32_t count);
+
+            VertexLayout getVertexLayout() const { return vertexLayout; }
+            VkIndexType getIndexType() const { return indexType; }
+            // nullptr when the model owns its buffers
+            GeometryPool* getGeometryPool() const { return pool; }
+            // maps quantized positions back to model space, identity for the other layouts
+            const glm::mat4& getDequantizeMatrix() const { return dequantizeMatrix; }
+            const std::vector<Meshlet>& getMeshlets() const { return meshlets; }
+            // never empty for indexed models, a model without a chain has the single level lods[0]
+            const std::vector<Lod>& getLods() const { return lods; }
+            // bounding sphere of the vertices in model space
+            const glm::vec3& getBoundsCenter() const { return boundsCenter; }
+            float getBoundsRadius() const { return boundsRadius; }
 
         private:
-            void createVertexBuffers(const std::vector<Vertex>& vertices);
-            void createIndexBuffers(const std::vector<uint32_t>& indices);
+            void create(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+                VertexLayout layout, const Lod* lods, uint32_t lodCount, UploadBatch* upload);
+            void createVertexBuffers(const Vertex* vertices, uint32_t vertexCount, VertexLayout layout);
+            void createVertexBuffers(const void* vertexData, uint32_t vertexSize, uint32_t vertexCount);
+            void createIndexBuffers(const uint32_t* indices, uint32_t indexCount);
+            // the part of createIndexBuffers after the index type was chosen, restore() starts here
+            void uploadIndices(const void* indexData);
+            // writes host visible destinations in place, otherwise stages data and records the copy into upload
+            void copyToDevice(const void* data, Buffer& destination, VkDeviceSize offset, VkDeviceSize size);
+            // the way back: host visible sources are read into data in place (nullptr), otherwise the copy
+            // into the returned buffer is recorded into readback
+            std::unique_ptr<Buffer> copyFromDevice(Buffer& source, VkDeviceSize offset, VkDeviceSize size,
+                void* data, UploadBatch& readback);
+            // offsets of the model's ranges in the bound buffers, 0 unless pooled
+            int32_t baseVertex() const;
+            uint32_t baseIndex() const;
 
             Device& device;
+            // only set while create() runs
+            UploadBatch* upload = nullptr;
             
+            // set when created while a geometry pool was set, the allocations replace the buffers
+            GeometryPool* pool = nullptr;
+            GeometryPool::Allocation* vertexAllocation = nullptr;
+            GeometryPool::Allocation* indexAllocation = nullptr;
+
             std::unique_ptr<Buffer> vertexBuffer;
             uint32_t vertexCount;
+            uint32_t vertexSize = sizeof(Vertex);
+            VertexLayout vertexLayout = VertexLayout::Standard;
+            glm::mat4 dequantizeMatrix{1.f};
+            glm::vec3 boundsCenter{};
+            float boundsRadius = 0.f;
 
             bool hasIndexBuffer = false;
             
             std::unique_ptr<Buffer> indexBuffer;
             uint32_t indexCount;
+            // uint16 whenever every vertex is addressable with 16 bits
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+            uint32_t indexSize = sizeof(uint32_t);
+
+            bool resident = true;
+            // a read back or an upload of the geometry is in flight
+            bool evicting = false;
+            bool restoring = false;
+            // the defragmenter tracking vertexBuffer and indexBuffer
+            Defragmenter* relocator = nullptr;
+            // the geometry while evicted, in the gpu format
+            std::vector<uint8_t> evictedVertices{};
+            std::vector<uint8_t> evictedIndices{};
+            // while evicting, nullptr for geometry read in place
+            std::unique_ptr<Buffer> vertexReadback;
+            std::unique_ptr<Buffer> indexReadback;
+
+            // culling data of the clusters and the ranges of the LOD chain in the index buffer, kept on the cpu
+            std::vector<Meshlet> meshlets{};
+            std::vector<Lod> lods{};
+
+            static IndexStats indexStats;
+            static UploadStats uploadStats;
+            static GeometryPool* geometryPool;
+            static Defragmenter* defragmenter;
     };
 }
\ No newline at end of file
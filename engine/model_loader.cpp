@@ -0,0 +1,154 @@
+#include "model_loader.hpp"
+#include "vertex_packing.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace engine {
+    namespace {
+        std::shared_ptr<Model> createPlaceholderCube(Device& device) {
+            // 8 shared corners, normals point away from the center so the cube is lit from every side
+            Model::Builder builder{};
+            for (int i = 0; i < 8; ++i) {
+                Model::Vertex vertex{};
+                vertex.position = {i & 1 ? .5f : -.5f, i & 2 ? .5f : -.5f, i & 4 ? .5f : -.5f};
+                vertex.color = {.5f, .5f, .5f};
+                vertex.normal = glm::normalize(vertex.position);
+                builder.vertices.push_back(vertex);
+            }
+            builder.indices = {
+                0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,
+                0, 1, 4, 1, 5, 4,  2, 6, 3, 3, 6, 7,
+                0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5};
+            return std::make_shared<Model>(device, builder);
+        }
+    }
+
+    ModelLoader::ModelLoader(Device& device, uint32_t threadCount) : device{device} {
+        placeholder = createPlaceholderCube(device);
+
+        if (threadCount == 0) threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (uint32_t i = 0; i < threadCount; ++i) workers.emplace_back(&ModelLoader::workerLoop, this);
+    }
+
+    ModelLoader::~ModelLoader() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+
+        for (Upload& upload : uploading) {
+            upload.batch->wait();
+            for (Job* job : upload.jobs) finishUpload(*job);
+        }
+    }
+
+    ModelLoader::Handle ModelLoader::load(
+        const std::string& filePath, GameObject::id_t objectId, bool withMeshlets, uint32_t lodCount) {
+        auto job = std::make_unique<Job>();
+        job->filePath = filePath;
+        job->objectId = objectId;
+        job->withMeshlets = withMeshlets;
+        job->lodCount = lodCount;
+
+        Handle handle = nextHandle++;
+        Job* queuedJob = job.get();
+        jobs.emplace(handle, std::move(job));
+        ++pendingJobs;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            queued.push_back(queuedJob);
+        }
+        wake.notify_one();
+        return handle;
+    }
+
+    void ModelLoader::workerLoop() {
+        while (true) {
+            Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+                if (stopping) return;
+                job = queued.front();
+                queued.pop_front();
+            }
+
+            try {
+                job->builder.loadCachedModel(job->filePath, job->withMeshlets, job->lodCount);
+            } catch (const std::exception& e) {
+                job->error = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock{mutex};
+            parsed.push_back(job);
+        }
+    }
+
+    uint32_t ModelLoader::update(GameObject::Map& gameObjects) {
+        std::vector<Job*> ready{};
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            ready.swap(parsed);
+        }
+        auto failed = std::remove_if(ready.begin(), ready.end(), [&](Job* job) {
+            if (job->error.empty()) return false;
+            std::cerr << "failed to load " << job->filePath << ": " << job->error << std::endl;
+            job->state = State::Failed;
+            --pendingJobs;
+            return true;
+        });
+        ready.erase(failed, ready.end());
+        if (!ready.empty()) submitUploads(ready);
+
+        // batches complete in submission order, but checking each one keeps this independent of it
+        uint32_t resident = 0;
+        auto done = std::remove_if(uploading.begin(), uploading.end(), [&](Upload& upload) {
+            if (!upload.batch->isComplete()) return false;
+            for (Job* job : upload.jobs) {
+                finishUpload(*job);
+                auto obj = gameObjects.find(job->objectId);
+                if (obj != gameObjects.end()) obj->second.model = job->model;
+                ++resident;
+            }
+            return true;
+        });
+        uploading.erase(done, uploading.end());
+        return resident;
+    }
+
+    void ModelLoader::submitUploads(const std::vector<Job*>& ready) {
+        // every model parsed since the last update shares one command buffer, one submit and one fence
+        Upload upload{std::make_unique<UploadBatch>(device), ready};
+        for (Job* job : ready) {
+            job->state = State::Uploading;
+            job->model = std::make_shared<Model>(device, job->builder,
+                VertexPacking::chooseLayout(job->builder.vertices.data(), static_cast<uint32_t>(job->builder.vertices.size())),
+                *upload.batch);
+            job->builder = Model::Builder{};
+        }
+        upload.batch->submit();
+        ++batchCount;
+        uploading.push_back(std::move(upload));
+    }
+
+    void ModelLoader::finishUpload(Job& job) {
+        job.state = State::Resident;
+        --pendingJobs;
+    }
+
+    ModelLoader::State ModelLoader::getState(Handle handle) const {
+        auto it = jobs.find(handle);
+        if (it == jobs.end()) throw std::runtime_error("Unknown model load handle");
+        return it->second->state;
+    }
+
+    std::shared_ptr<Model> ModelLoader::getModel(Handle handle) const {
+        auto it = jobs.find(handle);
+        if (it == jobs.end() || it->second->state != State::Resident) return nullptr;
+        return it->second->model;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+#include "game_object.hpp"
+#include "model.hpp"
+#include "upload_batch.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Asynchronous Model loading
+
+    load() returns a handle right away. A worker thread runs the cpu side of
+    Model::createModelFromFile (mesh cache or .obj parse, optimize, LODs, meshlets),
+    then update(), called by the render loop once per frame, records the buffer
+    copies of every model parsed since the last call into one UploadBatch and
+    submits it instead of waiting on the queue. Once a later update() sees the
+    batch complete, its models replace the placeholders of their GameObjects.
+
+    Main thread                 | workers          | gpu
+    ----------------------------|------------------|------------------
+    load() -> handle            |                  |
+                                | parse / optimize |
+    update(): record + submit   |                  |
+    update(): fence not ready   |                  | copy
+    update(): fence signaled,   |                  |
+    swap model into GameObject  |                  |
+
+    All Vulkan calls happen on the main thread (update() and the destructor), so the
+    command pool and the queue need no extra synchronization.
+*/
+
+namespace engine {
+    class ModelLoader {
+        public:
+            using Handle = uint32_t;
+            enum class State { Parsing, Uploading, Resident, Failed };
+
+            // threadCount 0 picks one worker less than the hardware threads
+            ModelLoader(Device& device, uint32_t threadCount = 0);
+            // waits for the workers and for uploads still in flight
+            ~ModelLoader();
+
+            ModelLoader(const ModelLoader&) = delete;
+            ModelLoader& operator=(const ModelLoader&) = delete;
+
+            // objectId's model is replaced by the loaded one as soon as it is resident
+            Handle load(const std::string& filePath, GameObject::id_t objectId,
+                bool withMeshlets = false, uint32_t lodCount = Model::DEFAULT_LOD_COUNT);
+            // call once per frame, returns how many models became resident
+            uint32_t update(GameObject::Map& gameObjects);
+
+            State getState(Handle handle) const;
+            // nullptr until the model is resident
+            std::shared_ptr<Model> getModel(Handle handle) const;
+            // no load is parsing or uploading
+            bool isIdle() const { return pendingJobs == 0; }
+            // queue submissions (and fence waits) the uploads took so far, one per update() with parsed models
+            uint32_t getBatchCount() const { return batchCount; }
+
+            // drawn until the real model is resident: a grey unit cube
+            const std::shared_ptr<Model>& getPlaceholder() const { return placeholder; }
+
+        private:
+            struct Job {
+                std::string filePath;
+                GameObject::id_t objectId;
+                bool withMeshlets;
+                uint32_t lodCount;
+                std::atomic<State> state{State::Parsing};
+
+                // written by the worker, read by update() once the job is handed back
+                Model::Builder builder{};
+                std::string error{};
+
+                std::shared_ptr<Model> model{};
+            };
+
+            // the jobs whose copies one batch carries
+            struct Upload {
+                std::unique_ptr<UploadBatch> batch;
+                std::vector<Job*> jobs{};
+            };
+
+            void workerLoop();
+            void submitUploads(const std::vector<Job*>& ready);
+            void finishUpload(Job& job);
+
+            Device& device;
+            std::shared_ptr<Model> placeholder;
+
+            std::unordered_map<Handle, std::unique_ptr<Job>> jobs{};
+            Handle nextHandle = 0;
+            uint32_t pendingJobs = 0;
+            uint32_t batchCount = 0;
+            // main thread only: batches in flight
+            std::vector<Upload> uploading{};
+
+            // jobs waiting for a worker, and jobs the workers finished parsing
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::deque<Job*> queued{};
+            std::vector<Job*> parsed{};
+            bool stopping = false;
+            std::vector<std::thread> workers{};
+    };
+}
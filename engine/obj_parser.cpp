@@ -0,0 +1,373 @@
+#include "obj_parser.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace engine {
+    namespace {
+        // don't bother splitting files into chunks smaller than this
+        constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+        bool isSpace(char c) { return c == ' ' || c == '\t'; }
+        bool isNewLine(char c) { return c == '\r' || c == '\n' || c == '\0'; }
+        bool isDigit(char c) { return static_cast<unsigned int>(c - '0') < 10u; }
+
+        // port of tinyobjloader's tryParseDouble, so both loaders round every value the same way
+        bool tryParseDouble(const char* s, const char* end, double* result) {
+            if (s >= end) return false;
+
+            double mantissa = 0.0;
+            int exponent = 0;
+            char sign = '+';
+            char expSign = '+';
+            const char* curr = s;
+            int read = 0;
+            bool leadingDecimalDot = false;
+
+            if (*curr == '+' || *curr == '-') {
+                sign = *curr;
+                curr++;
+                if (curr != end && *curr == '.') leadingDecimalDot = true;
+            } else if (*curr == '.') {
+                leadingDecimalDot = true;
+            } else if (!isDigit(*curr)) {
+                return false;
+            }
+
+            // integer part
+            if (!leadingDecimalDot) {
+                while (curr != end && isDigit(*curr)) {
+                    mantissa *= 10;
+                    mantissa += static_cast<int>(*curr - '0');
+                    curr++;
+                    read++;
+                }
+                if (read == 0) return false;
+            }
+
+            // decimal part
+            if (curr != end && *curr == '.') {
+                static const double powLut[] = {1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001};
+                const int lutEntries = sizeof powLut / sizeof powLut[0];
+                curr++;
+                read = 1;
+                while (curr != end && isDigit(*curr)) {
+                    mantissa += static_cast<int>(*curr - '0') *
+                        (read < lutEntries ? powLut[read] : std::pow(10.0, -read));
+                    read++;
+                    curr++;
+                }
+            }
+
+            // exponent part
+            if (curr != end && (*curr == 'e' || *curr == 'E')) {
+                curr++;
+                if (curr != end && (*curr == '+' || *curr == '-')) {
+                    expSign = *curr;
+                    curr++;
+                } else if (!isDigit(*curr)) {
+                    return false;
+                }
+
+                read = 0;
+                while (curr != end && isDigit(*curr)) {
+                    if (exponent > (2147483647 / 10)) return false;
+                    exponent *= 10;
+                    exponent += static_cast<int>(*curr - '0');
+                    curr++;
+                    read++;
+                }
+                exponent *= (expSign == '+' ? 1 : -1);
+                if (read == 0) return false;
+            }
+
+            *result = (sign == '+' ? 1 : -1) *
+                (exponent ? std::ldexp(mantissa * std::pow(5.0, exponent), exponent) : mantissa);
+            return true;
+        }
+
+        bool parseReal(const char** token, float* out) {
+            (*token) += strspn(*token, " \t");
+            const char* end = (*token) + strcspn(*token, " \t\r");
+            double value;
+            bool ok = tryParseDouble(*token, end, &value);
+            if (ok) *out = static_cast<float>(value);
+            *token = end;
+            return ok;
+        }
+
+        float parseReal(const char** token) {
+            float value = 0.0f;
+            parseReal(token, &value);
+            return value;
+        }
+
+        // one face corner as written in the file, relative indices are resolved during the merge
+        struct RawIndex {
+            int value[3] = {-1, -1, -1}; // vertex, normal, texcoord
+            uint8_t relativeMask = 0;
+        };
+
+        struct Chunk {
+            const char* begin = nullptr;
+            char* end = nullptr;
+
+            std::vector<float> vertices;
+            std::vector<float> colors;
+            std::vector<float> normals;
+            std::vector<float> texcoords;
+            std::vector<RawIndex> corners;
+            std::vector<uint32_t> faceSizes;
+            bool hasPolygons = false;
+
+            // vertex / normal / texcoord counts of all previous chunks
+            int base[3] = {0, 0, 0};
+            std::vector<ObjData::Index> triangles;
+        };
+
+        // mirrors tinyobj's fixIndex / parseTriple: i, i/j/k, i//k, i/j
+        bool parseIndex(const char** token, int localCount, int component, RawIndex& raw) {
+            int idx = atoi(*token);
+            if (idx == 0) return false;
+            if (idx > 0) {
+                raw.value[component] = idx - 1;
+            } else {
+                raw.value[component] = localCount + idx;
+                raw.relativeMask |= 1 << component;
+            }
+            (*token) += strcspn(*token, "/ \t\r");
+            return true;
+        }
+
+        bool parseTriple(const char** token, const Chunk& chunk, RawIndex& raw) {
+            const int vertexCount = static_cast<int>(chunk.vertices.size() / 3);
+            const int normalCount = static_cast<int>(chunk.normals.size() / 3);
+            const int texcoordCount = static_cast<int>(chunk.texcoords.size() / 2);
+
+            if (!parseIndex(token, vertexCount, 0, raw)) return false;
+            if ((*token)[0] != '/') return true;
+            (*token)++;
+
+            // i//k
+            if ((*token)[0] == '/') {
+                (*token)++;
+                return parseIndex(token, normalCount, 1, raw);
+            }
+
+            // i/j/k or i/j
+            if (!parseIndex(token, texcoordCount, 2, raw)) return false;
+            if ((*token)[0] != '/') return true;
+            (*token)++;
+            return parseIndex(token, normalCount, 1, raw);
+        }
+
+        void parseLine(const char* token, Chunk& chunk) {
+            token += strspn(token, " \t");
+            if (token[0] == '\0' || token[0] == '#') return;
+
+            if (token[0] == 'v' && isSpace(token[1])) {
+                token += 2;
+                float x = parseReal(&token);
+                float y = parseReal(&token);
+                float z = parseReal(&token);
+                float r, g, b;
+                if (!(parseReal(&token, &r) && parseReal(&token, &g) && parseReal(&token, &b))) {
+                    r = g = b = 1.0f;
+                }
+                chunk.vertices.insert(chunk.vertices.end(), {x, y, z});
+                chunk.colors.insert(chunk.colors.end(), {r, g, b});
+                return;
+            }
+
+            if (token[0] == 'v' && token[1] == 'n' && isSpace(token[2])) {
+                token += 3;
+                float x = parseReal(&token);
+                float y = parseReal(&token);
+                float z = parseReal(&token);
+                chunk.normals.insert(chunk.normals.end(), {x, y, z});
+                return;
+            }
+
+            if (token[0] == 'v' && token[1] == 't' && isSpace(token[2])) {
+                token += 3;
+                float u = parseReal(&token);
+                float v = parseReal(&token);
+                chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+                return;
+            }
+
+            if (token[0] == 'f' && isSpace(token[1])) {
+                token += 2;
+                token += strspn(token, " \t");
+
+                uint32_t faceSize = 0;
+                while (!isNewLine(token[0])) {
+                    RawIndex raw{};
+                    if (!parseTriple(&token, chunk, raw)) {
+                        throw std::runtime_error("Failed parse `f' line (e.g. zero value for face index)");
+                    }
+                    chunk.corners.push_back(raw);
+                    faceSize++;
+                    token += strspn(token, " \t\r");
+                }
+                chunk.faceSizes.push_back(faceSize);
+                chunk.hasPolygons |= faceSize > 4;
+            }
+        }
+
+        void parseChunk(Chunk& chunk) {
+            char* line = const_cast<char*>(chunk.begin);
+            while (line < chunk.end) {
+                char* lineEnd = line;
+                while (lineEnd < chunk.end && *lineEnd != '\n' && *lineEnd != '\r') lineEnd++;
+                // terminate the line in place, every worker only touches its own chunk
+                *lineEnd = '\0';
+                parseLine(line, chunk);
+                line = lineEnd + 1;
+            }
+        }
+
+        void triangulateChunk(Chunk& chunk, const ObjData& out) {
+            const int counts[3] = {
+                static_cast<int>(out.vertices.size() / 3),
+                static_cast<int>(out.normals.size() / 3),
+                static_cast<int>(out.texcoords.size() / 2)};
+
+            auto resolve = [&](const RawIndex& raw) {
+                int value[3];
+                for (int component = 0; component < 3; ++component) {
+                    value[component] = raw.value[component];
+                    if (raw.relativeMask & (1 << component)) value[component] += chunk.base[component];
+                    if (value[component] >= counts[component] ||
+                        (value[component] < 0 && (component == 0 || raw.relativeMask & (1 << component)))) {
+                        throw std::runtime_error("Face with invalid index found");
+                    }
+                }
+                return ObjData::Index{value[0], value[1], value[2]};
+            };
+
+            const float* v = out.vertices.data();
+            size_t corner = 0;
+            for (uint32_t faceSize : chunk.faceSizes) {
+                const RawIndex* face = &chunk.corners[corner];
+                corner += faceSize;
+
+                // degenerate faces are dropped
+                if (faceSize < 3) continue;
+
+                if (faceSize == 3) {
+                    chunk.triangles.push_back(resolve(face[0]));
+                    chunk.triangles.push_back(resolve(face[1]));
+                    chunk.triangles.push_back(resolve(face[2]));
+                    continue;
+                }
+
+                // quad: split along the shorter diagonal, exactly like tinyobjloader
+                ObjData::Index i0 = resolve(face[0]);
+                ObjData::Index i1 = resolve(face[1]);
+                ObjData::Index i2 = resolve(face[2]);
+                ObjData::Index i3 = resolve(face[3]);
+
+                float e02x = v[3 * i2.vertex + 0] - v[3 * i0.vertex + 0];
+                float e02y = v[3 * i2.vertex + 1] - v[3 * i0.vertex + 1];
+                float e02z = v[3 * i2.vertex + 2] - v[3 * i0.vertex + 2];
+                float e13x = v[3 * i3.vertex + 0] - v[3 * i1.vertex + 0];
+                float e13y = v[3 * i3.vertex + 1] - v[3 * i1.vertex + 1];
+                float e13z = v[3 * i3.vertex + 2] - v[3 * i1.vertex + 2];
+                float sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+                float sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+                if (sqr02 < sqr13) {
+                    chunk.triangles.insert(chunk.triangles.end(), {i0, i1, i2, i0, i2, i3});
+                } else {
+                    chunk.triangles.insert(chunk.triangles.end(), {i0, i1, i3, i1, i2, i3});
+                }
+            }
+        }
+
+        // run task(i) for every chunk on its own thread and rethrow the first worker exception
+        template <typename Task>
+        void runParallel(std::vector<Chunk>& chunks, Task task) {
+            std::vector<std::exception_ptr> errors(chunks.size());
+            std::vector<std::thread> workers;
+            workers.reserve(chunks.size());
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                workers.emplace_back([&, i]() {
+                    try {
+                        task(chunks[i]);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                });
+            }
+            for (auto& worker : workers) worker.join();
+            for (auto& error : errors) {
+                if (error) std::rethrow_exception(error);
+            }
+        }
+
+        template <typename T>
+        void append(std::vector<T>& dst, const std::vector<T>& src) {
+            dst.insert(dst.end(), src.begin(), src.end());
+        }
+    }
+
+    bool ObjParser::parse(const std::string& filePath, ObjData& out, unsigned int threadCount) {
+        std::ifstream file{filePath, std::ios::ate | std::ios::binary};
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + filePath);
+        }
+
+        size_t fileSize = static_cast<size_t>(file.tellg());
+        // one extra byte so the last line can always be terminated in place
+        std::vector<char> text(fileSize + 1, '\0');
+        file.seekg(0);
+        file.read(text.data(), fileSize);
+        file.close();
+
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+        size_t chunkCount = std::min<size_t>(threadCount, fileSize / MIN_CHUNK_SIZE + 1);
+
+        // split at line boundaries
+        std::vector<Chunk> chunks(chunkCount);
+        char* begin = text.data();
+        char* end = text.data() + fileSize;
+        for (size_t i = 0; i < chunkCount; ++i) {
+            // the '\n' at the end of the previous chunk belongs to that chunk
+            char* chunkBegin = i == 0 ? begin : std::min(chunks[i - 1].end + 1, end);
+            char* chunkEnd = i + 1 == chunkCount ? end : std::max(chunkBegin, begin + fileSize * (i + 1) / chunkCount);
+            while (chunkEnd < end && *chunkEnd != '\n') chunkEnd++;
+            chunks[i].begin = chunkBegin;
+            chunks[i].end = chunkEnd;
+        }
+
+        runParallel(chunks, parseChunk);
+
+        out = ObjData{};
+        for (auto& chunk : chunks) {
+            if (chunk.hasPolygons) return false;
+
+            chunk.base[0] = static_cast<int>(out.vertices.size() / 3);
+            chunk.base[1] = static_cast<int>(out.normals.size() / 3);
+            chunk.base[2] = static_cast<int>(out.texcoords.size() / 2);
+            append(out.vertices, chunk.vertices);
+            append(out.colors, chunk.colors);
+            append(out.normals, chunk.normals);
+            append(out.texcoords, chunk.texcoords);
+        }
+
+        runParallel(chunks, [&out](Chunk& chunk) { triangulateChunk(chunk, out); });
+
+        for (const auto& chunk : chunks) {
+            append(out.indices, chunk.triangles);
+        }
+        return true;
+    }
+}
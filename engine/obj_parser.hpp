@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*
+    Multi-threaded .obj reader used by Model::Builder::loadModel
+
+    The file is read into memory, split into line-aligned chunks and every
+    chunk is parsed on its own worker thread (v / vn / vt / f records, other
+    records are skipped). The per-chunk results are then merged in file order,
+    so the output is identical to what tinyobjloader produces:
+    - relative (negative) indices are resolved against the records before them
+    - quads are split along their shorter diagonal
+    - vertices without a color get white
+
+    Faces with more than 4 corners are triangulated by tinyobjloader's ear
+    clipper, which isn't reproduced here: parse() returns false for such
+    files and the caller should fall back to tinyobjloader.
+*/
+
+namespace engine {
+    struct ObjData {
+        struct Index {
+            int vertex = -1;
+            int normal = -1;
+            int texcoord = -1;
+        };
+
+        // same layout as tinyobj::attrib_t
+        std::vector<float> vertices;   // xyz
+        std::vector<float> colors;     // rgb, one per vertex
+        std::vector<float> normals;    // xyz
+        std::vector<float> texcoords;  // uv
+        // triangle list, 3 corners per face
+        std::vector<Index> indices;
+    };
+
+    class ObjParser {
+        public:
+            // threadCount = 0 uses std::thread::hardware_concurrency()
+            static bool parse(const std::string& filePath, ObjData& out, unsigned int threadCount = 0);
+    };
+}
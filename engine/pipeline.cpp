@@ -1,7 +1,11 @@
 #include "pipeline.hpp"
 #include "model.hpp"
+#include "deletion_queue.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_manager.hpp"
 
 #include <cassert>
+#include <chrono>
 #include <stdexcept>
 
 namespace engine
@@ -11,13 +15,18 @@ namespace engine
         const std::string& vertFile,
         const std::string& fragFile,
         const PipelineConfigInfo& configInfo) : device(device) {
-            createGraphicsPipeline(vertFile, fragFile, configInfo);
+            createGraphicsPipeline(readFile(vertFile), readFile(fragFile), configInfo);
+            compiled = true;
         }
+
+    Pipeline::Pipeline(Device& device, std::shared_future<void> compiling)
+        : device(device), compiling(std::move(compiling)) {}
     
     Pipeline::~Pipeline(){
         vkDestroyShaderModule(device.device(), vertShaderModule, nullptr);
         vkDestroyShaderModule(device.device(), fragShaderModule, nullptr);
-        vkDestroyPipeline(device.device(), graphicsPipeline, nullptr);
+        // the modules are only needed to create the pipeline, frames in flight may still bind the pipeline
+        device.deletionQueue().destroyPipeline(graphicsPipeline);
     }
 
     std::vector<char> Pipeline::readFile(const std::string& filename){
@@ -38,8 +47,8 @@ namespace engine
         return buffer;
     }
 
-    void Pipeline::createGraphicsPipeline(const std::string& vertFile, 
-        const std::string& fragFile, const PipelineConfigInfo& configInfo){
+    void Pipeline::createGraphicsPipeline(const std::vector<char>& vertCode,
+        const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo){
         
         // pipeline layout and render pass are essential for creating a pipeline
         assert(
@@ -49,12 +58,17 @@ namespace engine
             configInfo.renderPass != nullptr &&
             "Cannot create graphics pipeline: no renderPass provided in config info");
 
-        auto vertCode = readFile(vertFile);
-        auto fragCode = readFile(fragFile);
-
         createShaderModule(vertCode, &vertShaderModule);
         createShaderModule(fragCode, &fragShaderModule);
 
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(configInfo.specializationEntries.size());
+        specializationInfo.pMapEntries = configInfo.specializationEntries.data();
+        specializationInfo.dataSize = configInfo.specializationData.size();
+        specializationInfo.pData = configInfo.specializationData.data();
+        const VkSpecializationInfo* specialization =
+            configInfo.specializationEntries.empty() ? nullptr : &specializationInfo;
+
         // set the vert and frag shader into the pipeline, then delete them
         VkPipelineShaderStageCreateInfo shaderStages[2];
         shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -63,14 +77,14 @@ namespace engine
         shaderStages[0].pName = "main";
         shaderStages[0].flags = 0;
         shaderStages[0].pNext = nullptr;
-        shaderStages[0].pSpecializationInfo = nullptr;
+        shaderStages[0].pSpecializationInfo = specialization;
         shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         shaderStages[1].module = fragShaderModule;
         shaderStages[1].pName = "main";
         shaderStages[1].flags = 0;
         shaderStages[1].pNext = nullptr;
-        shaderStages[1].pSpecializationInfo = nullptr;
+        shaderStages[1].pSpecializationInfo = specialization;
 
         // set binding and attribute descriptions in configInfo
         auto &bindingDescriptions = configInfo.bindingDescriptions;
@@ -104,15 +118,19 @@ namespace engine
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;  // Optional
         pipelineInfo.basePipelineIndex = -1;               // Optional
 
+        // the shared cache skips the compilation of pipelines built before, in this or an earlier launch
+        auto start = std::chrono::high_resolution_clock::now();
         if (vkCreateGraphicsPipelines(
                 device.device(),
-                VK_NULL_HANDLE,
+                device.pipelineCache().handle(),
                 1,
                 &pipelineInfo, // pCreateInfos
                 nullptr,
                 &graphicsPipeline) != VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
+        device.pipelineCache().recordCreation(std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count());
 
         vkDestroyShaderModule(device.device(), fragShaderModule, nullptr);
         vkDestroyShaderModule(device.device(), vertShaderModule, nullptr);
@@ -206,9 +224,18 @@ namespace engine
     }
 
     void Pipeline::bind(VkCommandBuffer commandBuffer){
+        if (!compiled) waitCompiled();
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
     }   
 
+    void Pipeline::waitCompiled() {
+        // not warmed up (PipelineManager::waitIdle), this frame stalls until the worker is done
+        auto start = std::chrono::high_resolution_clock::now();
+        compiling.get();
+        device.pipelineManager().recordLateBind(std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count());
+    }
+
     void Pipeline::enableAlphaBlending(PipelineConfigInfo& configInfo) {
         // color.rgb = (src.a * src.rgb) + ((1 - src.a) * dst.rgb)
         configInfo.colorBlendAttachment.blendEnable = VK_TRUE;
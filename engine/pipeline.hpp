@@ -7,9 +7,12 @@
     Create pipeline
  */
 
+#include <atomic>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <future>
 #include <iostream>
 
 #include "device.hpp"
@@ -42,10 +45,14 @@ namespace engine
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+        // specialization constants, handed to both stages (a stage ignores ids it doesn't declare)
+        std::vector<VkSpecializationMapEntry> specializationEntries{};
+        std::vector<uint8_t> specializationData{};
     };
 
     class Pipeline{
         public:
+            // compiles right away; PipelineManager::get() shares and compiles on worker threads instead
             Pipeline(
                 Device& device, 
                 const std::string& vertFile, 
@@ -57,22 +64,44 @@ namespace engine
             Pipeline(const Pipeline&) = delete;
             Pipeline& operator=(const Pipeline&) = delete;
 
+            // waits for a pipeline still compiling on a PipelineManager worker
             void bind(VkCommandBuffer commandBuffer);
+            bool isReady() const { return compiled; }
 
+            // sets layout(constant_id = constantId) to value; int32_t, uint32_t, float or VkBool32 for bool
+            template <typename T>
+            static void addSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, T value) {
+                VkSpecializationMapEntry entry{};
+                entry.constantID = constantId;
+                entry.offset = static_cast<uint32_t>(configInfo.specializationData.size());
+                entry.size = sizeof(T);
+                configInfo.specializationEntries.push_back(entry);
+                configInfo.specializationData.resize(entry.offset + sizeof(T));
+                std::memcpy(configInfo.specializationData.data() + entry.offset, &value, sizeof(T));
+            }
             static void defaultPipelineConfigInfo(
                 PipelineConfigInfo& configinfo);
             static void enableAlphaBlending(PipelineConfigInfo& configInfo);
 
         private:
+            friend class PipelineManager;
+            // created by PipelineManager, compiled later by one of its workers
+            Pipeline(Device& device, std::shared_future<void> compiling);
+
             static std::vector<char> readFile (const std::string& filename);
-            // create a graphics pipeline with the pipelineConfigInfo, vertex shader and fragment shader
-            void createGraphicsPipeline(const std::string& vertFile, 
-                    const std::string& fragFile, const PipelineConfigInfo& configInfo);
+            // create a graphics pipeline with the pipelineConfigInfo, vertex shader and fragment shader,
+            // safe on any thread
+            void createGraphicsPipeline(const std::vector<char>& vertCode,
+                    const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo);
             void createShaderModule(const std::vector<char>& code, VkShaderModule* VkShaderModule);
+            void waitCompiled();
 
             Device& device;
-            VkPipeline graphicsPipeline;
-            VkShaderModule vertShaderModule;
-            VkShaderModule fragShaderModule;
+            VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+            VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+            VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+            // set once graphicsPipeline exists, compiling is ready (or holds the error) from then on
+            std::atomic<bool> compiled{false};
+            std::shared_future<void> compiling{};
     };
 } 
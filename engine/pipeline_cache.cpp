@@ -0,0 +1,115 @@
+#include "pipeline_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace engine {
+    namespace {
+        uint64_t fnv1a(const uint8_t* data, size_t size) {
+            uint64_t hash = 0xCBF29CE484222325ull;
+            for (size_t i = 0; i < size; ++i) {
+                hash ^= data[i];
+                hash *= 0x100000001B3ull;
+            }
+            return hash;
+        }
+    }
+
+    PipelineCache::PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties,
+        const std::string& filePath) : device{device}, properties{properties}, filePath{filePath} {
+        std::vector<uint8_t> data = load();
+
+        VkPipelineCacheCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize = data.size();
+        createInfo.pInitialData = data.empty() ? nullptr : data.data();
+        if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline cache");
+        }
+        stats.loadedFromDisk = !data.empty();
+        stats.loadedBytes = data.size();
+    }
+
+    PipelineCache::~PipelineCache() {
+        save();
+        vkDestroyPipelineCache(device, cache, nullptr);
+    }
+
+    std::vector<uint8_t> PipelineCache::load() const {
+        std::ifstream file{filePath, std::ios::ate | std::ios::binary};
+        if (!file.is_open()) return {};
+        size_t fileSize = static_cast<size_t>(file.tellg());
+        if (fileSize < sizeof(FileHeader)) return {};
+        file.seekg(0);
+
+        FileHeader header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+        if (header.magic != MAGIC || header.version != VERSION || header.dataSize != fileSize - sizeof(FileHeader) ||
+            header.dataSize < sizeof(VkPipelineCacheHeaderVersionOne)) {
+            return {};
+        }
+        std::vector<uint8_t> data(static_cast<size_t>(header.dataSize));
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        if (!file.good() || fnv1a(data.data(), data.size()) != header.checksum) return {};
+
+        // data of another driver, device or driver version is at best ignored by the driver
+        VkPipelineCacheHeaderVersionOne driverHeader{};
+        std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+        bool valid = driverHeader.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+            driverHeader.headerSize <= data.size() &&
+            driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            driverHeader.vendorID == properties.vendorID &&
+            driverHeader.deviceID == properties.deviceID &&
+            std::memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        if (!valid) return {};
+        return data;
+    }
+
+    bool PipelineCache::save() {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) return false;
+        std::vector<uint8_t> data(size);
+        if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) return false;
+        data.resize(size);
+
+        FileHeader header{};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.dataSize = data.size();
+        header.checksum = fnv1a(data.data(), data.size());
+
+        // write to a temporary file first so a crash never leaves a truncated cache behind
+        std::string tmpPath = filePath + ".tmp";
+        {
+            std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+            if (!file.is_open()) {
+                std::cerr << "failed to write pipeline cache: " << filePath << std::endl;
+                return false;
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+            if (!file.good()) {
+                file.close();
+                std::remove(tmpPath.c_str());
+                std::cerr << "failed to write pipeline cache: " << filePath << std::endl;
+                return false;
+            }
+        }
+
+        if (std::rename(tmpPath.c_str(), filePath.c_str()) != 0) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        stats.savedBytes = data.size();
+        return true;
+    }
+
+    void PipelineCache::recordCreation(double milliseconds) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        ++stats.pipelines;
+        stats.creationMs += milliseconds;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+    The device's VkPipelineCache, kept on disk between launches
+
+    Without a cache every pipeline is compiled from SPIR-V again on each launch. The
+    driver's cache data is loaded at startup, handed to every vkCreateGraphicsPipelines
+    and written back when the device is destroyed (save() writes it earlier).
+
+    File layout (native endian):
+    | FileHeader | vkGetPipelineCacheData blob (dataSize bytes) |
+
+    The blob starts with VkPipelineCacheHeaderVersionOne. It is discarded, and the cache
+    starts empty, when the file header's magic / version / size / checksum are off, or
+    when the blob's header version, vendor, device or pipelineCacheUUID differ from the
+    running driver's (a driver update changes the UUID). Writes go to a temporary file
+    renamed over the old one, so a crash never leaves a truncated cache behind.
+*/
+
+namespace engine {
+    class PipelineCache {
+        public:
+            static constexpr uint32_t MAGIC = 0x43504C5A; // "ZLPC"
+            static constexpr uint32_t VERSION = 1;
+            static constexpr const char* DEFAULT_PATH = "pipeline_cache.bin";
+
+            struct FileHeader {
+                uint32_t magic;
+                uint32_t version;
+                uint64_t dataSize;
+                // FNV-1a of the blob
+                uint64_t checksum;
+            };
+
+            // creation time of every pipeline since startup, to compare launches with and without a cache file
+            struct Stats {
+                // the cache started from the file, otherwise empty
+                bool loadedFromDisk = false;
+                size_t loadedBytes = 0;
+                size_t savedBytes = 0;
+                uint32_t pipelines = 0;
+                double creationMs = 0.0;
+            };
+
+            PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties,
+                const std::string& filePath = DEFAULT_PATH);
+            // saves, then destroys the cache
+            ~PipelineCache();
+
+            PipelineCache(const PipelineCache&) = delete;
+            PipelineCache& operator=(const PipelineCache&) = delete;
+
+            VkPipelineCache handle() const { return cache; }
+            // false (and the old file kept) when the data couldn't be written
+            bool save();
+            // Pipeline reports how long each vkCreateGraphicsPipelines took, from any thread
+            void recordCreation(double milliseconds);
+
+            const Stats& getStats() const { return stats; }
+
+        private:
+            // the blob of the file, empty when there is none or it doesn't fit this driver
+            std::vector<uint8_t> load() const;
+
+            VkDevice device;
+            VkPhysicalDeviceProperties properties;
+            std::string filePath;
+            VkPipelineCache cache = VK_NULL_HANDLE;
+            std::mutex statsMutex;
+            Stats stats{};
+    };
+}
@@ -0,0 +1,269 @@
+#include "pipeline_manager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
+
+namespace engine {
+    namespace {
+        // appends the fields of the create infos one by one, padding and pointers never reach the key
+        class KeyWriter {
+            public:
+                template <typename T>
+                void add(const T& value) {
+                    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "plain fields only");
+                    const char* bytes = reinterpret_cast<const char*>(&value);
+                    key.append(bytes, sizeof(T));
+                }
+                void addHandle(const void* handle) { add(reinterpret_cast<uintptr_t>(handle)); }
+                // FNV-1a and the size stand in for the SPIR-V itself
+                void addCode(const std::vector<char>& code) {
+                    uint64_t hash = 14695981039346656037ull;
+                    for (char byte : code) {
+                        hash ^= static_cast<uint8_t>(byte);
+                        hash *= 1099511628211ull;
+                    }
+                    add(hash);
+                    add(static_cast<uint64_t>(code.size()));
+                }
+                void addStencil(const VkStencilOpState& state) {
+                    add(state.failOp);
+                    add(state.passOp);
+                    add(state.depthFailOp);
+                    add(state.compareOp);
+                    add(state.compareMask);
+                    add(state.writeMask);
+                    add(state.reference);
+                }
+
+                std::string key;
+        };
+
+        double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<double, std::milli>(end - start).count();
+        }
+    }
+
+    PipelineManager::PipelineManager(Device& device, uint32_t threadCount) : device{device} {
+        if (threadCount == 0) threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (uint32_t i = 0; i < threadCount; ++i) workers.emplace_back(&PipelineManager::workerLoop, this);
+    }
+
+    PipelineManager::~PipelineManager() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    std::shared_ptr<Pipeline> PipelineManager::get(
+        const std::string& vertFile, const std::string& fragFile, const PipelineConfigInfo& configInfo) {
+        auto job = std::make_unique<Job>();
+        job->vertCode = Pipeline::readFile(vertFile);
+        job->fragCode = Pipeline::readFile(fragFile);
+        std::string key = makeKey(job->vertCode, job->fragCode, configInfo);
+
+        auto found = pipelines.find(key);
+        std::shared_ptr<Pipeline> alive = found != pipelines.end() ? found->second.lock() : nullptr;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            ++stats.requests;
+            if (alive) ++stats.shared;
+        }
+        if (alive) return alive;
+
+        job->configInfo = std::make_unique<PipelineConfigInfo>();
+        copyConfig(configInfo, *job->configInfo);
+        std::shared_future<void> done = job->done.get_future().share();
+        job->pipeline = std::shared_ptr<Pipeline>(new Pipeline(device, done));
+        std::shared_ptr<Pipeline> pipeline = job->pipeline;
+
+        pipelines[key] = pipeline;
+        pending.push_back(done);
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            queued.push_back(std::move(job));
+        }
+        wake.notify_one();
+        return pipeline;
+    }
+
+    void PipelineManager::waitIdle() {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::shared_future<void>> waiting{};
+        waiting.swap(pending);
+        for (auto& done : waiting) done.get();
+        std::lock_guard<std::mutex> lock{mutex};
+        stats.warmUpMs += millisecondsSince(start);
+
+        // drop the keys of pipelines nobody holds anymore
+        for (auto it = pipelines.begin(); it != pipelines.end();) {
+            it = it->second.expired() ? pipelines.erase(it) : std::next(it);
+        }
+    }
+
+    bool PipelineManager::isIdle() {
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [](const std::shared_future<void>& done) {
+            return done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }), pending.end());
+        return pending.empty();
+    }
+
+    void PipelineManager::recordLateBind(double milliseconds) {
+        std::lock_guard<std::mutex> lock{mutex};
+        ++stats.lateBinds;
+        stats.lateBindMs += milliseconds;
+    }
+
+    PipelineManager::Stats PipelineManager::getStats() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        return stats;
+    }
+
+    void PipelineManager::workerLoop() {
+        while (true) {
+            std::unique_ptr<Job> job{};
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+                if (stopping) return;
+                job = std::move(queued.front());
+                queued.pop_front();
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            try {
+                job->pipeline->createGraphicsPipeline(job->vertCode, job->fragCode, *job->configInfo);
+            } catch (...) {
+                job->done.set_exception(std::current_exception());
+                continue;
+            }
+            // counted before the promise is kept, so waitIdle() never returns ahead of the stats
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                ++stats.compiled;
+                stats.compileMs += millisecondsSince(start);
+            }
+            job->pipeline->compiled = true;
+            job->done.set_value();
+        }
+    }
+
+    std::string PipelineManager::makeKey(const std::vector<char>& vertCode,
+        const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo) {
+        KeyWriter writer{};
+        writer.addCode(vertCode);
+        writer.addCode(fragCode);
+
+        writer.add(static_cast<uint32_t>(configInfo.bindingDescriptions.size()));
+        for (const auto& binding : configInfo.bindingDescriptions) {
+            writer.add(binding.binding);
+            writer.add(binding.stride);
+            writer.add(binding.inputRate);
+        }
+        writer.add(static_cast<uint32_t>(configInfo.attributeDescriptions.size()));
+        for (const auto& attribute : configInfo.attributeDescriptions) {
+            writer.add(attribute.location);
+            writer.add(attribute.binding);
+            writer.add(attribute.format);
+            writer.add(attribute.offset);
+        }
+
+        // viewport and scissor are dynamic, only their counts are baked in
+        const auto& viewport = configInfo.viewportInfo;
+        writer.add(viewport.viewportCount);
+        writer.add(viewport.scissorCount);
+
+        const auto& inputAssembly = configInfo.inputAssemblyInfo;
+        writer.add(inputAssembly.topology);
+        writer.add(inputAssembly.primitiveRestartEnable);
+
+        const auto& rasterization = configInfo.rasterizationInfo;
+        writer.add(rasterization.depthClampEnable);
+        writer.add(rasterization.rasterizerDiscardEnable);
+        writer.add(rasterization.polygonMode);
+        writer.add(rasterization.cullMode);
+        writer.add(rasterization.frontFace);
+        writer.add(rasterization.depthBiasEnable);
+        writer.add(rasterization.depthBiasConstantFactor);
+        writer.add(rasterization.depthBiasClamp);
+        writer.add(rasterization.depthBiasSlopeFactor);
+        writer.add(rasterization.lineWidth);
+
+        const auto& multisample = configInfo.multisampleInfo;
+        writer.add(multisample.rasterizationSamples);
+        writer.add(multisample.sampleShadingEnable);
+        writer.add(multisample.minSampleShading);
+        writer.add(multisample.alphaToCoverageEnable);
+        writer.add(multisample.alphaToOneEnable);
+
+        const auto& blend = configInfo.colorBlendAttachment;
+        writer.add(blend.blendEnable);
+        writer.add(blend.srcColorBlendFactor);
+        writer.add(blend.dstColorBlendFactor);
+        writer.add(blend.colorBlendOp);
+        writer.add(blend.srcAlphaBlendFactor);
+        writer.add(blend.dstAlphaBlendFactor);
+        writer.add(blend.alphaBlendOp);
+        writer.add(blend.colorWriteMask);
+        const auto& colorBlend = configInfo.colorBlendInfo;
+        writer.add(colorBlend.logicOpEnable);
+        writer.add(colorBlend.logicOp);
+        writer.add(colorBlend.attachmentCount);
+        for (float constant : colorBlend.blendConstants) writer.add(constant);
+
+        const auto& depthStencil = configInfo.depthStencilInfo;
+        writer.add(depthStencil.depthTestEnable);
+        writer.add(depthStencil.depthWriteEnable);
+        writer.add(depthStencil.depthCompareOp);
+        writer.add(depthStencil.depthBoundsTestEnable);
+        writer.add(depthStencil.stencilTestEnable);
+        writer.addStencil(depthStencil.front);
+        writer.addStencil(depthStencil.back);
+        writer.add(depthStencil.minDepthBounds);
+        writer.add(depthStencil.maxDepthBounds);
+
+        writer.add(static_cast<uint32_t>(configInfo.dynamicStateEnables.size()));
+        for (VkDynamicState state : configInfo.dynamicStateEnables) writer.add(state);
+
+        writer.add(static_cast<uint32_t>(configInfo.specializationEntries.size()));
+        for (const auto& entry : configInfo.specializationEntries) {
+            writer.add(entry.constantID);
+            writer.add(entry.offset);
+            writer.add(static_cast<uint64_t>(entry.size));
+        }
+        writer.key.append(configInfo.specializationData.begin(), configInfo.specializationData.end());
+
+        writer.addHandle(configInfo.pipelineLayout);
+        writer.addHandle(configInfo.renderPass);
+        writer.add(configInfo.subpass);
+        return writer.key;
+    }
+
+    void PipelineManager::copyConfig(const PipelineConfigInfo& source, PipelineConfigInfo& target) {
+        target.bindingDescriptions = source.bindingDescriptions;
+        target.attributeDescriptions = source.attributeDescriptions;
+        target.viewportInfo = source.viewportInfo;
+        target.inputAssemblyInfo = source.inputAssemblyInfo;
+        target.rasterizationInfo = source.rasterizationInfo;
+        target.multisampleInfo = source.multisampleInfo;
+        target.colorBlendAttachment = source.colorBlendAttachment;
+        target.colorBlendInfo = source.colorBlendInfo;
+        target.depthStencilInfo = source.depthStencilInfo;
+        target.dynamicStateEnables = source.dynamicStateEnables;
+        target.dynamicStateInfo = source.dynamicStateInfo;
+        target.pipelineLayout = source.pipelineLayout;
+        target.renderPass = source.renderPass;
+        target.subpass = source.subpass;
+        target.specializationEntries = source.specializationEntries;
+        target.specializationData = source.specializationData;
+
+        // re-point the infos at the copy's own attachment and dynamic states
+        target.colorBlendInfo.pAttachments = &target.colorBlendAttachment;
+        target.dynamicStateInfo.pDynamicStates = target.dynamicStateEnables.data();
+        target.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(target.dynamicStateEnables.size());
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "pipeline.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Shared graphics pipelines, compiled on worker threads
+
+    get() serializes everything vkCreateGraphicsPipelines would see into a key: a hash
+    of both SPIR-V files, the vertex input, every fixed-function state, the dynamic
+    states, the specialization constants, the layout, the render pass and the subpass.
+    A key seen before returns the pipeline that is already alive, a new one returns
+    right away while a worker compiles it through the device's PipelineCache
+    (vkCreateGraphicsPipelines and the cache are safe to use from several threads at once).
+
+    Main thread                          | workers
+    -------------------------------------|-----------------------------
+    render systems: get() -> Pipeline    |
+    get() ...                            | compile, compile, ...
+    waitIdle()  (load time, once)        | compile
+    frames: bind()                       |
+
+    The render systems only request their pipelines, the app warms them all up with
+    one waitIdle() before the first frame, so they compile in parallel and no frame
+    waits for one. A pipeline bound before it is compiled stalls that frame, counted
+    in Stats::lateBinds.
+
+    The manager keeps weak references: a pipeline lives as long as a render system holds
+    it, a later get() with the same key compiles it again (from the PipelineCache).
+*/
+
+namespace engine {
+    class PipelineManager {
+        public:
+            struct Stats {
+                uint32_t requests = 0;
+                // requests served by a pipeline that was already alive
+                uint32_t shared = 0;
+                uint32_t compiled = 0;
+                // summed over the workers
+                double compileMs = 0.0;
+                // the main thread blocked in waitIdle()
+                double warmUpMs = 0.0;
+                uint32_t lateBinds = 0;
+                double lateBindMs = 0.0;
+            };
+
+            // threadCount 0 picks one worker less than the hardware threads
+            PipelineManager(Device& device, uint32_t threadCount = 0);
+            // pipelines still queued are dropped, binding one of them throws
+            ~PipelineManager();
+
+            PipelineManager(const PipelineManager&) = delete;
+            PipelineManager& operator=(const PipelineManager&) = delete;
+
+            // the pipeline for these shaders and configInfo, compiling until isReady()
+            std::shared_ptr<Pipeline> get(
+                const std::string& vertFile, const std::string& fragFile, const PipelineConfigInfo& configInfo);
+            // blocks until every requested pipeline is compiled, rethrows the first failure
+            void waitIdle();
+            bool isIdle();
+
+            // Pipeline::bind() waited for a worker
+            void recordLateBind(double milliseconds);
+            // a copy, the workers keep counting
+            Stats getStats() const;
+
+        private:
+            struct Job {
+                std::shared_ptr<Pipeline> pipeline;
+                std::vector<char> vertCode;
+                std::vector<char> fragCode;
+                // PipelineConfigInfo holds pointers into itself, so it stays where it was copied to
+                std::unique_ptr<PipelineConfigInfo> configInfo;
+                std::promise<void> done;
+            };
+
+            static std::string makeKey(const std::vector<char>& vertCode,
+                const std::vector<char>& fragCode, const PipelineConfigInfo& configInfo);
+            static void copyConfig(const PipelineConfigInfo& source, PipelineConfigInfo& target);
+            void workerLoop();
+
+            Device& device;
+            std::unordered_map<std::string, std::weak_ptr<Pipeline>> pipelines;
+            // of every compile still queued or running, waitIdle() goes through them
+            std::vector<std::shared_future<void>> pending;
+
+            // guards queued, stopping and stats
+            mutable std::mutex mutex;
+            std::condition_variable wake;
+            std::deque<std::unique_ptr<Job>> queued;
+            bool stopping = false;
+            std::vector<std::thread> workers;
+
+            Stats stats{};
+    };
+}
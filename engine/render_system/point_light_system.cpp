@@ -1,4 +1,6 @@
 #include "point_light_system.hpp"
+#include "deletion_queue.hpp"
+#include "pipeline_manager.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -23,7 +25,7 @@ namespace engine {
     }
 
     PointLightSystem::~PointLightSystem() {
-        vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+        device.deletionQueue().destroyPipelineLayout(pipelineLayout);
     }
 
     void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
@@ -64,8 +66,7 @@ namespace engine {
         pipelineConfig.bindingDescriptions.clear();
         pipelineConfig.renderPass = renderPass;
         pipelineConfig.pipelineLayout = pipelineLayout;
-        pipeline = std::make_unique<Pipeline>(
-            device, 
+        pipeline = device.pipelineManager().get(
             "shader/point_light.vert.spv", 
             "shader/point_light.frag.spv", 
             pipelineConfig);
@@ -138,8 +139,8 @@ namespace engine {
             0,
             1,
             &frameInfo.globalDescriptorSet,
-            0,
-            nullptr);
+            1,
+            &frameInfo.globalUboOffset);
 
         // for transparent objects, we need to render them from back to front
         for (auto it=sorted.rbegin(); it!=sorted.rend(); ++it) {
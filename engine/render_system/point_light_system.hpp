@@ -62,7 +62,8 @@ namespace engine {
 
             // device is initialized in app launcher
             Device& device;
-            std::unique_ptr<Pipeline> pipeline;
+            // shared through PipelineManager
+            std::shared_ptr<Pipeline> pipeline;
             VkPipelineLayout pipelineLayout;
 
     };
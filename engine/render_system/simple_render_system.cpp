@@ -1,4 +1,7 @@
 #include "simple_render_system.hpp"
+#include "meshlet_builder.hpp"
+#include "deletion_queue.hpp"
+#include "pipeline_manager.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -6,20 +9,48 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <string>
+
 namespace engine {
     struct SimplePushConstantData {
         glm::mat4 modelMatrix{1.f};
         glm::mat4 normalMatrix{1.f};
     };
 
-    SimpleRenderSystem::SimpleRenderSystem(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-        :device(device) {
+    namespace {
+        // largest axis scale of a model matrix, turns model space radii into world space ones
+        float maxScale(const glm::mat4& modelMatrix) {
+            return glm::max(glm::length(glm::vec3{modelMatrix[0]}),
+                glm::max(glm::length(glm::vec3{modelMatrix[1]}), glm::length(glm::vec3{modelMatrix[2]})));
+        }
+    }
+
+    SimpleRenderSystem::SimpleRenderSystem(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
+        UploadBatch* upload)
+        :device(device), renderPass(renderPass) {
+        textureSetLayout = DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build();
+        // sets of destroyed textures are freed one by one
+        texturePool = DescriptorPool::Builder(device)
+            .setMaxSets(MAX_TEXTURE_SETS)
+            .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_TEXTURE_SETS)
+            .build();
+        whiteTexture = Texture::createSolid(device, glm::vec4{1.f}, upload);
+        VkDescriptorImageInfo imageInfo = whiteTexture->descriptorInfo();
+        DescriptorWriter(*textureSetLayout, *texturePool)
+            .writeImage(0, &imageInfo)
+            .build(whiteTextureSet);
+
         createPipelineLayout(globalSetLayout);
-        createPipeline(renderPass);
+        setShadingVariant(ShadingVariant{});
     }
 
     SimpleRenderSystem::~SimpleRenderSystem() {
-        vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+        device.deletionQueue().destroyPipelineLayout(pipelineLayout);
     }
 
     void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
@@ -29,7 +60,7 @@ namespace engine {
         pushConstantRange.offset = 0;
         pushConstantRange.size = sizeof(SimplePushConstantData);
 
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {globalSetLayout};
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {globalSetLayout, textureSetLayout->getDescriptorSetLayout()};
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -44,29 +75,58 @@ namespace engine {
         }
     }
 
-    void SimpleRenderSystem::createPipeline(VkRenderPass renderPass){
+    size_t SimpleRenderSystem::findShadingVariant(const ShadingVariant& variant) {
+        for (size_t i = 0; i < variants.size(); ++i) {
+            if (variants[i].variant == variant) return i;
+        }
+        variants.push_back(VariantPipelines{variant, {}});
+        createPipelines(variant, variants.back().pipelines);
+        return variants.size() - 1;
+    }
+
+    void SimpleRenderSystem::createPipelines(const ShadingVariant& variant, std::shared_ptr<Pipeline> (&pipelines)[3]){
         assert(pipelineLayout != nullptr && "Pipeline layout is null");
-        // create the pipeline with:
+        // create the pipelines with:
         // the default pipelineconfiginfo
         // the default pipeline layout,
         // the render pass from the swap chain
-        // simple_shader.vert and simple_shader.frag
-        PipelineConfigInfo pipelineConfig{};
-        Pipeline::defaultPipelineConfigInfo(pipelineConfig);
-        pipelineConfig.renderPass = renderPass;
-        pipelineConfig.pipelineLayout = pipelineLayout;
-        pipeline = std::make_unique<Pipeline>(
-            device, 
-            "shader/simple_shader.vert.spv", 
-            "shader/simple_shader.frag.spv", 
-            pipelineConfig);
+        // simple_shader.vert (simple_shader_packed.vert for packed vertices) and simple_shader.frag specialized for variant
+        using Layout = Model::VertexLayout;
+        for (Layout layout : {Layout::Standard, Layout::Packed, Layout::PackedQuantized}) {
+            PipelineConfigInfo pipelineConfig{};
+            Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+            pipelineConfig.renderPass = renderPass;
+            pipelineConfig.pipelineLayout = pipelineLayout;
+            cullBackfacingMeshlets = (pipelineConfig.rasterizationInfo.cullMode & VK_CULL_MODE_BACK_BIT) != 0;
+            // constant_id 0..3 of simple_shader.frag
+            Pipeline::addSpecializationConstant(pipelineConfig, 0,
+                static_cast<int32_t>(std::min<uint32_t>(variant.maxLights, MAX_POINT_LIGHTS)));
+            Pipeline::addSpecializationConstant<VkBool32>(pipelineConfig, 1, variant.exactLightCount);
+            Pipeline::addSpecializationConstant<VkBool32>(pipelineConfig, 2, variant.specular);
+            Pipeline::addSpecializationConstant(pipelineConfig, 3, variant.shininess);
+
+            std::string vertFile = "shader/simple_shader.vert.spv";
+            if (layout == Layout::Packed) {
+                pipelineConfig.bindingDescriptions = Model::PackedVertex::getBindingDescriptions();
+                pipelineConfig.attributeDescriptions = Model::PackedVertex::getAttributeDescriptions();
+                vertFile = "shader/simple_shader_packed.vert.spv";
+            } else if (layout == Layout::PackedQuantized) {
+                pipelineConfig.bindingDescriptions = Model::QuantizedVertex::getBindingDescriptions();
+                pipelineConfig.attributeDescriptions = Model::QuantizedVertex::getAttributeDescriptions();
+                vertFile = "shader/simple_shader_packed.vert.spv";
+            }
+
+            // compiled on the manager's workers, the app waits for all of them before the first frame
+            pipelines[static_cast<int>(layout)] = device.pipelineManager().get(
+                vertFile,
+                "shader/simple_shader.frag.spv",
+                pipelineConfig);
+        }
     }
 
 
     void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo){
-        // bind the pipeline
-        pipeline->bind(frameInfo.commandBuffer);
-
+        // all pipelines share the layout, so the global set stays bound across pipeline switches
         vkCmdBindDescriptorSets(
             frameInfo.commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -74,17 +134,47 @@ namespace engine {
             0,
             1,
             &frameInfo.globalDescriptorSet,
-            0,
-            nullptr);
+            1,
+            &frameInfo.globalUboOffset);
+
+        releaseTextureSets();
 
+        Frustum frustum = frameInfo.camera.getFrustum();
+        Pipeline* boundPipeline = nullptr;
+        VkDescriptorSet boundTextureSet = VK_NULL_HANDLE;
+        // pooled models share their buffers, they are bound again only when the pool or index type changes
+        GeometryPool* boundPool = nullptr;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
         for (auto& kv : frameInfo.gameObjects) {
             auto& obj = kv.second;
             if (obj.model == nullptr) continue;
+            glm::mat4 modelMatrix = obj.transform3d.mat4();
+            if (residency != nullptr) {
+                // an object out of view doesn't count as used, so its model can go cold
+                glm::vec3 center = glm::vec3{modelMatrix * glm::vec4{obj.model->getBoundsCenter(), 1.f}};
+                if (!frustum.intersectsSphere(center, obj.model->getBoundsRadius() * maxScale(modelMatrix))) continue;
+                if (!residency->use(obj.model)) continue;
+            }
             // object rotation
             // obj.transform3d.rotation.x  = glm::mod(obj.transform3d.rotation.x + 0.01f, glm::two_pi<float>());
             // obj.transform3d.rotation.y  = glm::mod(obj.transform3d.rotation.y + 0.005f, glm::two_pi<float>());
+            // bind the pipeline matching the model's vertex layout, only when it changes
+            Pipeline* pipeline = variants[currentVariant].pipelines[static_cast<int>(obj.model->getVertexLayout())].get();
+            if (pipeline != boundPipeline) {
+                pipeline->bind(frameInfo.commandBuffer);
+                boundPipeline = pipeline;
+            }
+
+            VkDescriptorSet textureSet = getTextureSet(obj.texture);
+            if (textureSet != boundTextureSet) {
+                vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                    1, 1, &textureSet, 0, nullptr);
+                boundTextureSet = textureSet;
+            }
+
             SimplePushConstantData push{};
-            push.modelMatrix = obj.transform3d.mat4();
+            // quantized positions are mapped back to model space before the object transform
+            push.modelMatrix = modelMatrix * obj.model->getDequantizeMatrix();
             push.normalMatrix = obj.transform3d.normalMatrix();
             // push constant
             vkCmdPushConstants(
@@ -96,8 +186,128 @@ namespace engine {
                 &push
             );
 
-            obj.model->bind(frameInfo.commandBuffer);
-            obj.model->draw(frameInfo.commandBuffer);
+            GeometryPool* pool = obj.model->getGeometryPool();
+            if (pool == nullptr || pool != boundPool || obj.model->getIndexType() != boundIndexType) {
+                obj.model->bind(frameInfo.commandBuffer);
+                boundPool = pool;
+                boundIndexType = obj.model->getIndexType();
+            }
+            uint32_t lod = selectLod(frameInfo, obj, modelMatrix);
+            // meshlets only cover the full resolution level
+            if (lod == 0 && !obj.model->getMeshlets().empty()) {
+                drawMeshlets(frameInfo, *obj.model, modelMatrix, frustum);
+            } else {
+                obj.model->drawLod(frameInfo.commandBuffer, lod);
+            }
+        }
+    }
+
+    VkDescriptorSet SimpleRenderSystem::getTextureSet(const std::shared_ptr<Texture>& texture) {
+        if (texture == nullptr) return whiteTextureSet;
+        auto it = textureSets.find(texture.get());
+        // a new texture may have the address of a destroyed one
+        if (it != textureSets.end() && !it->second.texture.expired()) {
+            if (it->second.version == texture->getVersion()) return it->second.set;
+            // the image was swapped (TextureStreamer), frames in flight may still bind the old set
+            std::vector<VkDescriptorSet> stale{it->second.set};
+            texturePool->freeDescriptors(stale);
+        }
+
+        VkDescriptorSet set;
+        VkDescriptorImageInfo imageInfo = texture->descriptorInfo();
+        if (!DescriptorWriter(*textureSetLayout, *texturePool).writeImage(0, &imageInfo).build(set)) {
+            throw std::runtime_error("Texture descriptor pool is full, " + std::to_string(MAX_TEXTURE_SETS) + " sets");
+        }
+        textureSets[texture.get()] = TextureSet{texture, set, texture->getVersion()};
+        return set;
+    }
+
+    void SimpleRenderSystem::releaseTextureSets() {
+        std::vector<VkDescriptorSet> released{};
+        for (auto it = textureSets.begin(); it != textureSets.end();) {
+            if (!it->second.texture.expired()) {
+                ++it;
+                continue;
+            }
+            released.push_back(it->second.set);
+            it = textureSets.erase(it);
+        }
+        // frames in flight may still bind them
+        if (!released.empty()) texturePool->freeDescriptors(released);
+    }
+
+    uint32_t SimpleRenderSystem::selectLod(FrameInfo& frameInfo, GameObject& obj, const glm::mat4& modelMatrix) {
+        const auto& lods = obj.model->getLods();
+        if (lods.empty()) return 0;
+        lodStats.fullTriangles += lods[0].indexCount / 3;
+        if (lods.size() == 1) return 0;
+
+        /*
+        a model space error e at distance d covers
+        e * scale * projection[1][1] / d * height / 2 pixels (perspective),
+        e * scale * projection[1][1] * height / 2 pixels (orthographic, no divide by w)
+        the distance is taken to the bounding sphere, so the error is never underestimated
+         */
+        const glm::mat4& projection = frameInfo.camera.getProjection();
+        float scale = maxScale(modelMatrix);
+        float pixelsPerUnit = scale * glm::abs(projection[1][1]) * 0.5f * static_cast<float>(frameInfo.extent.height);
+        if (projection[2][3] != 0.f) {
+            glm::vec3 center = glm::vec3{modelMatrix * glm::vec4{obj.model->getBoundsCenter(), 1.f}};
+            float distance = glm::length(center - frameInfo.camera.getPosition()) - obj.model->getBoundsRadius() * scale;
+            // inside the bounding sphere every error is visible
+            if (distance <= 0.f) distance = std::numeric_limits<float>::min();
+            pixelsPerUnit /= distance;
+        }
+        auto pixels = [&](uint32_t lod) { return lods[lod].error * pixelsPerUnit; };
+
+        // refine while the current level is clearly too coarse, coarsen while the next is clearly fine enough
+        auto it = objectLods.find(obj.getId());
+        uint32_t previous = it != objectLods.end() ? std::min<uint32_t>(it->second, static_cast<uint32_t>(lods.size() - 1)) : 0;
+        uint32_t lod = previous;
+        while (lod > 0 && pixels(lod) > LOD_ERROR_PIXELS * (1.f + LOD_HYSTERESIS)) --lod;
+        while (lod + 1 < lods.size() && pixels(lod + 1) <= LOD_ERROR_PIXELS * (1.f - LOD_HYSTERESIS)) ++lod;
+
+        if (it != objectLods.end() && lod != previous) ++lodStats.switches;
+        objectLods[obj.getId()] = lod;
+        lodStats.savedTriangles += (lods[0].indexCount - lods[lod].indexCount) / 3;
+        return lod;
+    }
+
+    void SimpleRenderSystem::drawMeshlets(FrameInfo& frameInfo, Model& model, const glm::mat4& modelMatrix, const Frustum& frustum) {
+        // meshlet bounds are in model space, before quantization
+        float scale = maxScale(modelMatrix);
+        // facing is invariant under the model transform, so the cone test runs in model space
+        glm::vec3 cameraPosition = glm::vec3{glm::inverse(modelMatrix) * glm::vec4{frameInfo.camera.getPosition(), 1.f}};
+
+        // visible meshlets are contiguous in the index buffer, runs of them are drawn together
+        uint32_t runFirst = 0;
+        uint32_t runCount = 0;
+        for (const auto& meshlet : model.getMeshlets()) {
+            ++meshletStats.total;
+            glm::vec3 center = glm::vec3{modelMatrix * glm::vec4{meshlet.center, 1.f}};
+            if (!frustum.intersectsSphere(center, meshlet.radius * scale)) {
+                ++meshletStats.frustumCulled;
+                continue;
+            }
+            if (cullBackfacingMeshlets && MeshletBuilder::isBackfacing(meshlet, cameraPosition)) {
+                ++meshletStats.backfaceCulled;
+                continue;
+            }
+
+            if (runCount > 0 && runFirst + runCount == meshlet.firstIndex) {
+                runCount += meshlet.indexCount;
+                continue;
+            }
+            if (runCount > 0) {
+                model.drawRange(frameInfo.commandBuffer, runFirst, runCount);
+                ++meshletStats.draws;
+            }
+            runFirst = meshlet.firstIndex;
+            runCount = meshlet.indexCount;
+        }
+        if (runCount > 0) {
+            model.drawRange(frameInfo.commandBuffer, runFirst, runCount);
+            ++meshletStats.draws;
         }
     }
 
@@ -33,11 +33,14 @@
 
 #include "pipeline.hpp"
 #include "device.hpp"
+#include "descriptors.hpp"
 #include "game_object.hpp"
 #include "camera.hpp"
 #include "frame_info.hpp"
+#include "residency_manager.hpp"
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #include <cassert>
 #include <stdexcept>
@@ -45,20 +48,116 @@
 namespace engine {
     class SimpleRenderSystem {
         public:
-            SimpleRenderSystem(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+            // with upload the default white texture's copy joins that batch, draw once it completed
+            SimpleRenderSystem(Device &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
+                UploadBatch* upload = nullptr);
             ~SimpleRenderSystem();
             // delete copy constructor and operator to avoid copying the renderer
             SimpleRenderSystem(const SimpleRenderSystem&) = delete;
             SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
+            // meshlets of models built with meshlets, summed since the last resetMeshletStats()
+            struct MeshletStats {
+                uint64_t total = 0;
+                uint64_t frustumCulled = 0;
+                uint64_t backfaceCulled = 0;
+                // vkCmdDrawIndexed calls, adjacent visible meshlets share one
+                uint64_t draws = 0;
+            };
+
+            // LOD selection, summed since the last resetLodStats()
+            struct LodStats {
+                // triangles every drawn object has at full resolution
+                uint64_t fullTriangles = 0;
+                // triangles the selected LODs left out
+                uint64_t savedTriangles = 0;
+                uint64_t switches = 0;
+            };
+
+            // a LOD is good enough while its error projects to at most this many pixels
+            static constexpr float LOD_ERROR_PIXELS = 1.f;
+            // the error has to leave this band around LOD_ERROR_PIXELS before the LOD changes, against popping
+            static constexpr float LOD_HYSTERESIS = 0.25f;
+            // distinct textures drawn at once, each one has a set in the texture pool
+            static constexpr uint32_t MAX_TEXTURE_SETS = 256;
+
+            // specialization constants of simple_shader.frag, the default is the generic shader
+            struct ShadingVariant {
+                // lights the loop runs over, at most MAX_POINT_LIGHTS
+                uint32_t maxLights = MAX_POINT_LIGHTS;
+                // the loop runs exactly maxLights times without reading ubo.numLights,
+                // for scenes whose light count is known
+                bool exactLightCount = false;
+                bool specular = true;
+                // Blinn-Phong exponent
+                float shininess = 512.f;
+
+                bool operator==(const ShadingVariant& other) const {
+                    return maxLights == other.maxLights && exactLightCount == other.exactLightCount &&
+                        specular == other.specular && shininess == other.shininess;
+                }
+            };
+
             void renderGameObjects(FrameInfo& frameInfo);
+            // objects outside the frustum are skipped, the drawn ones are reported to residency,
+            // evicted models are skipped until it restored them; nullptr draws everything
+            void setResidencyManager(ResidencyManager* manager) { residency = manager; }
+            // requests the pipelines of variant from PipelineManager, so they are compiled by its next
+            // warm-up instead of on the frame that switches to them
+            void prepareShadingVariant(const ShadingVariant& variant) { findShadingVariant(variant); }
+            // the next renderGameObjects() draws with variant
+            void setShadingVariant(const ShadingVariant& variant) { currentVariant = findShadingVariant(variant); }
+            const ShadingVariant& getShadingVariant() const { return variants[currentVariant].variant; }
+
+            const MeshletStats& getMeshletStats() const { return meshletStats; }
+            void resetMeshletStats() { meshletStats = MeshletStats{}; }
+            const LodStats& getLodStats() const { return lodStats; }
+            void resetLodStats() { lodStats = LodStats{}; }
         private:
             void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-            void createPipeline(VkRenderPass renderPass);
+            // index in variants, its pipelines are created the first time variant is asked for
+            size_t findShadingVariant(const ShadingVariant& variant);
+            void createPipelines(const ShadingVariant& variant, std::shared_ptr<Pipeline> (&pipelines)[3]);
+            // coarsest LOD of obj whose error stays below LOD_ERROR_PIXELS, starting from its previous one
+            uint32_t selectLod(FrameInfo& frameInfo, GameObject& obj, const glm::mat4& modelMatrix);
+            // draws the meshlets of model that survive frustum and normal cone culling
+            void drawMeshlets(FrameInfo& frameInfo, Model& model, const glm::mat4& modelMatrix, const Frustum& frustum);
+            // set 1 of the pipeline layout for texture, written the first time it is drawn and
+            // again after its image was swapped
+            VkDescriptorSet getTextureSet(const std::shared_ptr<Texture>& texture);
+            // frees the sets of destroyed textures
+            void releaseTextureSets();
 
             // device is initialized in app launcher
             Device& device;
-            std::unique_ptr<Pipeline> pipeline;
+            VkRenderPass renderPass;
+            struct VariantPipelines {
+                ShadingVariant variant;
+                // one pipeline per Model::VertexLayout, indexed by the enum value, shared through PipelineManager
+                std::shared_ptr<Pipeline> pipelines[3];
+            };
+            std::vector<VariantPipelines> variants{};
+            size_t currentVariant = 0;
             VkPipelineLayout pipelineLayout;
+            // set 1: one combined image sampler per texture
+            std::unique_ptr<DescriptorSetLayout> textureSetLayout;
+            std::unique_ptr<DescriptorPool> texturePool;
+            struct TextureSet {
+                std::weak_ptr<Texture> texture;
+                VkDescriptorSet set;
+                // Texture::getVersion() the set was written with
+                uint32_t version;
+            };
+            std::unordered_map<const Texture*, TextureSet> textureSets{};
+            // drawn for objects without a texture
+            std::unique_ptr<Texture> whiteTexture;
+            VkDescriptorSet whiteTextureSet;
+            // normal cone culling only matches the image when the pipelines discard back faces
+            bool cullBackfacingMeshlets = false;
+            MeshletStats meshletStats{};
+            // LOD each object was drawn with last frame
+            std::unordered_map<GameObject::id_t, uint32_t> objectLods{};
+            LodStats lodStats{};
+            ResidencyManager* residency = nullptr;
     };
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "renderer.hpp"
+#include "deletion_queue.hpp"
 
 #include <cassert>
 #include <stdexcept>
@@ -20,7 +21,10 @@ namespace engine {
             extent = window.getExtent();
             glfwWaitEvents();
         }
+        // the new swap chain comes with new fences, so this one waits for everything; nothing
+        // queued for deletion is in use anymore either
         vkDeviceWaitIdle(device.device());
+        device.deletionQueue().flush();
 
         if (swapChain == nullptr) {
             swapChain = std::make_unique<SwapChain> (device, extent);
@@ -78,6 +82,8 @@ namespace engine {
         }
 
         isFrameStarted = true;
+        // acquireNextImage waited for this frame's fence, what it was the last to use can go
+        device.deletionQueue().beginFrame(currentFrameIndex);
 
         auto commandBuffer = getCurrentCommandBuffer();
         VkCommandBufferBeginInfo beginInfo{};
@@ -86,6 +92,8 @@ namespace engine {
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("failed to begin recording command buffer!");
         }
+        // takes over buffers and images uploaded on the transfer queue, before any draw reads them
+        device.recordTransferAcquires(commandBuffer);
         return commandBuffer;
     }
 
@@ -54,6 +54,7 @@ namespace engine {
             VkRenderPass getSwapChainRenderPass() const { return swapChain->getRenderPass(); }
             bool isFrameInProgress() const { return isFrameStarted; }
             float getAspectRatio() const { return swapChain->extentAspectRatio(); }
+            VkExtent2D getSwapChainExtent() const { return swapChain->getSwapChainExtent(); }
 
             VkCommandBuffer getCurrentCommandBuffer() const {
                 assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
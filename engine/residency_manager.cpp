@@ -0,0 +1,188 @@
+#include "residency_manager.hpp"
+#include "upload_batch.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace engine {
+    ResidencyManager::ResidencyManager(Device& device, VkDeviceSize geometryBudget)
+        : device{device}, geometryBudget{geometryBudget} {}
+
+    ResidencyManager::Entry& ResidencyManager::track(const std::shared_ptr<Model>& model) {
+        // a new model may reuse the address of a destroyed one
+        Entry& entry = entries[model.get()];
+        if (entry.model.lock() != model) entry = Entry{model, frame, false};
+        return entry;
+    }
+
+    bool ResidencyManager::use(const std::shared_ptr<Model>& model) {
+        Entry& entry = track(model);
+        entry.lastUsedFrame = frame;
+        if (model->isResident()) return true;
+        entry.restoreRequested = true;
+        return false;
+    }
+
+    void ResidencyManager::update(GameObject::Map& gameObjects) {
+        ++frame;
+        for (auto& kv : gameObjects) {
+            if (kv.second.model != nullptr) track(kv.second.model);
+        }
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.model.expired()) it = entries.erase(it);
+            else ++it;
+        }
+
+        completeTransfers();
+        restoreRequested();
+        // the memory of an eviction in flight is released once its read back completed
+        if (eviction.batch == nullptr && isUnderPressure()) evictCold(excessBytes());
+
+        stats.residentModels = 0;
+        stats.evictedModels = 0;
+        stats.residentBytes = 0;
+        stats.hostBytes = 0;
+        for (auto& kv : entries) {
+            auto model = kv.second.model.lock();
+            if (model->isResident()) {
+                ++stats.residentModels;
+                stats.residentBytes += model->getGeometryBytes();
+            } else {
+                ++stats.evictedModels;
+                stats.hostBytes += model->getGeometryBytes();
+            }
+        }
+    }
+
+    VkDeviceSize ResidencyManager::residentBytes() const {
+        VkDeviceSize bytes = 0;
+        for (const auto& kv : entries) {
+            auto model = kv.second.model.lock();
+            if (model != nullptr && model->isResident()) bytes += model->getGeometryBytes();
+        }
+        return bytes;
+    }
+
+    bool ResidencyManager::isUnderPressure() const {
+        if (geometryBudget > 0 && residentBytes() > static_cast<VkDeviceSize>(geometryBudget * PRESSURE)) return true;
+        for (const auto& heap : device.allocator().getHeapBudgets()) {
+            if (heap.deviceLocal && heap.usage > static_cast<VkDeviceSize>(heap.budget * PRESSURE)) return true;
+        }
+        return false;
+    }
+
+    VkDeviceSize ResidencyManager::excessBytes() const {
+        VkDeviceSize excess = 0;
+        if (geometryBudget > 0) {
+            VkDeviceSize target = static_cast<VkDeviceSize>(geometryBudget * TARGET);
+            VkDeviceSize resident = residentBytes();
+            if (resident > target) excess = resident - target;
+        }
+        for (const auto& heap : device.allocator().getHeapBudgets()) {
+            VkDeviceSize target = static_cast<VkDeviceSize>(heap.budget * TARGET);
+            if (heap.deviceLocal && heap.usage > target) excess = std::max(excess, heap.usage - target);
+        }
+        return excess;
+    }
+
+    void ResidencyManager::completeTransfers() {
+        // batches complete in submission order, but checking each one keeps this independent of it
+        auto done = std::remove_if(restores.begin(), restores.end(), [](Transfer& restore) {
+            if (!restore.batch->isComplete()) return false;
+            for (auto& model : restore.models) model->completeRestore();
+            return true;
+        });
+        restores.erase(done, restores.end());
+        if (eviction.batch != nullptr && eviction.batch->isComplete()) completeEviction();
+    }
+
+    void ResidencyManager::restoreRequested() {
+        bool requested = std::any_of(entries.begin(), entries.end(),
+            [](const auto& kv) { return kv.second.restoreRequested; });
+        if (!requested) return;
+
+        // every restore of the frame shares one submission
+        Transfer restore{};
+        restore.batch = std::make_unique<UploadBatch>(device);
+        for (auto& kv : entries) {
+            Entry& entry = kv.second;
+            if (!entry.restoreRequested) continue;
+            entry.restoreRequested = false;
+            auto model = entry.model.lock();
+            if (model->isResident() || model->isRestoring()) continue;
+            model->restore(restore.batch.get());
+            ++stats.restores;
+            stats.restoredBytes += model->getGeometryBytes();
+            restore.models.push_back(std::move(model));
+        }
+        if (restore.models.empty()) return;
+        // submitted even without copies (direct uploads), a pool repack may be recorded into it
+        restore.batch->submit();
+        restores.push_back(std::move(restore));
+    }
+
+    void ResidencyManager::evictCold(VkDeviceSize bytes) {
+        std::vector<std::pair<uint64_t, std::shared_ptr<Model>>> candidates;
+        for (auto& kv : entries) {
+            auto model = kv.second.model.lock();
+            if (model->isResident() && frame - kv.second.lastUsedFrame >= MIN_IDLE_FRAMES) {
+                candidates.emplace_back(kv.second.lastUsedFrame, std::move(model));
+            }
+        }
+        // least recently used first
+        std::sort(candidates.begin(), candidates.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        // pooled ranges only go back to the pool, they count with what the pool could shrink by
+        VkDeviceSize released = 0;
+        std::unordered_map<GeometryPool*, std::pair<VkDeviceSize, VkDeviceSize>> pooled{};
+        auto releasable = [&]() {
+            VkDeviceSize total = released;
+            for (const auto& kv : pooled) total += kv.first->getShrinkableBytes(kv.second.first, kv.second.second);
+            return total;
+        };
+        // on the graphics queue, which owns the buffers of unpooled models
+        eviction.batch = std::make_unique<UploadBatch>(device, true);
+        eviction.frame = frame;
+        for (auto& candidate : candidates) {
+            if (releasable() >= bytes) break;
+            Model& model = *candidate.second;
+            model.evict(eviction.batch.get());
+            if (GeometryPool* pool = model.getGeometryPool()) {
+                pooled[pool].first += model.getVertexBytes();
+                pooled[pool].second += model.getIndexBytes();
+            } else {
+                released += model.getGeometryBytes();
+            }
+            eviction.models.push_back(std::move(candidate.second));
+        }
+        if (eviction.models.empty()) {
+            eviction = Transfer{};
+            return;
+        }
+        eviction.batch->submit();
+    }
+
+    void ResidencyManager::completeEviction() {
+        VkDeviceSize released = 0;
+        std::unordered_set<GeometryPool*> pools{};
+        for (auto& model : eviction.models) {
+            auto it = entries.find(model.get());
+            if (it != entries.end() && it->second.lastUsedFrame >= eviction.frame) {
+                model->cancelEviction();
+                continue;
+            }
+            model->completeEviction();
+            ++stats.evictions;
+            stats.evictedBytes += model->getGeometryBytes();
+            if (GeometryPool* pool = model->getGeometryPool()) pools.insert(pool);
+            else released += model->getGeometryBytes();
+        }
+        // a repack would copy ranges restores in flight may still be writing
+        if (restores.empty()) {
+            for (GeometryPool* pool : pools) released += pool->shrinkToFit();
+        }
+        stats.releasedBytes += released;
+        eviction = Transfer{};
+    }
+}
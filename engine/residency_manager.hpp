@@ -0,0 +1,111 @@
+#pragma once
+
+#include "device.hpp"
+#include "game_object.hpp"
+#include "model.hpp"
+#include "upload_batch.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Keeps geometry on the gpu only while it is used, once memory runs short
+
+    Render systems report every model they draw with use(). update() runs once a frame,
+    before Renderer::beginFrame, never waits for the gpu, and
+
+    - finishes the restores and the eviction whose batches completed
+    - restores the evicted models use() asked for, in one upload batch; they are drawn again
+      once it completed (an evicted model is skipped until then)
+    - checks the pressure: a device local heap over PRESSURE of its budget (see
+      MemoryAllocator::getHeapBudgets) or the resident geometry over the geometry budget
+    - under pressure, unless an eviction is in flight, evicts the least recently used models
+      idle for at least MIN_IDLE_FRAMES, until the memory handed back would get the budget
+      down to TARGET
+
+    frame    | 100 | ... | 220                       | 221             | 300            | 302 |
+    model    | use |     | pressure, read back runs  | complete: freed | use: requested | restored, drawn
+                         ^ idle >= MIN_IDLE_FRAMES
+
+    Evicted geometry is read back into host memory (Model::evict) by one batch on the graphics
+    queue; the model stays resident until it completed, a model drawn meanwhile keeps its gpu
+    side. Then the gpu memory goes back to the geometry pool or the allocator. A pooled model alone frees nothing, the
+    pool's buffers keep their size, so it counts only with what the pool can shrink by
+    (GeometryPool::getShrinkableBytes) and the pools shrink after the evictions.
+    Models are tracked through weak pointers, destroyed models are dropped.
+*/
+
+namespace engine {
+    class ResidencyManager {
+        public:
+            // fraction of a budget that starts evicting, and the one eviction goes down to
+            static constexpr float PRESSURE = 0.9f;
+            static constexpr float TARGET = 0.8f;
+            // far more frames than are in flight, so no submitted frame still reads an evicted model
+            static constexpr uint64_t MIN_IDLE_FRAMES = 120;
+
+            struct Stats {
+                uint64_t evictions = 0;
+                uint64_t restores = 0;
+                VkDeviceSize evictedBytes = 0;
+                VkDeviceSize restoredBytes = 0;
+                // device memory eviction handed back: buffers of unpooled models, pool shrinks
+                VkDeviceSize releasedBytes = 0;
+                // current state of the tracked models
+                uint32_t residentModels = 0;
+                uint32_t evictedModels = 0;
+                VkDeviceSize residentBytes = 0;
+                VkDeviceSize hostBytes = 0;
+            };
+
+            // geometryBudget 0: only the heap budgets count
+            ResidencyManager(Device& device, VkDeviceSize geometryBudget = 0);
+
+            ResidencyManager(const ResidencyManager&) = delete;
+            ResidencyManager& operator=(const ResidencyManager&) = delete;
+
+            // false when the model is evicted, skip drawing it, its restore is queued for the next update()
+            bool use(const std::shared_ptr<Model>& model);
+            // tracks the models of gameObjects, restores requested models and evicts under pressure
+            void update(GameObject::Map& gameObjects);
+
+            bool isUnderPressure() const;
+            void setGeometryBudget(VkDeviceSize budget) { geometryBudget = budget; }
+            const Stats& getStats() const { return stats; }
+
+        private:
+            struct Entry {
+                std::weak_ptr<Model> model;
+                uint64_t lastUsedFrame = 0;
+                bool restoreRequested = false;
+            };
+
+            // a batch in flight and its models, held so none is destroyed under its copies
+            struct Transfer {
+                std::vector<std::shared_ptr<Model>> models{};
+                // destroyed (waited for) before the models
+                std::unique_ptr<UploadBatch> batch;
+                // the eviction started, models used from then on keep their gpu side
+                uint64_t frame = 0;
+            };
+
+            Entry& track(const std::shared_ptr<Model>& model);
+            // bytes to free to get every budget down to TARGET
+            VkDeviceSize excessBytes() const;
+            VkDeviceSize residentBytes() const;
+            void completeTransfers();
+            void completeEviction();
+            void restoreRequested();
+            void evictCold(VkDeviceSize bytes);
+
+            Device& device;
+            VkDeviceSize geometryBudget;
+            uint64_t frame = 0;
+            std::unordered_map<Model*, Entry> entries{};
+            std::vector<Transfer> restores{};
+            // at most one in flight, batch is nullptr otherwise
+            Transfer eviction{};
+            Stats stats{};
+    };
+}
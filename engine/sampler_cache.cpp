@@ -0,0 +1,40 @@
+#include "sampler_cache.hpp"
+
+#include <stdexcept>
+
+namespace engine {
+    SamplerCache::SamplerCache(VkDevice device, const VkPhysicalDeviceProperties& properties)
+        : device{device}, maxAnisotropy{properties.limits.maxSamplerAnisotropy} {}
+
+    SamplerCache::~SamplerCache() {
+        for (auto& kv : samplers) vkDestroySampler(device, kv.second, nullptr);
+    }
+
+    VkSampler SamplerCache::get(const Key& key) {
+        auto it = samplers.find(key);
+        if (it != samplers.end()) return it->second;
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = key.filter;
+        samplerInfo.minFilter = key.filter;
+        samplerInfo.mipmapMode = key.mipmapMode;
+        samplerInfo.addressModeU = key.addressMode;
+        samplerInfo.addressModeV = key.addressMode;
+        samplerInfo.addressModeW = key.addressMode;
+        // samplerAnisotropy is enabled on every device Device picks
+        samplerInfo.anisotropyEnable = key.anisotropy ? VK_TRUE : VK_FALSE;
+        samplerInfo.maxAnisotropy = key.anisotropy ? maxAnisotropy : 1.f;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.minLod = 0.f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        VkSampler sampler;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create sampler");
+        }
+        samplers.emplace(key, sampler);
+        return sampler;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <unordered_map>
+
+/*
+    One VkSampler per distinct sampler state, shared by every texture that asks for it
+
+    Samplers don't depend on the image, so a scene of a thousand textures typically needs
+    two or three. get() creates a sampler the first time a key is seen and returns the
+    same handle afterwards; maxLod is unclamped, so textures of any mip count share it.
+    Samplers live as long as the device.
+*/
+
+namespace engine {
+    class SamplerCache {
+        public:
+            struct Key {
+                VkFilter filter = VK_FILTER_LINEAR;
+                VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+                VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+                // at the device's maxSamplerAnisotropy
+                bool anisotropy = true;
+
+                bool operator==(const Key& other) const {
+                    return filter == other.filter && mipmapMode == other.mipmapMode &&
+                        addressMode == other.addressMode && anisotropy == other.anisotropy;
+                }
+            };
+
+            SamplerCache(VkDevice device, const VkPhysicalDeviceProperties& properties);
+            ~SamplerCache();
+
+            SamplerCache(const SamplerCache&) = delete;
+            SamplerCache& operator=(const SamplerCache&) = delete;
+
+            VkSampler get(const Key& key);
+            size_t size() const { return samplers.size(); }
+
+        private:
+            struct KeyHash {
+                size_t operator()(const Key& key) const {
+                    return static_cast<size_t>(key.filter) | static_cast<size_t>(key.mipmapMode) << 4 |
+                        static_cast<size_t>(key.addressMode) << 8 | static_cast<size_t>(key.anisotropy) << 12;
+                }
+            };
+
+            VkDevice device;
+            float maxAnisotropy;
+            std::unordered_map<Key, VkSampler, KeyHash> samplers{};
+    };
+}
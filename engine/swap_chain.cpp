@@ -23,7 +23,7 @@ namespace engine{
         for (size_t i = 0; i < depthImageViews.size(); i++) {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
             vkDestroyImage(device.device(), depthImages[i], nullptr);
-            vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+            device.allocator().free(depthImageMemorys[i]);
         }
 
         // destroy frame buffer
@@ -385,11 +385,20 @@ namespace engine{
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
+        // uploads on the transfer queue signal the timeline, the frame waits for the ones whose
+        // acquire barriers it recorded (already reached when the frame is submitted, so it doesn't stall)
+        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame], device.transferTimeline()};
+        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+        // the binary semaphore's value is ignored
+        uint64_t waitValues[] = {0, device.transferWaitValue()};
+        VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 2;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        submitInfo.waitSemaphoreCount = waitValues[1] > 0 ? 2 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
+        if (submitInfo.waitSemaphoreCount == 2) submitInfo.pNext = &timelineInfo;
 
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
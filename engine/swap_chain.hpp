@@ -83,7 +83,7 @@ namespace engine {
             std::vector<VkImage> swapChainImages;
             std::vector<VkImageView> swapChainImageViews;
             std::vector<VkImage> depthImages;
-            std::vector<VkDeviceMemory> depthImageMemorys;
+            std::vector<MemoryAllocator::Allocation> depthImageMemorys;
             std::vector<VkImageView> depthImageViews;
 
             VkFormat swapChainImageFormat;
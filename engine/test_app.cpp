@@ -1,6 +1,11 @@
 #include "test_app.hpp"
 #include "keyboard_controller.hpp"
 #include "buffer.hpp"
+#include "deletion_queue.hpp"
+#include "gpu_timer.hpp"
+#include "ktx2_loader.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_manager.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -9,35 +14,33 @@
 #include <glm/gtc/constants.hpp>
 
 #include <chrono>
+#include <filesystem>
 
 namespace engine {
     
 
-    TestApp::TestApp() {
+    TestApp::TestApp() : TestApp(Options{}) {}
+
+    TestApp::TestApp(const Options& options) : options{options} {
         // create global descriptor pool
+        // one global set for every frame, the frame's ubo is picked by its dynamic offset
         globalPool = DescriptorPool::Builder(device)
-            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .setMaxSets(1)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
             .build();
 
+        // the models loaded from here on are drawn from the pool with one buffer bind per frame
+        Model::setGeometryPool(&geometryPool);
+        Model::setDefragmenter(&defragmenter);
         loadGameObjects();
     }
 
-    TestApp::~TestApp() { }
+    TestApp::~TestApp() {
+        Model::setGeometryPool(nullptr);
+        Model::setDefragmenter(nullptr);
+    }
 
     void TestApp::run() {
-        std::vector<std::unique_ptr<Buffer>> uboBuffers(SwapChain::MAX_FRAMES_IN_FLIGHT);
-        for (int i=0; i<uboBuffers.size(); ++i){
-            uboBuffers[i] = std::make_unique<Buffer>(
-                device,
-                sizeof(GlobalUbo),
-                1,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-            );
-            uboBuffers[i]->map();
-        }
-
         // an example for descriptor set:
         // bind pipeline, bind global descriptor set -  at set #0
         // for each material in Materials:
@@ -53,16 +56,14 @@ namespace engine {
         // sub systems: [Simple render system](set 0: globalSetLayout, set 1: xxxSetLayout ...) 
         // [xxx render system](set 0: globalSetLayout, set 1: yyyLayout ...) ...
         auto globalSetLayout = DescriptorSetLayout::Builder(device)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
             .build();
 
-        std::vector<VkDescriptorSet> globalDescriptorSets(SwapChain::MAX_FRAMES_IN_FLIGHT);
-        for (int i=0; i<globalDescriptorSets.size(); ++i){
-            auto bufferInfo = uboBuffers[i]->descriptorInfo();
-            DescriptorWriter(*globalSetLayout, *globalPool)
+        VkDescriptorSet globalDescriptorSet;
+        auto bufferInfo = frameAllocator.descriptorInfo(sizeof(GlobalUbo));
+        DescriptorWriter(*globalSetLayout, *globalPool)
             .writeBuffer(0, &bufferInfo)
-            .build(globalDescriptorSets[i]);
-        }
+            .build(globalDescriptorSet);
 
         // draw frame procedure:
         // 1. Acquire an image from the swap chain, calling vkAcquireNextImageKHR
@@ -74,12 +75,43 @@ namespace engine {
         // also update the current frame in flight
         SimpleRenderSystem simpleRenderSystem(device, 
             renderer.getSwapChainRenderPass(), 
-            globalSetLayout->getDescriptorSetLayout());
+            globalSetLayout->getDescriptorSetLayout(),
+            textureBatch.get());
+        simpleRenderSystem.setResidencyManager(&residency);
         PointLightSystem pointLightSystem(device, 
             renderer.getSwapChainRenderPass(), 
             globalSetLayout->getDescriptorSetLayout());
         Camera camera{};
 
+        // the scene's light count never changes, so it is drawn with a fragment shader specialized for
+        // exactly that many lights; the other variants are only drawn by the shading benchmark (--shading-bench)
+        uint32_t sceneLights = 0;
+        for (auto& kv : gameObjects) {
+            if (kv.second.pointLight != nullptr) ++sceneLights;
+        }
+        using ShadingVariant = SimpleRenderSystem::ShadingVariant;
+        const std::vector<std::pair<const char*, ShadingVariant>> shadingVariants{
+            {"generic (ubo.numLights loop)", ShadingVariant{}},
+            {"exact light count", ShadingVariant{sceneLights, true, true, 512.f}},
+            {"exact light count, no specular", ShadingVariant{sceneLights, true, false, 512.f}},
+            {"ambient only", ShadingVariant{0, true, false, 512.f}},
+        };
+        if (options.shadingBench) {
+            for (const auto& named : shadingVariants) simpleRenderSystem.prepareShadingVariant(named.second);
+        }
+        const ShadingVariant sceneVariant = shadingVariants[1].second;
+        simpleRenderSystem.setShadingVariant(sceneVariant);
+
+        // shading benchmark: once the scene is loaded each variant draws SHADING_BENCH_FRAMES frames,
+        // the variants differ only in the fragment shader, so does the gpu time of the opaque pass
+        GpuTimer gpuTimer{device, SwapChain::MAX_FRAMES_IN_FLIGHT};
+        bool benchmarking = false;
+        size_t benchVariant = 0;
+        uint32_t benchSamples = 0;
+        double benchMs = 0.0;
+        // variant each frame in flight was timed with, -1 outside the benchmark
+        std::vector<int> timedVariant(SwapChain::MAX_FRAMES_IN_FLIGHT, -1);
+
         // create a camera viewer object
         auto cameraObject = GameObject::createGameObject();
         cameraObject.transform3d.translation.z = -2.5f;
@@ -87,11 +119,83 @@ namespace engine {
 
         auto currentTime = std::chrono::high_resolution_clock::now();
 
+        // the load-time textures upload while the pipelines compile, one submission for all of them
+        textureBatch->submit();
+
+        // warm-up: the render systems only queued their pipelines, they compile in parallel here
+        // instead of on the frame that first binds them
+        device.pipelineManager().waitIdle();
+        textureBatch->wait();
+        textureBatch.reset();
+        const auto managerStats = device.pipelineManager().getStats();
+        std::cout << "pipeline manager: " << managerStats.requests << " requests, " << managerStats.shared
+            << " shared, " << managerStats.compiled << " compiled, warm-up " << managerStats.warmUpMs << " ms" << std::endl;
+
+        // a launch without pipeline_cache.bin (the first, or after a driver update) compiles everything
+        const auto& pipelineStats = device.pipelineCache().getStats();
+        std::cout << "pipelines: " << pipelineStats.pipelines << " created in " << pipelineStats.creationMs << " ms, "
+            << (pipelineStats.loadedFromDisk ? "cache loaded from disk (" + std::to_string(pipelineStats.loadedBytes / 1024) + " KB)"
+                : std::string("no usable cache on disk")) << std::endl;
+
         std::cout<<"Start running the app"<<std::endl;
+        bool sceneLoaded = false;
+
+        uint64_t frameCount = 0;
+        Model::resetDrawStats();
+        simpleRenderSystem.resetMeshletStats();
+        simpleRenderSystem.resetLodStats();
+        Buffer::resetWriteStats();
 
         while (!window.shouldClose()) {
             glfwPollEvents();
 
+            // swaps finished models in, never waits for the gpu
+            modelLoader.update(gameObjects);
+            if (!sceneLoaded && modelLoader.isIdle()) {
+                sceneLoaded = true;
+                float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                    std::chrono::high_resolution_clock::now() - loadStartTime).count();
+                const auto& indexStats = Model::getIndexStats();
+                std::cout << "scene loaded in " << loadTime << " ms (" << modelLoader.getBatchCount()
+                    << " upload batches), rendered " << frameCount << " frames meanwhile" << std::endl;
+                std::cout << "index memory: " << indexStats.residentBytes / 1024 << " KB ("
+                    << indexStats.residentBytesUint32 / 1024 << " KB with uint32 indices)" << std::endl;
+                std::cout << "geometry pool: " << geometryPool.getUsedBytes() / 1024 << " of "
+                    << geometryPool.getCapacity() / 1024 << " KB used" << std::endl;
+                const auto& uploadStats = Model::getUploadStats();
+                std::cout << "geometry uploads: " << uploadStats.directBytes / 1024 << " KB written directly, "
+                    << uploadStats.stagedBytes / 1024 << " KB through staging" << std::endl;
+                const auto memoryStats = device.allocator().getStats();
+                std::cout << "device memory: " << memoryStats.allocationCount << " allocations in "
+                    << memoryStats.blockCount << " blocks + " << memoryStats.dedicatedCount << " dedicated ("
+                    << device.properties.limits.maxMemoryAllocationCount << " allowed), "
+                    << memoryStats.usedBytes / 1024 << " of " << memoryStats.blockBytes / 1024 << " KB used, "
+                    << "fragmentation " << memoryStats.fragmentation() << std::endl;
+                // before sub-allocation every buffer and image had its own vkAllocateMemory
+                std::cout << "live vkAllocateMemory allocations: " << memoryStats.blockCount + memoryStats.dedicatedCount
+                    << " (" << memoryStats.allocationCount << " with one per resource)" << std::endl;
+                for (const auto& heap : device.allocator().getHeapBudgets()) {
+                    std::cout << (heap.deviceLocal ? "device local" : "host") << " heap: "
+                        << heap.usage / (1024 * 1024) << " of " << heap.budget / (1024 * 1024) << " MB budget ("
+                        << heap.size / (1024 * 1024) << " MB, " << (device.supportsMemoryBudget() ? "reported" : "estimated")
+                        << ")" << std::endl;
+                }
+                // --defrag-demo: the tiles drawn so far are tracked by the defragmenter, unloading every other one leaves
+                // the block the last ones spilled into sparse enough to be emptied into the first
+                for (size_t i = 1; i < defragTiles.size(); i += 2) gameObjects.erase(defragTiles[i]);
+                defragTiles.clear();
+                if (options.shadingBench && gpuTimer.isSupported()) {
+                    benchmarking = true;
+                    simpleRenderSystem.setShadingVariant(shadingVariants[0].second);
+                }
+            }
+            // restores models drawn while evicted, evicts cold ones under memory pressure
+            residency.update(gameObjects);
+            // unloads leave holes in the pool, squeezed out once they add up
+            if (geometryPool.compactIfFragmented()) {
+                std::cout << "geometry pool compacted, " << geometryPool.getUsedBytes() / 1024 << " KB live" << std::endl;
+            }
+
             auto newTime = std::chrono::high_resolution_clock::now();
             float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
@@ -102,18 +206,48 @@ namespace engine {
             float aspect = renderer.getAspectRatio();
             // camera.setOrthographicProjection(-aspect, aspect, -1.0f, 1.0f, -1.0f, 1.0f);
             camera.setPerspectiveProjection(glm::radians(100.0f), aspect, 0.1f, 100.0f);
+            // swaps in finished mip uploads, requests the levels the camera needs now
+            textureStreamer.update(gameObjects, camera, renderer.getSwapChainExtent());
 
             // std::cout<<"Before begining the frame "<<std::endl;
 
             if (auto commandBuffer = renderer.beginFrame()) {
                 int frameIndex = renderer.getFrameIndex();
+                // the frame's fence was waited for in beginFrame, its part of the ring is free again
+                frameAllocator.beginFrame(frameIndex);
+                double opaqueMs;
+                if (gpuTimer.collect(frameIndex, opaqueMs) && benchmarking &&
+                    timedVariant[frameIndex] == static_cast<int>(benchVariant)) {
+                    benchMs += opaqueMs;
+                    if (++benchSamples == SHADING_BENCH_FRAMES) {
+                        std::cout << "shading variant " << shadingVariants[benchVariant].first << ": "
+                            << benchMs / benchSamples << " ms gpu per frame in the opaque pass" << std::endl;
+                        benchSamples = 0;
+                        benchMs = 0.0;
+                        benchmarking = ++benchVariant < shadingVariants.size();
+                        simpleRenderSystem.setShadingVariant(
+                            benchmarking ? shadingVariants[benchVariant].second : sceneVariant);
+                    }
+                }
+                gpuTimer.reset(commandBuffer, frameIndex);
+                // a few relocations per frame, recorded ahead of the render pass
+                if (defragmenter.update(commandBuffer, frameIndex)) {
+                    const auto& defragStats = defragmenter.getStats();
+                    std::cout << "device memory defragmented: fragmentation " << defragStats.fragmentationBefore
+                        << " -> " << defragStats.fragmentationAfter << ", blocks " << defragStats.blocksBefore
+                        << " -> " << defragStats.blocksAfter << " (" << defragStats.moves << " buffers moved so far)"
+                        << std::endl;
+                }
+                auto uboAllocation = frameAllocator.allocate(sizeof(GlobalUbo));
                 FrameInfo frameInfo{
                     frameIndex, 
                     frameTime, 
                     commandBuffer, 
                     camera, 
-                    globalDescriptorSets[frameIndex], 
-                    gameObjects};
+                    globalDescriptorSet, 
+                    gameObjects,
+                    renderer.getSwapChainExtent(),
+                    uboAllocation.offset};
 
                 // update
                 GlobalUbo ubo{};
@@ -124,19 +258,75 @@ namespace engine {
 
                 // std::cout<<"updated point light "<<std::endl;
 
-                uboBuffers[frameIndex]->writeToBuffer(&ubo);
-                uboBuffers[frameIndex]->flush();
+                frameAllocator.write(uboAllocation, &ubo);
+                frameAllocator.flush();
 
                 renderer.beginSwapChainRenderPass(commandBuffer);
                 // std::cout<<"beginned swap chain render pass "<<std::endl;
+                gpuTimer.begin(commandBuffer, frameIndex);
                 simpleRenderSystem.renderGameObjects(frameInfo);
+                gpuTimer.end(commandBuffer, frameIndex);
+                timedVariant[frameIndex] = benchmarking ? static_cast<int>(benchVariant) : -1;
                 // std::cout<<"rendered game objects "<<std::endl;
                 pointLightSystem.render(frameInfo);
                 // std::cout<<"rendered point light "<<std::endl;
                 renderer.endSwapChainRenderPass(commandBuffer);
                 // std::cout<<"ended swap chain render pass "<<std::endl;
                 renderer.endFrame();
+                ++frameCount;
+            }
+        }
+
+        if (frameCount > 0) {
+            const auto& indexStats = Model::getIndexStats();
+            std::cout << "index fetch per frame: " << indexStats.drawnBytes / frameCount / 1024 << " KB ("
+                << indexStats.drawnBytesUint32 / frameCount / 1024 << " KB with uint32 indices)" << std::endl;
+            const auto& meshletStats = simpleRenderSystem.getMeshletStats();
+            std::cout << "meshlets per frame: " << meshletStats.total / frameCount
+                << ", frustum culled " << meshletStats.frustumCulled / frameCount
+                << ", backface culled " << meshletStats.backfaceCulled / frameCount
+                << ", draw calls " << meshletStats.draws / frameCount << std::endl;
+            const auto& lodStats = simpleRenderSystem.getLodStats();
+            std::cout << "triangles per frame at full resolution: " << lodStats.fullTriangles / frameCount
+                << ", saved by LODs " << lodStats.savedTriangles / frameCount
+                << ", LOD switches " << lodStats.switches << std::endl;
+            const auto& writeStats = Buffer::getWriteStats();
+            const auto& residencyStats = residency.getStats();
+            std::cout << "residency: " << residencyStats.evictions << " evictions ("
+                << residencyStats.evictedBytes / 1024 << " KB), " << residencyStats.restores << " restores ("
+                << residencyStats.restoredBytes / 1024 << " KB), " << residencyStats.evictedModels
+                << " models on the host, " << residencyStats.releasedBytes / 1024 << " KB of device memory released"
+                << std::endl;
+            std::cout << "host writes per frame: " << writeStats.writtenBytes / frameCount << " bytes, flushed "
+                << writeStats.flushedBytes / frameCount << " bytes" << std::endl;
+            const auto& textureStats = Texture::getUploadStats();
+            std::cout << "textures: " << textureStats.textures << " (" << textureStats.stagedBytes / 1024
+                << " KB staged), mip chains " << textureStats.gpuMipChains << " blitted, "
+                << textureStats.cpuMipChains << " cpu filtered" << std::endl;
+            const auto& ktx2Stats = Ktx2Loader::getStats();
+            if (ktx2Stats.files > 0) {
+                std::cout << "ktx2: " << ktx2Stats.files << " files, " << ktx2Stats.uploadBytes / 1024 << " KB uploaded ("
+                    << ktx2Stats.rgbaBytes / 1024 << " KB as rgba8), " << ktx2Stats.transcodedFiles
+                    << " decoded on the cpu in " << ktx2Stats.transcodeMs << " ms, parsed in "
+                    << ktx2Stats.parseMs << " ms" << std::endl;
             }
+            const auto& streamingStats = textureStreamer.getStats();
+            std::cout << "texture streaming: " << streamingStats.residentBytes / 1024 << " of "
+                << streamingStats.fullBytes / 1024 << " KB resident, " << streamingStats.levelsStreamedIn
+                << " levels streamed in, " << streamingStats.levelsDropped << " dropped ("
+                << streamingStats.uploadedBytes / 1024 << " KB uploaded), " << streamingStats.pendingRequests
+                << " requests pending, " << streamingStats.inFlightRequests << " in flight" << std::endl;
+            const auto& defragStats = defragmenter.getStats();
+            std::cout << "defragmenter: " << defragStats.moves << " buffers moved (" << defragStats.movedBytes / 1024
+                << " KB) in " << defragStats.passes << " passes, blocks " << defragStats.blocksBefore << " -> "
+                << defragStats.blocksAfter << " in the last one" << std::endl;
+            const auto& deletionStats = device.deletionQueue().getStats();
+            std::cout << "deferred destruction: " << deletionStats.destroyed << " objects destroyed without a stall, "
+                << deletionStats.pending << " pending" << std::endl;
+            // nonzero means a pipeline was requested after the warm-up and a frame waited for it
+            const auto lateStats = device.pipelineManager().getStats();
+            std::cout << "pipeline stalls: " << lateStats.lateBinds << " binds waited "
+                << lateStats.lateBindMs << " ms" << std::endl;
         }
         // wait for the device (gpu) to finish before cleaning up
         vkDeviceWaitIdle(device.device());
@@ -192,37 +382,90 @@ namespace engine {
         return std::make_unique<Model>(device, modelBuilder);
     }
     
+    // temporary helper function, a flat grid of cells x cells quads in the xz plane from -0.5 to 0.5
+    Model::Builder createGrid(uint32_t cells) {
+        Model::Builder builder{};
+        for (uint32_t z = 0; z <= cells; ++z) {
+            for (uint32_t x = 0; x <= cells; ++x) {
+                Model::Vertex vertex{};
+                vertex.position = {static_cast<float>(x) / cells - .5f, 0.f, static_cast<float>(z) / cells - .5f};
+                vertex.color = {.4f, .4f, .4f};
+                // y points down
+                vertex.normal = {0.f, -1.f, 0.f};
+                vertex.uv = {static_cast<float>(x) / cells, static_cast<float>(z) / cells};
+                builder.vertices.push_back(vertex);
+            }
+        }
+        for (uint32_t z = 0; z < cells; ++z) {
+            for (uint32_t x = 0; x < cells; ++x) {
+                uint32_t corner = z * (cells + 1) + x;
+                builder.indices.insert(builder.indices.end(), {corner, corner + cells + 1, corner + 1,
+                    corner + 1, corner + cells + 1, corner + cells + 2});
+            }
+        }
+        return builder;
+    }
+
+    // temporary helper function, a checkerboard with cells of cellSize texels
+    Texture::Builder createChecker(uint32_t size, uint32_t cellSize) {
+        Texture::Builder builder{};
+        builder.width = size;
+        builder.height = size;
+        builder.pixels.resize(static_cast<size_t>(size) * size * 4);
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                uint8_t value = ((x / cellSize + y / cellSize) % 2 == 0) ? 230 : 60;
+                uint8_t* texel = &builder.pixels[(static_cast<size_t>(y) * size + x) * 4];
+                texel[0] = texel[1] = texel[2] = value;
+                texel[3] = 255;
+            }
+        }
+        return builder;
+    }
+
     void TestApp::loadGameObjects() {
+        // the .obj models load in the background, every object shows the placeholder cube until then
+        loadStartTime = std::chrono::high_resolution_clock::now();
+        textureBatch = std::make_unique<UploadBatch>(device);
+
         // create a model using .obj file
-        std::shared_ptr<Model> model = Model::createModelFromFile(device, "../assets/models/room.obj");
         auto gameObj = GameObject::createGameObject();
-        gameObj.model = model;
+        gameObj.model = modelLoader.getPlaceholder();
+        modelLoader.load("../assets/models/room.obj", gameObj.getId(), true);
         gameObj.transform3d.translation = {-0.5f, 0.5f, 0.0f};
         gameObj.transform3d.scale = glm::vec3(1.f);
         gameObj.transform3d.rotation = glm::vec3(glm::radians(90.0f), glm::radians(90.0f), 0.f);
         gameObjects.emplace(gameObj.getId(), std::move(gameObj));
 
-        std::shared_ptr<Model> flat_vase_model = Model::createModelFromFile(device, "../assets/models/flat_vase.obj");
         auto flat_vase = GameObject::createGameObject();
-        flat_vase.model = flat_vase_model;
+        flat_vase.model = modelLoader.getPlaceholder();
+        modelLoader.load("../assets/models/flat_vase.obj", flat_vase.getId());
         flat_vase.transform3d.translation = {1.0f, 0.5f, 0.0f};
         flat_vase.transform3d.scale = glm::vec3(3.f);
         gameObjects.emplace(flat_vase.getId(), std::move(flat_vase));
 
-        std::shared_ptr<Model> smooth_vase_model = Model::createModelFromFile(device, "../assets/models/smooth_vase.obj");
         auto smooth_vase = GameObject::createGameObject();
-        smooth_vase.model = smooth_vase_model;
+        smooth_vase.model = modelLoader.getPlaceholder();
+        modelLoader.load("../assets/models/smooth_vase.obj", smooth_vase.getId());
         smooth_vase.transform3d.translation = {2.0f, 0.5f, 0.0f};
         smooth_vase.transform3d.scale = glm::vec3(3.f);
         gameObjects.emplace(smooth_vase.getId(), std::move(smooth_vase));
 
-        std::shared_ptr<Model> quad_model = Model::createModelFromFile(device, "../assets/models/quad.obj");
         auto quad = GameObject::createGameObject();
-        quad.model = quad_model;
+        quad.model = modelLoader.getPlaceholder();
+        modelLoader.load("../assets/models/quad.obj", quad.getId());
         quad.transform3d.translation = {0.0f, 0.5f, 0.0f};
         quad.transform3d.scale = {3.f, 1.f, 3.f};
+        // the mip chain keeps the far cells from shimmering, the fine levels stream in when the camera comes close
+        if (std::filesystem::exists("../assets/textures/quad.ktx2")) {
+            quad.texture = textureStreamer.add(Ktx2Loader::prepare(device, "../assets/textures/quad.ktx2"), textureBatch.get());
+        } else {
+            quad.texture = textureStreamer.add(Texture::buildLevels(createChecker(1024, 128)), textureBatch.get());
+        }
         gameObjects.emplace(quad.getId(), std::move(quad));
 
+        if (options.defragDemo) loadDefragTiles();
+
         std::vector<glm::vec3> lightColors{
             {1.f, .1f, .1f},
             {.1f, .1f, 1.f},
@@ -290,4 +533,23 @@ namespace engine {
 
         gameObjects.push_back(std::move(triangle)); */
     }
+
+    void TestApp::loadDefragTiles() {
+        // tiles under the floor with buffers of their own, so the defragmenter has something to move
+        // (the pool's buffers are written by the host and never relocated)
+        Model::setGeometryPool(nullptr);
+        Model::Builder tileBuilder = createGrid(DEFRAG_TILE_CELLS);
+        UploadBatch tileBatch{device};
+        for (uint32_t i = 0; i < DEFRAG_TILES; ++i) {
+            auto tile = GameObject::createGameObject();
+            tile.model = std::make_shared<Model>(device, tileBuilder, Model::VertexLayout::Standard, tileBatch);
+            tile.transform3d.translation = {-1.25f + (i % 8) * .5f, .6f, -1.25f + (i / 8) * .5f};
+            tile.transform3d.scale = glm::vec3(.5f);
+            defragTiles.push_back(tile.getId());
+            gameObjects.emplace(tile.getId(), std::move(tile));
+        }
+        tileBatch.submit();
+        tileBatch.wait();
+        Model::setGeometryPool(&geometryPool);
+    }
 }
\ No newline at end of file
@@ -38,8 +38,15 @@
 #include "render_system/point_light_system.hpp"
 #include "renderer.hpp"
 #include "camera.hpp"
+#include "defragmenter.hpp"
 #include "descriptors.hpp"
+#include "frame_allocator.hpp"
+#include "geometry_pool.hpp"
+#include "model_loader.hpp"
+#include "residency_manager.hpp"
+#include "texture_streamer.hpp"
 
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <cassert>
@@ -50,8 +57,24 @@ namespace engine {
         public:
             static constexpr int WIDTH = 800;
             static constexpr int HEIGHT = 600;
+            // frames the shading benchmark times each fragment shader variant for
+            static constexpr uint32_t SHADING_BENCH_FRAMES = 300;
+            // tiles owning their buffers, about 1.25 MB each, enough to spill past the first memory block
+            static constexpr uint32_t DEFRAG_TILES = 48;
+            static constexpr uint32_t DEFRAG_TILE_CELLS = 128;
+
+            // exercises that change the scene, off unless asked for on the command line
+            struct Options {
+                // --defrag-demo: tiles under the floor, half of them unloaded once the scene is loaded,
+                // so the defragmenter has buffers to move
+                bool defragDemo = false;
+                // --shading-bench: once the scene is loaded, draws SHADING_BENCH_FRAMES frames with each
+                // shading variant and prints the gpu time of the opaque pass
+                bool shadingBench = false;
+            };
 
             TestApp();
+            TestApp(const Options& options);
             ~TestApp();
 
             TestApp(const TestApp&) = delete;
@@ -61,12 +84,32 @@ namespace engine {
 
         private:
             void loadGameObjects();
+            void loadDefragTiles();
 
+            Options options;
             Window window{WIDTH, HEIGHT, "Test App"};
             Device device{window};
             Renderer renderer{device, window};
+            // per-frame uniform data, rewound every frame
+            FrameAllocator frameAllocator{device};
+            // moves model buffers out of sparse memory blocks, outlives the models like the pool
+            Defragmenter defragmenter{device};
+            // shared vertex/index buffers of every loaded model, declared before the
+            // members holding models so it outlives them
+            GeometryPool geometryPool{device};
+            // models stream in while the render loop runs
+            ModelLoader modelLoader{device};
+            // evicts the geometry of models out of view for long when memory runs short
+            ResidencyManager residency{device};
+            // streams texture mips in and out by the screen size of the objects using them
+            TextureStreamer textureStreamer{device};
 
             std::unique_ptr<DescriptorPool> globalPool;
+            // every texture created at load time records into it, submitted and waited for once in run()
+            std::unique_ptr<UploadBatch> textureBatch;
             GameObject::Map gameObjects;
+            // --defrag-demo only, every other one is unloaded once the scene is loaded
+            std::vector<GameObject::id_t> defragTiles;
+            std::chrono::high_resolution_clock::time_point loadStartTime;
     };
 }
\ No newline at end of file
@@ -0,0 +1,334 @@
+#include "texture.hpp"
+#include "deletion_queue.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace engine {
+    Texture::UploadStats Texture::uploadStats{};
+
+    namespace {
+        VkImageMemoryBarrier layoutBarrier(VkImage image, uint32_t baseLevel, uint32_t levelCount,
+            VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dstAccess;
+            barrier.oldLayout = oldLayout;
+            barrier.newLayout = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = baseLevel;
+            barrier.subresourceRange.levelCount = levelCount;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            return barrier;
+        }
+
+        void recordBarrier(VkCommandBuffer commandBuffer, const VkImageMemoryBarrier& barrier,
+            VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+            vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        // every level was copied, they all go to the sampled layout at once
+        void recordShaderReadTransition(VkCommandBuffer commandBuffer, VkImage image, uint32_t levels) {
+            recordBarrier(commandBuffer,
+                layoutBarrier(image, 0, levels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+
+        // each level is blitted from the previous one, which is final afterwards
+        void recordMipBlits(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t levels) {
+            int32_t mipWidth = static_cast<int32_t>(width);
+            int32_t mipHeight = static_cast<int32_t>(height);
+            for (uint32_t level = 1; level < levels; ++level) {
+                recordBarrier(commandBuffer,
+                    layoutBarrier(image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                int32_t nextWidth = std::max(mipWidth / 2, 1);
+                int32_t nextHeight = std::max(mipHeight / 2, 1);
+                VkImageBlit blit{};
+                blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+                blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+                blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+                blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+                vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+                recordBarrier(commandBuffer,
+                    layoutBarrier(image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT),
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                mipWidth = nextWidth;
+                mipHeight = nextHeight;
+            }
+            recordBarrier(commandBuffer,
+                layoutBarrier(image, levels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+
+        VkBufferImageCopy levelRegion(uint32_t level, VkDeviceSize offset, uint32_t width, uint32_t height) {
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = {width, height, 1};
+            return region;
+        }
+
+        bool isSrgb(VkFormat format) {
+            return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+        }
+
+        float srgbToLinear(uint8_t value) {
+            float c = value / 255.f;
+            return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        uint8_t linearToSrgb(float c) {
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+            return static_cast<uint8_t>(std::clamp(c, 0.f, 1.f) * 255.f + 0.5f);
+        }
+    }
+
+    Texture::Texture(Device& device, const Builder& builder, UploadBatch* upload)
+        : device{device}, format{builder.format}, width{builder.width}, height{builder.height} {
+        if (width == 0 || height == 0) throw std::runtime_error("Texture has no size");
+        if (!builder.levels.empty()) {
+            if (builder.levels.size() > mipLevelCount(width, height)) {
+                throw std::runtime_error("Texture has more levels than its size allows");
+            }
+            for (size_t level = 0; level < builder.levels.size(); ++level) {
+                const auto& range = builder.levels[level];
+                if (range.width != std::max(width >> level, 1u) || range.height != std::max(height >> level, 1u) ||
+                    range.offset % 16 != 0 || range.offset + range.size > builder.pixels.size()) {
+                    throw std::runtime_error("Texture level doesn't match its size or pixels");
+                }
+            }
+            if (builder.firstLevel >= builder.levels.size()) throw std::runtime_error("Texture first level is out of its chain");
+            firstLevel = builder.firstLevel;
+            mipLevels = static_cast<uint32_t>(builder.levels.size()) - firstLevel;
+        } else if (builder.firstLevel != 0) {
+            throw std::runtime_error("Texture first level needs a prebuilt chain");
+        } else if (builder.pixels.size() < static_cast<size_t>(width) * height * 4) {
+            throw std::runtime_error("Texture pixels don't cover its size");
+        } else {
+            mipLevels = builder.mipmaps ? mipLevelCount(width, height) : 1;
+        }
+        blitMips = builder.levels.empty() && mipLevels > 1 && device.supportsFormatFeatures(format, VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (blitMips) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        createImage(usage);
+        createImageView();
+        setSampler(SamplerCache::Key{});
+
+        std::unique_ptr<UploadBatch> ownBatch{};
+        if (upload == nullptr) {
+            ownBatch = std::make_unique<UploadBatch>(device);
+            upload = ownBatch.get();
+        }
+        record(builder, *upload);
+        if (ownBatch) {
+            ownBatch->submit();
+            ownBatch->wait();
+        }
+    }
+
+    Texture::~Texture() {
+        device.deletionQueue().destroyImage(image, imageView, allocation);
+    }
+
+    void Texture::swapImage(Texture& next) {
+        if (next.format != format || next.width != width || next.height != height) {
+            throw std::runtime_error("Texture images of different chains can't be swapped");
+        }
+        std::swap(image, next.image);
+        std::swap(imageView, next.imageView);
+        std::swap(allocation, next.allocation);
+        std::swap(mipLevels, next.mipLevels);
+        std::swap(firstLevel, next.firstLevel);
+        ++version;
+    }
+
+    std::unique_ptr<Texture> Texture::createSolid(Device& device, const glm::vec4& color, UploadBatch* upload) {
+        Builder builder{};
+        builder.width = 1;
+        builder.height = 1;
+        for (int i = 0; i < 4; ++i) {
+            builder.pixels.push_back(static_cast<uint8_t>(glm::clamp(color[i], 0.f, 1.f) * 255.f + 0.5f));
+        }
+        // the color is meant as is, no srgb decode
+        builder.format = VK_FORMAT_R8G8B8A8_UNORM;
+        builder.mipmaps = false;
+        return std::make_unique<Texture>(device, builder, upload);
+    }
+
+    uint32_t Texture::mipLevelCount(uint32_t width, uint32_t height) {
+        uint32_t levels = 1;
+        for (uint32_t size = std::max(width, height); size > 1; size /= 2) ++levels;
+        return levels;
+    }
+
+    VkDescriptorImageInfo Texture::descriptorInfo() const {
+        return VkDescriptorImageInfo{sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    }
+
+    void Texture::createImage(VkImageUsageFlags usage) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {std::max(width >> firstLevel, 1u), std::max(height >> firstLevel, 1u), 1};
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation);
+    }
+
+    void Texture::createImageView() {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create texture image view");
+        }
+    }
+
+    Texture::Builder Texture::buildLevels(const Builder& builder) {
+        if (builder.width == 0 || builder.height == 0 || builder.pixels.size() < static_cast<size_t>(builder.width) * builder.height * 4) {
+            throw std::runtime_error("Texture pixels don't cover its size");
+        }
+        std::vector<VkBufferImageCopy> regions{};
+        Builder chain{};
+        chain.width = builder.width;
+        chain.height = builder.height;
+        chain.format = builder.format;
+        chain.pixels = buildMipChain(builder, builder.mipmaps ? mipLevelCount(builder.width, builder.height) : 1, regions);
+        for (size_t level = 0; level < regions.size(); ++level) {
+            const VkExtent3D& extent = regions[level].imageExtent;
+            chain.levels.push_back(Builder::Level{static_cast<size_t>(regions[level].bufferOffset),
+                static_cast<size_t>(extent.width) * extent.height * 4, extent.width, extent.height});
+        }
+        return chain;
+    }
+
+    std::vector<uint8_t> Texture::buildMipChain(const Builder& builder, uint32_t levels, std::vector<VkBufferImageCopy>& regions) {
+        const uint32_t width = builder.width;
+        const uint32_t height = builder.height;
+        std::vector<uint8_t> chain(builder.pixels.begin(), builder.pixels.begin() + static_cast<size_t>(width) * height * 4);
+        regions.push_back(levelRegion(0, 0, width, height));
+
+        // color channels are averaged in linear space, alpha as is
+        bool srgb = isSrgb(builder.format);
+        auto decode = [srgb](uint8_t value) { return srgb ? srgbToLinear(value) : value / 255.f; };
+        auto encode = [srgb](float value) {
+            return srgb ? linearToSrgb(value) : static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+        };
+
+        uint32_t srcWidth = width;
+        uint32_t srcHeight = height;
+        size_t srcOffset = 0;
+        for (uint32_t level = 1; level < levels; ++level) {
+            uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+            uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+            // levels start 16 byte aligned, like a Builder::Level
+            size_t dstOffset = (chain.size() + 15) / 16 * 16;
+            chain.resize(dstOffset + static_cast<size_t>(dstWidth) * dstHeight * 4);
+
+            for (uint32_t y = 0; y < dstHeight; ++y) {
+                // odd sizes: the last row / column is averaged with itself
+                uint32_t y0 = std::min(2 * y, srcHeight - 1);
+                uint32_t y1 = std::min(2 * y + 1, srcHeight - 1);
+                for (uint32_t x = 0; x < dstWidth; ++x) {
+                    uint32_t x0 = std::min(2 * x, srcWidth - 1);
+                    uint32_t x1 = std::min(2 * x + 1, srcWidth - 1);
+                    const uint8_t* texels[4] = {
+                        &chain[srcOffset + (static_cast<size_t>(y0) * srcWidth + x0) * 4],
+                        &chain[srcOffset + (static_cast<size_t>(y0) * srcWidth + x1) * 4],
+                        &chain[srcOffset + (static_cast<size_t>(y1) * srcWidth + x0) * 4],
+                        &chain[srcOffset + (static_cast<size_t>(y1) * srcWidth + x1) * 4]};
+                    uint8_t* out = &chain[dstOffset + (static_cast<size_t>(y) * dstWidth + x) * 4];
+                    for (int c = 0; c < 3; ++c) {
+                        float sum = 0.f;
+                        for (const uint8_t* texel : texels) sum += decode(texel[c]);
+                        out[c] = encode(sum * 0.25f);
+                    }
+                    uint32_t alpha = texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3];
+                    out[3] = static_cast<uint8_t>((alpha + 2) / 4);
+                }
+            }
+
+            regions.push_back(levelRegion(level, dstOffset, dstWidth, dstHeight));
+            srcOffset = dstOffset;
+            srcWidth = dstWidth;
+            srcHeight = dstHeight;
+        }
+        return chain;
+    }
+
+    void Texture::record(const Builder& builder, UploadBatch& upload) {
+        recordBarrier(upload.getCommandBuffer(),
+            layoutBarrier(image, 0, mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                0, VK_ACCESS_TRANSFER_WRITE_BIT),
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        std::vector<VkBufferImageCopy> regions{};
+        std::vector<uint8_t> cpuChain{};
+        const uint8_t* data = builder.pixels.data();
+        VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * 4;
+        if (!builder.levels.empty()) {
+            // staged from firstLevel on, the image level i is level firstLevel + i of the chain
+            size_t base = builder.levels[firstLevel].offset;
+            for (uint32_t level = 0; level < mipLevels; ++level) {
+                const auto& range = builder.levels[firstLevel + level];
+                regions.push_back(levelRegion(level, range.offset - base, range.width, range.height));
+            }
+            data += base;
+            size = builder.pixels.size() - base;
+            ++uploadStats.prebuiltChains;
+        } else if (mipLevels > 1 && !blitMips) {
+            cpuChain = buildMipChain(builder, mipLevels, regions);
+            data = cpuChain.data();
+            size = cpuChain.size();
+            ++uploadStats.cpuMipChains;
+        } else {
+            regions.push_back(levelRegion(0, 0, width, height));
+            if (blitMips) ++uploadStats.gpuMipChains;
+        }
+
+        auto stagingBuffer = std::make_unique<Buffer>(
+            device,
+            size,
+            1,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        stagingBuffer->map();
+        stagingBuffer->writeToBuffer(const_cast<uint8_t*>(data), size);
+        upload.copyBufferToImage(std::move(stagingBuffer), image, regions, {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1});
+        ++uploadStats.textures;
+        uploadStats.stagedBytes += size;
+
+        // by value, the graphics part may be recorded after the batch completed
+        upload.recordOnGraphicsQueue([image = image, width = width, height = height, levels = mipLevels,
+            blit = blitMips](VkCommandBuffer commandBuffer) {
+            if (blit) recordMipBlits(commandBuffer, image, width, height, levels);
+            else recordShaderReadTransition(commandBuffer, image, levels);
+        });
+    }
+}
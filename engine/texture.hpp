@@ -0,0 +1,135 @@
+#pragma once
+
+#include "device.hpp"
+#include "sampler_cache.hpp"
+#include "upload_batch.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+    A sampled 2d image with its full mip chain, uploaded through an UploadBatch
+
+    Like Model, textures created with the same batch share one submission and one fence;
+    without a batch the texture submits its own and waits for it.
+
+    Level 0 is staged and copied, the rest of the chain is made on the gpu where the
+    format can be blitted with linear filtering:
+
+    upload batch  | undefined -> transfer dst (all levels) | copy level 0 |
+    graphics      | level i-1 -> transfer src, blit i-1 -> i, i-1 -> shader read | ... | last -> shader read
+
+    The transfer queue can't blit, so there the graphics part is recorded behind the
+    acquire barriers of the next frame (UploadBatch::recordOnGraphicsQueue). Formats
+    without linear blits get their chain box filtered on the cpu (in linear space for srgb)
+    and every level copied.
+
+    A builder with levels uploads a prebuilt chain as is, one copy region per level, which
+    is how block compressed images (Ktx2Loader) arrive: the gpu can't blit those.
+    firstLevel leaves the finer levels of such a chain out of the image, TextureStreamer
+    builds the same texture at another firstLevel and swaps the images once it is uploaded.
+
+    The texture is ready for descriptor writes right away and for sampling once the batch
+    is complete, the sampler comes from Device::samplerCache().
+*/
+
+namespace engine {
+    class Texture {
+        public:
+            struct Builder {
+                // one level of a prebuilt chain, a range of pixels
+                struct Level {
+                    size_t offset;
+                    size_t size;
+                    uint32_t width;
+                    uint32_t height;
+                };
+
+                uint32_t width = 0;
+                uint32_t height = 0;
+                // tightly packed rows of rgba8 texels, or the levels below in format
+                std::vector<uint8_t> pixels{};
+                // VK_FORMAT_R8G8B8A8_SRGB for colors, VK_FORMAT_R8G8B8A8_UNORM for data
+                VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+                bool mipmaps = true;
+                // level 0 first, offsets aligned to 16 bytes; when set mipmaps is ignored
+                std::vector<Level> levels{};
+                // the finest of levels in the image, the ones before it aren't uploaded
+                uint32_t firstLevel = 0;
+            };
+
+            // summed over every texture since the last resetUploadStats()
+            struct UploadStats {
+                uint32_t textures = 0;
+                VkDeviceSize stagedBytes = 0;
+                // mip chains blitted on the gpu / box filtered on the cpu
+                uint32_t gpuMipChains = 0;
+                uint32_t cpuMipChains = 0;
+                // chains that came with the builder
+                uint32_t prebuiltChains = 0;
+            };
+
+            Texture(Device& device, const Builder& builder, UploadBatch* upload = nullptr);
+            // the image goes through Device::deletionQueue()
+            ~Texture();
+
+            Texture(const Texture&) = delete;
+            Texture& operator=(const Texture&) = delete;
+
+            // a 1x1 texture of one color, e.g. the default for untextured materials
+            static std::unique_ptr<Texture> createSolid(Device& device, const glm::vec4& color, UploadBatch* upload = nullptr);
+            static uint32_t mipLevelCount(uint32_t width, uint32_t height);
+            // the cpu box filtered chain of an rgba8 builder as levels, e.g. for TextureStreamer
+            static Builder buildLevels(const Builder& builder);
+
+            // takes the image of next, a texture built from the same chain at another firstLevel,
+            // next keeps this one's image and hands it to the deletion queue when destroyed
+            void swapImage(Texture& next);
+
+            void setSampler(const SamplerCache::Key& key) { sampler = device.samplerCache().get(key); }
+            // for DescriptorWriter::writeImage on a combined image sampler binding
+            VkDescriptorImageInfo descriptorInfo() const;
+
+            VkImage getImage() const { return image; }
+            VkImageView getImageView() const { return imageView; }
+            VkSampler getSampler() const { return sampler; }
+            VkFormat getFormat() const { return format; }
+            uint32_t getWidth() const { return width; }
+            uint32_t getHeight() const { return height; }
+            // levels in the image, the finest one is getFirstLevel() of the full chain
+            uint32_t getMipLevels() const { return mipLevels; }
+            uint32_t getFirstLevel() const { return firstLevel; }
+            // bumped by swapImage(), descriptors written with an older version show the old image
+            uint32_t getVersion() const { return version; }
+
+            static const UploadStats& getUploadStats() { return uploadStats; }
+            static void resetUploadStats() { uploadStats = UploadStats{}; }
+
+        private:
+            void createImage(VkImageUsageFlags usage);
+            void createImageView();
+            // level 0 followed by the box filtered levels, one copy region per level
+            static std::vector<uint8_t> buildMipChain(const Builder& builder, uint32_t levels, std::vector<VkBufferImageCopy>& regions);
+            // records the layout transitions, the copy and the mip chain into upload
+            void record(const Builder& builder, UploadBatch& upload);
+
+            Device& device;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView imageView = VK_NULL_HANDLE;
+            MemoryAllocator::Allocation allocation{};
+            VkSampler sampler = VK_NULL_HANDLE;
+            VkFormat format;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mipLevels;
+            uint32_t firstLevel = 0;
+            uint32_t version = 0;
+            bool blitMips = false;
+
+            static UploadStats uploadStats;
+    };
+}
@@ -0,0 +1,241 @@
+#include "texture_streamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace engine {
+    TextureStreamer::TextureStreamer(Device& device, VkDeviceSize textureBudget)
+        : device{device}, textureBudget{textureBudget} {}
+
+    TextureStreamer::~TextureStreamer() {
+        // the new images are dropped, their textures keep the old ones
+        for (Upload& upload : uploading) upload.batch->wait();
+    }
+
+    std::shared_ptr<Texture> TextureStreamer::add(Texture::Builder builder, UploadBatch* upload) {
+        if (builder.levels.empty()) throw std::runtime_error("Streamed textures need a prebuilt chain");
+        uint32_t levelCount = static_cast<uint32_t>(builder.levels.size());
+        uint32_t tail = 0;
+        while (tail + 1 < levelCount && std::max(builder.width >> tail, builder.height >> tail) > RESIDENT_TAIL_SIZE) ++tail;
+        builder.firstLevel = tail;
+
+        auto texture = std::make_shared<Texture>(device, builder, upload);
+        // a new texture may have the address of a destroyed one
+        Entry& entry = entries[texture.get()];
+        entry = Entry{};
+        entry.texture = texture;
+        entry.chain = std::move(builder);
+        entry.wantedLevel = tail;
+        entry.wantedFrame = frame;
+        entry.neededLevel = tail;
+        entry.tailLevel = tail;
+        return texture;
+    }
+
+    void TextureStreamer::update(GameObject::Map& gameObjects, const Camera& camera, VkExtent2D extent) {
+        ++frame;
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.texture.expired()) it = entries.erase(it);
+            else ++it;
+        }
+
+        completeUploads();
+        measure(gameObjects, camera, extent);
+        if (isUnderPressure()) dropUnneeded(excessBytes());
+        else streamIn();
+
+        stats.textures = static_cast<uint32_t>(entries.size());
+        stats.pendingRequests = 0;
+        stats.inFlightRequests = 0;
+        stats.residentBytes = 0;
+        stats.fullBytes = 0;
+        for (auto& kv : entries) {
+            const Entry& entry = kv.second;
+            uint32_t firstLevel = entry.texture.lock()->getFirstLevel();
+            if (entry.uploading) ++stats.inFlightRequests;
+            else if (entry.wantedLevel < firstLevel) ++stats.pendingRequests;
+            stats.residentBytes += chainBytes(entry, firstLevel);
+            stats.fullBytes += chainBytes(entry, 0);
+        }
+    }
+
+    void TextureStreamer::completeUploads() {
+        // batches complete in submission order, but checking each one keeps this independent of it
+        auto done = std::remove_if(uploading.begin(), uploading.end(), [&](Upload& upload) {
+            if (!upload.batch->isComplete()) return false;
+            for (auto& swap : upload.swaps) {
+                auto texture = swap.texture.lock();
+                if (texture == nullptr) continue;
+                uint32_t before = texture->getFirstLevel();
+                texture->swapImage(*swap.next);
+                uint32_t after = texture->getFirstLevel();
+                if (after < before) stats.levelsStreamedIn += before - after;
+                else stats.levelsDropped += after - before;
+
+                auto it = entries.find(texture.get());
+                if (it != entries.end() && it->second.texture.lock() == texture) it->second.uploading = false;
+            }
+            // the replaced images go to the deletion queue with the swaps
+            return true;
+        });
+        uploading.erase(done, uploading.end());
+    }
+
+    void TextureStreamer::measure(GameObject::Map& gameObjects, const Camera& camera, VkExtent2D extent) {
+        for (auto& kv : entries) kv.second.neededLevel = kv.second.tailLevel;
+
+        /*
+        a bounding sphere of radius r at distance d covers
+        2r * projection[1][1] / d * height / 2 pixels (perspective, without the divide for orthographic),
+        the texture is taken to span the object once, so level l has enough texels while
+        size >> l >= pixels
+         */
+        const glm::mat4& projection = camera.getProjection();
+        bool perspective = projection[2][3] != 0.f;
+        float pixelsPerUnit = glm::abs(projection[1][1]) * 0.5f * static_cast<float>(extent.height);
+        Frustum frustum = camera.getFrustum();
+        for (auto& kv : gameObjects) {
+            GameObject& obj = kv.second;
+            if (obj.texture == nullptr || obj.model == nullptr) continue;
+            auto it = entries.find(obj.texture.get());
+            if (it == entries.end()) continue;
+            Entry& entry = it->second;
+
+            const glm::vec3& scale = obj.transform3d.scale;
+            float radius = obj.model->getBoundsRadius() *
+                glm::max(glm::abs(scale.x), glm::max(glm::abs(scale.y), glm::abs(scale.z)));
+            glm::vec3 center = glm::vec3{obj.transform3d.mat4() * glm::vec4{obj.model->getBoundsCenter(), 1.f}};
+            if (!frustum.intersectsSphere(center, radius)) continue;
+
+            float pixels = 2.f * radius * pixelsPerUnit;
+            if (perspective) {
+                float distance = glm::length(center - camera.getPosition()) - radius;
+                // inside the bounding sphere every texel may be visible
+                pixels = distance > 0.f ? pixels / distance : std::numeric_limits<float>::max();
+            }
+            float texels = static_cast<float>(std::max(entry.chain.width, entry.chain.height));
+            uint32_t level = 0;
+            if (pixels < texels) level = static_cast<uint32_t>(std::log2(texels / std::max(pixels, 1.f)));
+            entry.neededLevel = std::min(entry.neededLevel, level);
+        }
+
+        // finer levels are wanted right away, coarser ones after MIN_IDLE_FRAMES
+        for (auto& kv : entries) {
+            Entry& entry = kv.second;
+            if (entry.neededLevel <= entry.wantedLevel || frame - entry.wantedFrame >= MIN_IDLE_FRAMES) {
+                entry.wantedLevel = entry.neededLevel;
+                entry.wantedFrame = frame;
+            }
+        }
+    }
+
+    VkDeviceSize TextureStreamer::chainBytes(const Entry& entry, uint32_t firstLevel) {
+        VkDeviceSize bytes = 0;
+        for (size_t level = firstLevel; level < entry.chain.levels.size(); ++level) bytes += entry.chain.levels[level].size;
+        return bytes;
+    }
+
+    VkDeviceSize TextureStreamer::residentBytes() const {
+        VkDeviceSize bytes = 0;
+        for (const auto& kv : entries) {
+            auto texture = kv.second.texture.lock();
+            if (texture != nullptr) bytes += chainBytes(kv.second, texture->getFirstLevel());
+        }
+        return bytes;
+    }
+
+    bool TextureStreamer::isUnderPressure() const {
+        if (textureBudget > 0 && residentBytes() > static_cast<VkDeviceSize>(textureBudget * PRESSURE)) return true;
+        for (const auto& heap : device.allocator().getHeapBudgets()) {
+            if (heap.deviceLocal && heap.usage > static_cast<VkDeviceSize>(heap.budget * PRESSURE)) return true;
+        }
+        return false;
+    }
+
+    VkDeviceSize TextureStreamer::excessBytes() const {
+        VkDeviceSize excess = 0;
+        if (textureBudget > 0) {
+            VkDeviceSize target = static_cast<VkDeviceSize>(textureBudget * TARGET);
+            VkDeviceSize resident = residentBytes();
+            if (resident > target) excess = resident - target;
+        }
+        for (const auto& heap : device.allocator().getHeapBudgets()) {
+            VkDeviceSize target = static_cast<VkDeviceSize>(heap.budget * TARGET);
+            if (heap.deviceLocal && heap.usage > target) excess = std::max(excess, heap.usage - target);
+        }
+        return excess;
+    }
+
+    void TextureStreamer::dropUnneeded(VkDeviceSize bytes) {
+        std::vector<std::pair<VkDeviceSize, Entry*>> candidates;
+        for (auto& kv : entries) {
+            Entry& entry = kv.second;
+            uint32_t firstLevel = entry.texture.lock()->getFirstLevel();
+            if (entry.uploading || firstLevel >= entry.wantedLevel) continue;
+            candidates.emplace_back(chainBytes(entry, firstLevel) - chainBytes(entry, entry.wantedLevel), &entry);
+        }
+        // the largest savings first, so few textures are uploaded again
+        std::sort(candidates.begin(), candidates.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        Upload upload{std::make_unique<UploadBatch>(device)};
+        VkDeviceSize dropped = 0;
+        for (auto& candidate : candidates) {
+            if (dropped >= bytes) break;
+            Entry& entry = *candidate.second;
+            request(entry, entry.texture.lock(), entry.wantedLevel, upload);
+            dropped += candidate.first;
+        }
+        if (!upload.swaps.empty()) {
+            upload.batch->submit();
+            uploading.push_back(std::move(upload));
+        }
+    }
+
+    void TextureStreamer::streamIn() {
+        std::vector<std::pair<uint32_t, Entry*>> candidates;
+        for (auto& kv : entries) {
+            Entry& entry = kv.second;
+            uint32_t firstLevel = entry.texture.lock()->getFirstLevel();
+            if (entry.uploading || entry.wantedLevel >= firstLevel) continue;
+            candidates.emplace_back(firstLevel - entry.wantedLevel, &entry);
+        }
+        if (candidates.empty()) return;
+        // the most levels missing first
+        std::stable_sort(candidates.begin(), candidates.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        Upload upload{std::make_unique<UploadBatch>(device)};
+        VkDeviceSize resident = residentBytes();
+        VkDeviceSize uploadBytes = 0;
+        for (auto& candidate : candidates) {
+            Entry& entry = *candidate.second;
+            auto texture = entry.texture.lock();
+            uint32_t firstLevel = texture->getFirstLevel();
+            // as fine as the frame's upload limit allows, the first request of a frame may exceed it
+            uint32_t level = entry.wantedLevel;
+            while (level + 1 < firstLevel && uploadBytes + chainBytes(entry, level) > MAX_UPLOAD_BYTES_PER_FRAME) ++level;
+            VkDeviceSize bytes = chainBytes(entry, level);
+            if (uploadBytes > 0 && uploadBytes + bytes > MAX_UPLOAD_BYTES_PER_FRAME) break;
+            VkDeviceSize growth = bytes - chainBytes(entry, firstLevel);
+            if (textureBudget > 0 && resident + growth > static_cast<VkDeviceSize>(textureBudget * PRESSURE)) continue;
+
+            request(entry, texture, level, upload);
+            resident += growth;
+            uploadBytes += bytes;
+        }
+        if (!upload.swaps.empty()) {
+            upload.batch->submit();
+            uploading.push_back(std::move(upload));
+        }
+    }
+
+    void TextureStreamer::request(Entry& entry, const std::shared_ptr<Texture>& texture, uint32_t firstLevel, Upload& upload) {
+        entry.chain.firstLevel = firstLevel;
+        upload.swaps.push_back(Upload::Swap{texture, std::make_unique<Texture>(device, entry.chain, upload.batch.get())});
+        entry.uploading = true;
+        stats.uploadedBytes += chainBytes(entry, firstLevel);
+    }
+}
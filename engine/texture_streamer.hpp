@@ -0,0 +1,126 @@
+#pragma once
+
+#include "camera.hpp"
+#include "device.hpp"
+#include "game_object.hpp"
+#include "texture.hpp"
+#include "upload_batch.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Keeps only the mip levels of textures on the gpu that their objects are drawn with
+
+    add() takes a texture with a prebuilt chain (Ktx2Loader::prepare), uploads the coarse
+    tail (levels up to RESIDENT_TAIL_SIZE texels) and keeps the whole chain in host memory.
+    update() runs once a frame, before Renderer::beginFrame, and
+
+    - swaps in the images whose uploads completed (Texture::swapImage), never waiting
+    - sizes every texture by the objects using it: the finest level an object needs has
+      about as many texels across as its bounding sphere covers pixels on screen
+      (Camera projection, Transform3dComponent translation and scale). Objects outside the
+      frustum need nothing, a level stays wanted for MIN_IDLE_FRAMES after its last use
+    - under pressure (ResidencyManager's rule: a device local heap or the texture budget over
+      PRESSURE) drops the levels finer than wanted, down to TARGET
+    - otherwise streams in the levels wanted and missing, most blurred texture first, at
+      most MAX_UPLOAD_BYTES_PER_FRAME a frame; a request that doesn't fit the budget stays
+      pending
+
+    frame   | 10                 | 11          | 12                          |
+    texture | wants level 2 of 0 | upload runs | complete: swapped, drawn    |
+            | new image, submit  |             | old image -> deletion queue |
+
+    A level change builds the texture again at the new first level in a new image, the
+    levels both images share are uploaded from the host chain again. Textures are tracked
+    through weak pointers, destroyed textures are dropped.
+*/
+
+namespace engine {
+    class TextureStreamer {
+        public:
+            // levels this size and smaller are resident from the start
+            static constexpr uint32_t RESIDENT_TAIL_SIZE = 64;
+            // fraction of a budget that starts dropping levels, and the one dropping goes down to
+            static constexpr float PRESSURE = 0.9f;
+            static constexpr float TARGET = 0.8f;
+            // a finer level stays wanted this long after its last use, against streaming it twice
+            static constexpr uint64_t MIN_IDLE_FRAMES = 120;
+            static constexpr VkDeviceSize MAX_UPLOAD_BYTES_PER_FRAME = 16 * 1024 * 1024;
+
+            struct Stats {
+                uint64_t levelsStreamedIn = 0;
+                uint64_t levelsDropped = 0;
+                VkDeviceSize uploadedBytes = 0;
+                // current state of the tracked textures
+                uint32_t textures = 0;
+                // wanted levels not requested yet (budget, upload limit) and uploads in flight
+                uint32_t pendingRequests = 0;
+                uint32_t inFlightRequests = 0;
+                VkDeviceSize residentBytes = 0;
+                // what every level of every texture would take
+                VkDeviceSize fullBytes = 0;
+            };
+
+            // textureBudget 0: only the heap budgets count
+            TextureStreamer(Device& device, VkDeviceSize textureBudget = 0);
+            // waits for the uploads in flight
+            ~TextureStreamer();
+
+            TextureStreamer(const TextureStreamer&) = delete;
+            TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+            // the coarse tail of builder's levels is recorded into upload (or uploaded right away)
+            std::shared_ptr<Texture> add(Texture::Builder builder, UploadBatch* upload = nullptr);
+            void update(GameObject::Map& gameObjects, const Camera& camera, VkExtent2D extent);
+
+            bool isUnderPressure() const;
+            void setTextureBudget(VkDeviceSize budget) { textureBudget = budget; }
+            const Stats& getStats() const { return stats; }
+
+        private:
+            struct Entry {
+                std::weak_ptr<Texture> texture;
+                // the whole chain, firstLevel is ignored
+                Texture::Builder chain;
+                // finest level wanted, and when an object last needed it
+                uint32_t wantedLevel;
+                uint64_t wantedFrame = 0;
+                // finest level the objects need this frame
+                uint32_t neededLevel;
+                // coarsest first level, the tail stays resident
+                uint32_t tailLevel;
+                bool uploading = false;
+            };
+
+            // the new images one batch carries
+            struct Upload {
+                std::unique_ptr<UploadBatch> batch;
+                struct Swap {
+                    std::weak_ptr<Texture> texture;
+                    std::unique_ptr<Texture> next;
+                };
+                std::vector<Swap> swaps{};
+            };
+
+            void completeUploads();
+            void measure(GameObject::Map& gameObjects, const Camera& camera, VkExtent2D extent);
+            // bytes to free to get every budget down to TARGET
+            VkDeviceSize excessBytes() const;
+            VkDeviceSize residentBytes() const;
+            void dropUnneeded(VkDeviceSize bytes);
+            void streamIn();
+            // records texture at firstLevel into batch, swapped in once it completed
+            void request(Entry& entry, const std::shared_ptr<Texture>& texture, uint32_t firstLevel, Upload& upload);
+            // bytes of the chain from firstLevel on
+            static VkDeviceSize chainBytes(const Entry& entry, uint32_t firstLevel);
+
+            Device& device;
+            VkDeviceSize textureBudget;
+            uint64_t frame = 0;
+            std::unordered_map<const Texture*, Entry> entries{};
+            std::vector<Upload> uploading{};
+            Stats stats{};
+    };
+}
@@ -0,0 +1,227 @@
+#include "upload_batch.hpp"
+
+#include <stdexcept>
+
+namespace engine {
+    UploadBatch::UploadBatch(Device& device, bool graphicsQueue)
+        : device{device}, onTransferQueue{device.hasTransferQueue() && !graphicsQueue} {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool();
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate upload command buffer");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    }
+
+    UploadBatch::~UploadBatch() {
+        if (submitted && !complete) wait();
+        if (fence != VK_NULL_HANDLE) vkDestroyFence(device.device(), fence, nullptr);
+        vkFreeCommandBuffers(device.device(), commandPool(), 1, &commandBuffer);
+    }
+
+    VkCommandPool UploadBatch::commandPool() const {
+        return onTransferQueue ? device.getTransferCommandPool() : device.getCommandPool();
+    }
+
+    void UploadBatch::copyBuffer(std::unique_ptr<Buffer> source, Buffer& destination, VkDeviceSize offset, VkDeviceSize size) {
+        if (submitted) throw std::runtime_error("Upload batch was already submitted");
+
+        VkBufferCopy copyRegion{};
+        copyRegion.dstOffset = offset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(commandBuffer, source->getBuffer(), destination.getBuffer(), 1, &copyRegion);
+
+        if (onTransferQueue && destination.getSharingMode() == VK_SHARING_MODE_EXCLUSIVE) {
+            VkBufferMemoryBarrier release{};
+            release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.srcQueueFamilyIndex = device.transferQueueFamily();
+            release.dstQueueFamilyIndex = device.graphicsQueueFamily();
+            release.buffer = destination.getBuffer();
+            release.offset = offset;
+            release.size = size;
+            bufferReleases.push_back(release);
+
+            VkBufferMemoryBarrier acquire = release;
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            bufferAcquires.push_back(acquire);
+        }
+
+        ++copyCount;
+        stagingBytes += source->getBufferSize();
+        staging.push_back(std::move(source));
+    }
+
+    void UploadBatch::copyToHost(Buffer& source, VkDeviceSize offset, VkDeviceSize size, Buffer& destination) {
+        if (submitted) throw std::runtime_error("Upload batch was already submitted");
+        if (onTransferQueue && source.getSharingMode() == VK_SHARING_MODE_EXCLUSIVE) {
+            throw std::runtime_error("Exclusive buffers are read back on the graphics queue");
+        }
+
+        // earlier copies into the source (uploads, relocations) land before it is read
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = offset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(commandBuffer, source.getBuffer(), destination.getBuffer(), 1, &copyRegion);
+        hostReads = true;
+        ++copyCount;
+    }
+
+    void UploadBatch::copyBufferToImage(std::unique_ptr<Buffer> source, VkImage image,
+        uint32_t width, uint32_t height, uint32_t layerCount) {
+        // same region as Device::copyBufferToImage
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = layerCount;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {width, height, 1};
+
+        VkImageSubresourceRange range{};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.baseMipLevel = 0;
+        range.levelCount = 1;
+        range.baseArrayLayer = 0;
+        range.layerCount = layerCount;
+        copyBufferToImage(std::move(source), image, {region}, range);
+    }
+
+    void UploadBatch::copyBufferToImage(std::unique_ptr<Buffer> source, VkImage image,
+        const std::vector<VkBufferImageCopy>& regions, const VkImageSubresourceRange& range) {
+        if (submitted) throw std::runtime_error("Upload batch was already submitted");
+
+        vkCmdCopyBufferToImage(commandBuffer, source->getBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+
+        if (onTransferQueue) {
+            // the layout stays, the graphics side transitions the image once it owns it
+            VkImageMemoryBarrier release{};
+            release.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            release.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            release.srcQueueFamilyIndex = device.transferQueueFamily();
+            release.dstQueueFamilyIndex = device.graphicsQueueFamily();
+            release.image = image;
+            release.subresourceRange = range;
+            imageReleases.push_back(release);
+
+            VkImageMemoryBarrier acquire = release;
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+            imageAcquires.push_back(acquire);
+        }
+
+        copyCount += static_cast<uint32_t>(regions.size());
+        stagingBytes += source->getBufferSize();
+        staging.push_back(std::move(source));
+    }
+
+    void UploadBatch::recordOnGraphicsQueue(std::function<void(VkCommandBuffer)> record) {
+        if (submitted) throw std::runtime_error("Upload batch was already submitted");
+        if (onTransferQueue) graphicsWork.push_back(std::move(record));
+        else record(commandBuffer);
+    }
+
+    void UploadBatch::submit() {
+        if (submitted) throw std::runtime_error("Upload batch was already submitted");
+
+        if (onTransferQueue) {
+            // the transfer queue has no vertex or shader stages, visibility comes with the timeline wait
+            if (!bufferReleases.empty() || !imageReleases.empty()) {
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                    0, nullptr,
+                    static_cast<uint32_t>(bufferReleases.size()), bufferReleases.data(),
+                    static_cast<uint32_t>(imageReleases.size()), imageReleases.data());
+            }
+        } else {
+            // the copies have to land before any later submission reads them as vertices, indices or textures
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        if (hostReads) {
+            // the fence orders the read backs before the host, the barrier makes them visible to it
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        vkEndCommandBuffer(commandBuffer);
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload fence");
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        VkQueue queue = device.graphicsQueue();
+        VkSemaphore timeline = VK_NULL_HANDLE;
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        if (onTransferQueue) {
+            queue = device.transferQueue();
+            timeline = device.transferTimeline();
+            timelineValue = device.nextTransferValue();
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &timelineValue;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &timeline;
+        }
+        if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload batch");
+        }
+        submitted = true;
+    }
+
+    bool UploadBatch::isComplete() {
+        if (!submitted) return false;
+        if (!complete && vkGetFenceStatus(device.device(), fence) == VK_SUCCESS) release();
+        return complete;
+    }
+
+    void UploadBatch::wait() {
+        if (!submitted) throw std::runtime_error("Upload batch was never submitted");
+        if (complete) return;
+        vkWaitForFences(device.device(), 1, &fence, VK_TRUE, UINT64_MAX);
+        release();
+    }
+
+    void UploadBatch::release() {
+        if (onTransferQueue) {
+            device.completeTransfer(timelineValue, bufferAcquires, imageAcquires, graphicsWork);
+        }
+        // the transfer queue finishing says nothing about the frames still reading a replaced
+        // buffer, Buffer's destructor defers to the deletion queue
+        staging.clear();
+        complete = true;
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "buffer.hpp"
+#include "device.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+    Collects any number of staging copies into one command buffer, submitted once with one fence
+
+    Device::copyBuffer / copyBufferToImage submit and wait for the queue per call, so a
+    scene of N models paid 2N full gpu round trips. A batch records every copy, then
+    submit() hands them to the graphics queue in one go and only the fence says when
+    the staging buffers may go.
+
+    UploadBatch batch{device};
+    Model a{device, builderA, layout, batch};   // records, doesn't wait
+    Model b{device, builderB, layout, batch};
+    batch.submit();
+    ...
+    batch.isComplete() or batch.wait()         // releases the staging buffers
+
+    On the graphics queue the batch ends with a barrier making the copies visible to vertex
+    input and shaders, later submissions can use the data without waiting on the fence.
+
+    When the device has a dedicated transfer queue the batch is submitted there instead and
+    runs alongside the frames. Exclusive destinations are released to the graphics family at
+    the end of the batch, the submission signals the device's timeline semaphore, and once
+    the batch is complete the matching acquire barriers are handed to the device. The next
+    frame records them and its submission waits for the timeline value:
+
+    transfer queue | copies, release | signal N |
+    graphics queue | frame | frame | frame        | wait N, acquire, frame |
+    host                            isComplete() -^
+
+    Use the data only after isComplete() / wait(), concurrent buffers (the geometry pool)
+    skip the ownership transfer but still rely on the timeline wait.
+
+    copyToHost() goes the other way, into a host visible buffer the host reads once the batch
+    completed (Model eviction). Buffers the graphics family owns are read back by a batch created
+    with graphicsQueue, which skips the transfer queue.
+*/
+
+namespace engine {
+    class UploadBatch {
+        public:
+            // graphicsQueue submits on the graphics queue even when the device has a transfer queue
+            UploadBatch(Device& device, bool graphicsQueue = false);
+            // waits for a submitted batch, an unsubmitted one is dropped without running
+            ~UploadBatch();
+
+            UploadBatch(const UploadBatch&) = delete;
+            UploadBatch& operator=(const UploadBatch&) = delete;
+
+            // the staging buffer is kept until the copy finished
+            void copyBuffer(std::unique_ptr<Buffer> source, Buffer& destination, VkDeviceSize offset, VkDeviceSize size);
+            // the image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, e.g. through a barrier
+            // recorded into getCommandBuffer() first
+            void copyBufferToImage(std::unique_ptr<Buffer> source, VkImage image,
+                uint32_t width, uint32_t height, uint32_t layerCount);
+            // any number of regions (e.g. one per mip level), range is handed to the graphics family as a whole
+            void copyBufferToImage(std::unique_ptr<Buffer> source, VkImage image,
+                const std::vector<VkBufferImageCopy>& regions, const VkImageSubresourceRange& range);
+            // destination is host visible, its contents are valid once the batch completed; on the
+            // transfer queue the source has to be concurrent
+            void copyToHost(Buffer& source, VkDeviceSize offset, VkDeviceSize size, Buffer& destination);
+            // graphics commands on uploaded images (mip blits, the transition to the sampled layout):
+            // recorded into this batch on the graphics queue, behind the acquire barriers of the next
+            // graphics submission after completion on the transfer queue
+            void recordOnGraphicsQueue(std::function<void(VkCommandBuffer)> record);
+            // keeps a buffer alive until the batch finished, e.g. the source of a recorded copy
+            void keepAlive(std::unique_ptr<Buffer> buffer) { staging.push_back(std::move(buffer)); }
+
+            // for barriers and copies the helpers above don't cover, only while recording
+            VkCommandBuffer getCommandBuffer() const { return commandBuffer; }
+
+            void submit();
+            // non-blocking, releases the staging buffers once the fence signaled
+            bool isComplete();
+            void wait();
+
+            bool isRecording() const { return !submitted; }
+            // on the dedicated transfer queue, see above
+            bool usesTransferQueue() const { return onTransferQueue; }
+            uint32_t getCopyCount() const { return copyCount; }
+            VkDeviceSize getStagingBytes() const { return stagingBytes; }
+
+        private:
+            void release();
+            VkCommandPool commandPool() const;
+
+            Device& device;
+            bool onTransferQueue;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            uint64_t timelineValue = 0;
+            bool submitted = false;
+            bool complete = false;
+            // copyToHost() was called, the batch ends with a barrier to the host
+            bool hostReads = false;
+
+            // ownership transfers of exclusive destinations, recorded here and on the graphics queue
+            std::vector<VkBufferMemoryBarrier> bufferReleases{};
+            std::vector<VkBufferMemoryBarrier> bufferAcquires{};
+            std::vector<VkImageMemoryBarrier> imageReleases{};
+            std::vector<VkImageMemoryBarrier> imageAcquires{};
+            std::vector<std::function<void(VkCommandBuffer)>> graphicsWork{};
+
+            std::vector<std::unique_ptr<Buffer>> staging{};
+            uint32_t copyCount = 0;
+            VkDeviceSize stagingBytes = 0;
+    };
+}
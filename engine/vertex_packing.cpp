@@ -0,0 +1,120 @@
+#include "vertex_packing.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace engine {
+    namespace {
+        struct Bounds {
+            glm::vec3 center{};
+            glm::vec3 halfExtent{};
+        };
+
+        Bounds computeBounds(const Model::Vertex* vertices, uint32_t vertexCount) {
+            glm::vec3 min{std::numeric_limits<float>::max()};
+            glm::vec3 max{std::numeric_limits<float>::lowest()};
+            for (uint32_t i = 0; i < vertexCount; ++i) {
+                min = glm::min(min, vertices[i].position);
+                max = glm::max(max, vertices[i].position);
+            }
+
+            Bounds bounds{};
+            bounds.center = (min + max) * 0.5f;
+            bounds.halfExtent = (max - min) * 0.5f;
+            // a flat mesh has no extent along one axis, any scale works there
+            for (int axis = 0; axis < 3; ++axis) {
+                if (bounds.halfExtent[axis] <= 0.f) bounds.halfExtent[axis] = 1.f;
+            }
+            return bounds;
+        }
+
+        int16_t toSnorm16(float value) {
+            return static_cast<int16_t>(std::round(glm::clamp(value, -1.f, 1.f) * 32767.f));
+        }
+
+        float signNotZero(float value) { return value >= 0.f ? 1.f : -1.f; }
+
+        bool inUnitRange(const glm::vec3& color) {
+            return color.x >= 0.f && color.x <= 1.f && color.y >= 0.f && color.y <= 1.f && color.z >= 0.f && color.z <= 1.f;
+        }
+
+        // fills the attributes both packed layouts share
+        template <typename PackedT>
+        void packAttributes(const Model::Vertex& vertex, PackedT& packed) {
+            packed.color = glm::packUnorm4x8(glm::vec4{vertex.color, 1.f});
+            packed.normal = VertexPacking::encodeNormal(vertex.normal);
+            packed.uv = glm::packHalf2x16(vertex.uv);
+        }
+    }
+
+    Model::VertexLayout VertexPacking::chooseLayout(const Model::Vertex* vertices, uint32_t vertexCount) {
+        for (uint32_t i = 0; i < vertexCount; ++i) {
+            const auto& vertex = vertices[i];
+            // hdr colors don't fit unorm8, a zero normal has no octahedral encoding
+            if (!inUnitRange(vertex.color)) return Model::VertexLayout::Standard;
+            if (!(glm::dot(vertex.normal, vertex.normal) > 0.f)) return Model::VertexLayout::Standard;
+            if (!(std::abs(vertex.uv.x) <= MAX_PACKED_UV && std::abs(vertex.uv.y) <= MAX_PACKED_UV)) {
+                return Model::VertexLayout::Standard;
+            }
+        }
+
+        // half of a snorm16 step along the longest axis is the worst position error
+        Bounds bounds = computeBounds(vertices, vertexCount);
+        float maxHalfExtent = std::max({bounds.halfExtent.x, bounds.halfExtent.y, bounds.halfExtent.z});
+        if (maxHalfExtent / 32767.f * 0.5f <= MAX_POSITION_ERROR) return Model::VertexLayout::PackedQuantized;
+        return Model::VertexLayout::Packed;
+    }
+
+    std::vector<Model::PackedVertex> VertexPacking::pack(const Model::Vertex* vertices, uint32_t vertexCount) {
+        std::vector<Model::PackedVertex> packed(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; ++i) {
+            packed[i].position = vertices[i].position;
+            packAttributes(vertices[i], packed[i]);
+        }
+        return packed;
+    }
+
+    std::vector<Model::QuantizedVertex> VertexPacking::quantize(
+        const Model::Vertex* vertices, uint32_t vertexCount, glm::mat4& dequantize) {
+        Bounds bounds = computeBounds(vertices, vertexCount);
+
+        std::vector<Model::QuantizedVertex> quantized(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; ++i) {
+            glm::vec3 normalized = (vertices[i].position - bounds.center) / bounds.halfExtent;
+            quantized[i].position[0] = toSnorm16(normalized.x);
+            quantized[i].position[1] = toSnorm16(normalized.y);
+            quantized[i].position[2] = toSnorm16(normalized.z);
+            packAttributes(vertices[i], quantized[i]);
+        }
+
+        // snorm [-1, 1] -> [center - halfExtent, center + halfExtent]
+        dequantize = glm::scale(glm::translate(glm::mat4{1.f}, bounds.center), bounds.halfExtent);
+        return quantized;
+    }
+
+    uint32_t VertexPacking::encodeNormal(glm::vec3 normal) {
+        // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one
+        normal /= std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        glm::vec2 encoded{normal.x, normal.y};
+        if (normal.z < 0.f) {
+            encoded = {
+                (1.f - std::abs(normal.y)) * signNotZero(normal.x),
+                (1.f - std::abs(normal.x)) * signNotZero(normal.y)};
+        }
+        return glm::packSnorm2x16(encoded);
+    }
+
+    glm::vec3 VertexPacking::decodeNormal(uint32_t encoded) {
+        // same as octDecode in simple_shader_packed.vert
+        glm::vec2 e = glm::unpackSnorm2x16(encoded);
+        glm::vec3 normal{e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y)};
+        float t = std::max(-normal.z, 0.f);
+        normal.x += normal.x >= 0.f ? -t : t;
+        normal.y += normal.y >= 0.f ? -t : t;
+        return glm::normalize(normal);
+    }
+}
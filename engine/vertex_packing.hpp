@@ -0,0 +1,43 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <vector>
+
+/*
+    Conversion from Model::Vertex (44 bytes) to the compact gpu layouts
+
+    Packed (24 bytes)          | PackedQuantized (20 bytes)
+    ---------------------------|------------------------------------------
+    position  3 x float32      | 4 x snorm16, scaled into the mesh bounds
+    color     4 x unorm8       | 4 x unorm8
+    normal    2 x snorm16 (octahedral encoding, decoded in the vertex shader)
+    uv        2 x float16      | 2 x float16
+
+    Quantized positions are mapped back to model space by Model::getDequantizeMatrix(),
+    which the render system folds into the model matrix, so the shader only has to
+    decode the normal (shader/simple_shader_packed.vert).
+
+    chooseLayout() keeps the Standard layout whenever packing would visibly change the
+    mesh: colors outside [0, 1], missing normals, or uvs too large for half floats.
+*/
+
+namespace engine {
+    class VertexPacking {
+        public:
+            // largest uv coordinate stored as a half float, keeps the uv step below 1/256
+            static constexpr float MAX_PACKED_UV = 8.f;
+            // largest position error (model units) accepted for 16-bit positions
+            static constexpr float MAX_POSITION_ERROR = 5e-4f;
+
+            static Model::VertexLayout chooseLayout(const Model::Vertex* vertices, uint32_t vertexCount);
+
+            static std::vector<Model::PackedVertex> pack(const Model::Vertex* vertices, uint32_t vertexCount);
+            // dequantize receives the matrix mapping the snorm16 positions back to model space
+            static std::vector<Model::QuantizedVertex> quantize(
+                const Model::Vertex* vertices, uint32_t vertexCount, glm::mat4& dequantize);
+
+            static uint32_t encodeNormal(glm::vec3 normal);
+            static glm::vec3 decodeNormal(uint32_t encoded);
+    };
+}
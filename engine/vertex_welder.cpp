@@ -0,0 +1,76 @@
+#include "vertex_welder.hpp"
+
+#include <cstring>
+
+namespace engine {
+    namespace {
+        constexpr size_t VERTEX_WORDS = sizeof(Model::Vertex) / sizeof(uint32_t);
+        static_assert(sizeof(Model::Vertex) == VERTEX_WORDS * sizeof(uint32_t), "Vertex must not contain padding");
+
+        constexpr size_t MIN_CAPACITY = 64;
+
+        size_t capacityFor(size_t vertexCount) {
+            // keep the table at most half full
+            size_t capacity = MIN_CAPACITY;
+            while (capacity < vertexCount * 2) capacity *= 2;
+            return capacity;
+        }
+    }
+
+    VertexWelder::VertexWelder(std::vector<Model::Vertex>& vertices, size_t expectedVertices)
+        : vertices{vertices} {
+        rehash(capacityFor(expectedVertices));
+    }
+
+    uint32_t VertexWelder::hash(const Model::Vertex& vertex) {
+        uint32_t words[VERTEX_WORDS];
+        std::memcpy(words, &vertex, sizeof(words));
+
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (uint32_t word : words) {
+            // -0.0f == +0.0f, so they have to land in the same bucket
+            if (word == 0x80000000u) word = 0;
+            h = (h ^ word) * 0x100000001b3ull;
+        }
+        // murmur3 finalizer, the low bits pick the bucket
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return static_cast<uint32_t>(h);
+    }
+
+    uint32_t VertexWelder::weld(const Model::Vertex& vertex) {
+        uint32_t h = hash(vertex);
+        size_t slot = h & mask;
+        while (slots[slot].index != EMPTY) {
+            if (slots[slot].hash == h && vertices[slots[slot].index] == vertex) {
+                return slots[slot].index;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        // only vertices appended by this welder are matched against, like the old per-call map
+        uint32_t index = static_cast<uint32_t>(vertices.size());
+        vertices.push_back(vertex);
+        slots[slot] = {h, index};
+        ++count;
+
+        if (count * 2 > slots.size()) rehash(slots.size() * 2);
+        return index;
+    }
+
+    void VertexWelder::rehash(size_t capacity) {
+        std::vector<Slot> old = std::move(slots);
+        slots.assign(capacity, Slot{0, EMPTY});
+        mask = capacity - 1;
+
+        for (const Slot& entry : old) {
+            if (entry.index == EMPTY) continue;
+            size_t slot = entry.hash & mask;
+            while (slots[slot].index != EMPTY) slot = (slot + 1) & mask;
+            slots[slot] = entry;
+        }
+    }
+}
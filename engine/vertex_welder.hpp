@@ -0,0 +1,51 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/*
+    Vertex deduplication ("welding") for Model::Builder::loadModel
+
+    Every face corner of an .obj becomes a full Vertex, most of which are
+    duplicates of a corner seen before. weld() returns the index of the
+    matching unique vertex, appending the corner to the output first if it is
+    new, so the resulting vertex/index buffers are the same as the ones the
+    old std::unordered_map<Vertex, uint32_t> pass produced.
+
+    The table is open addressing with linear probing: one flat array of
+    {hash, vertex index} slots, no per-entry allocation and a single probe
+    sequence per corner. Vertices are hashed as 11 raw 32-bit words with
+    -0.0f folded into +0.0f, so corners that compare equal always hash equal.
+*/
+
+namespace engine {
+    class VertexWelder {
+        public:
+            // expectedVertices sizes the table up front, it grows on demand either way
+            VertexWelder(std::vector<Model::Vertex>& vertices, size_t expectedVertices = 0);
+
+            VertexWelder(const VertexWelder&) = delete;
+            VertexWelder& operator=(const VertexWelder&) = delete;
+
+            uint32_t weld(const Model::Vertex& vertex);
+
+            static uint32_t hash(const Model::Vertex& vertex);
+
+        private:
+            struct Slot {
+                uint32_t hash;
+                uint32_t index;  // EMPTY if the slot is unused
+            };
+
+            static constexpr uint32_t EMPTY = UINT32_MAX;
+
+            void rehash(size_t capacity);
+
+            std::vector<Model::Vertex>& vertices;
+            std::vector<Slot> slots;
+            size_t mask = 0;
+            size_t count = 0;
+    };
+}
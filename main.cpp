@@ -2,9 +2,22 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <string>
 
-int main() {
-    engine::TestApp app{};
+int main(int argc, char** argv) {
+    engine::TestApp::Options options{};
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--defrag-demo") {
+            options.defragDemo = true;
+        } else if (arg == "--shading-bench") {
+            options.shadingBench = true;
+        } else {
+            std::cerr << "unknown option " << arg << ", usage: ZZYEngine [--defrag-demo] [--shading-bench]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    engine::TestApp app{options};
 
     try {
         app.run();
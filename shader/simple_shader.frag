@@ -3,6 +3,7 @@
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 worldFragPos;
 layout(location = 2) in vec3 worldFragNormal;
+layout(location = 3) in vec2 fragUv;
 
 layout(location = 0) out vec4 outColor;
 
@@ -25,6 +26,18 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     int numLights;
 } ubo;
 
+// for descriptor set 1 binding 0, a white texel for untextured objects
+layout(set = 1, binding = 0) uniform sampler2D materialTexture;
+
+// set per pipeline, see SimpleRenderSystem::ShadingVariant; the defaults are the generic shader
+// lights the loop runs over, at most the 10 of the ubo
+layout(constant_id = 0) const int MAX_LIGHTS = 10;
+// the loop runs exactly MAX_LIGHTS times, ubo.numLights isn't read
+layout(constant_id = 1) const bool EXACT_LIGHT_COUNT = false;
+layout(constant_id = 2) const bool SPECULAR = true;
+// higher p => sharper highlight
+layout(constant_id = 3) const float SHININESS = 512.0;
+
 // push constant only support 128 bytes => 32 floats => 2 mat4
 layout(push_constant) uniform Push{
     mat4 modelMatrix; // projection * view * model
@@ -45,7 +58,9 @@ void main() {
     vec3 worldCameraPos = ubo.inverseView[3].xyz;
     vec3 viewDirection = normalize(worldCameraPos - worldFragPos);
 
-    for (int i=0; i<ubo.numLights; ++i) {
+    // a constant trip count lets the compiler unroll the loop and drop the specular terms
+    for (int i=0; i<MAX_LIGHTS; ++i) {
+        if (!EXACT_LIGHT_COUNT && i >= ubo.numLights) break;
         PointLight light = ubo.pointLights[i];
         vec3 directionToLight = light.position.xyz - worldFragPos;
         float attenuation = 1.0 / dot(directionToLight, directionToLight);
@@ -54,16 +69,18 @@ void main() {
         vec3 intensity = light.color.xyz * light.color.w * cosAngIncidence * attenuation;
 
         diffuseLight += intensity;
+        if (!SPECULAR) continue;
 
         vec3 halfAngle = normalize(directionToLight + viewDirection);
         float blinnTerm = max(dot(halfAngle, surfaceNormal), 0.0);
         blinnTerm = clamp(blinnTerm, 0.0, 1.0);
-        blinnTerm = pow(blinnTerm, 512.0); // higher p => sharper highlight
+        blinnTerm = pow(blinnTerm, SHININESS);
         
         specularLight += blinnTerm * intensity;
     }
 
     // r g b a
     // outColor = vec4(inColor, 1.0);
-    outColor = vec4((diffuseLight + ambientLight + specularLight) * fragColor, 1.0);
+    vec3 albedo = fragColor * texture(materialTexture, fragUv).rgb;
+    outColor = vec4((diffuseLight + ambientLight + specularLight) * albedo, 1.0);
 }
\ No newline at end of file
@@ -11,6 +11,7 @@ layout(location = 3) in vec2 uv;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 worldFragPos;
 layout(location = 2) out vec3 worldFragNormal;
+layout(location = 3) out vec2 fragUv;
 
 struct PointLight {
     vec4 position;
@@ -57,4 +58,5 @@ void main() {
     worldFragPos = worldPosition.xyz;
     worldFragNormal = normalize(mat3(push.normalMatrix) * normal);
     fragColor = color;
+    fragUv = uv;
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#version 450
+
+// Vertex attribute discription for Model::PackedVertex / Model::QuantizedVertex:
+// position is float32 or snorm16 (dequantized through push.modelMatrix),
+// color is unorm8, normal is octahedral snorm16, uv is float16
+// the fetch converts everything to float, only the normal needs decoding
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec2 octNormal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 worldFragPos;
+layout(location = 2) out vec3 worldFragNormal;
+layout(location = 3) out vec2 fragUv;
+
+struct PointLight {
+    vec4 position;
+    vec4 color;
+};
+
+// for descriptor set 0 binding 0
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseView;
+    // this is for parrallel light
+    // vec3 directionToLight;
+
+    // for point light
+    vec4 ambientLightColor;
+    PointLight pointLights[10];
+    int numLights;
+} ubo;
+
+// push constant only support 128 bytes => 32 floats => 2 mat4
+layout(push_constant) uniform Push{
+    mat4 modelMatrix; // model * dequantize (Model::getDequantizeMatrix)
+    // for using case 3 below, use normal matrix instead
+    // mat4 modelMatrix;
+    mat4 normalMatrix;
+} push;
+
+// inverse of VertexPacking::encodeNormal
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// vertex light: compute light in vert shader
+void main() {
+    vec3 normal = octDecode(octNormal);
+    vec4 worldPosition = push.modelMatrix * vec4(position, 1.0);
+    gl_Position = ubo.projection * ubo.view * worldPosition;
+
+    // For normal transformation, 
+    // 1. if we only allow uniform scaling, (vec3 scale => float scale) we can use:
+    // vec3 normalWorldSpace = normalize(mat3(push.modelMatrix) * normal);
+
+    // 2. more computationally, we can compute inverse transpose modelMatrix
+    // vec3 normalWorldSpace = normalize(transpose(inverse(mat3(push.modelMatrix))) * normal);
+
+    // 3. pass in pre-computed normal matrix to shaders
+    // vec3 normalWorldSpace = normalize(mat3(push.normalMatrix) * normal);
+
+    worldFragPos = worldPosition.xyz;
+    worldFragNormal = normalize(mat3(push.normalMatrix) * normal);
+    fragColor = color;
+    fragUv = uv;
+}
\ No newline at end of file